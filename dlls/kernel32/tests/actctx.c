@@ -2196,6 +2196,58 @@ static void test_findsectionstring(void)
     pReleaseActCtx(handle);
 }
 
+static void test_manifest_cache(void)
+{
+    ACTCTX_SECTION_KEYED_DATA data;
+    ULONG_PTR cookie;
+    HANDLE handle;
+    int i;
+    BOOL ret;
+
+    /* creating a context twice from an unchanged file gives the same result */
+    for (i = 0; i < 2; i++)
+    {
+        if (!create_manifest_file("test_cache.manifest", testdep_manifest2, -1, NULL, NULL))
+        {
+            skip("Could not create manifest file\n");
+            return;
+        }
+        handle = test_create("test_cache.manifest");
+        ok(handle != INVALID_HANDLE_VALUE, "%d: handle == INVALID_HANDLE_VALUE, error %u\n", i, GetLastError());
+        if (handle == INVALID_HANDLE_VALUE) break;
+
+        ret = pActivateActCtx(handle, &cookie);
+        ok(ret, "%d: ActivateActCtx failed: %u\n", i, GetLastError());
+        memset(&data, 0, sizeof(data));
+        data.cbSize = sizeof(data);
+        ret = pFindActCtxSectionStringW(0, NULL, ACTIVATION_CONTEXT_SECTION_DLL_REDIRECTION, testlib2_dll, &data);
+        ok(ret, "%d: FindActCtxSectionStringW failed: %u\n", i, GetLastError());
+        ok(data.ulAssemblyRosterIndex == 1, "%d: got roster index %u\n", i, data.ulAssemblyRosterIndex);
+        pDeactivateActCtx(0, cookie);
+        pReleaseActCtx(handle);
+    }
+
+    /* a modified manifest is parsed again */
+    create_manifest_file("test_cache.manifest", testdep_manifest1, -1, NULL, NULL);
+    handle = test_create("test_cache.manifest");
+    ok(handle != INVALID_HANDLE_VALUE, "handle == INVALID_HANDLE_VALUE, error %u\n", GetLastError());
+    if (handle != INVALID_HANDLE_VALUE)
+    {
+        ret = pActivateActCtx(handle, &cookie);
+        ok(ret, "ActivateActCtx failed: %u\n", GetLastError());
+        memset(&data, 0, sizeof(data));
+        data.cbSize = sizeof(data);
+        SetLastError(0xdeadbeef);
+        ret = pFindActCtxSectionStringW(0, NULL, ACTIVATION_CONTEXT_SECTION_DLL_REDIRECTION, testlib2_dll, &data);
+        ok(!ret, "FindActCtxSectionStringW succeeded\n");
+        ok(GetLastError() == ERROR_SXS_KEY_NOT_FOUND, "got error %u\n", GetLastError());
+        pDeactivateActCtx(0, cookie);
+        pReleaseActCtx(handle);
+    }
+
+    DeleteFileA("test_cache.manifest");
+}
+
 static void run_child_process(void)
 {
     char cmdline[MAX_PATH];
@@ -2457,5 +2509,6 @@ START_TEST(actctx)
     test_actctx();
     test_CreateActCtx();
     test_findsectionstring();
+    test_manifest_cache();
     run_child_process();
 }
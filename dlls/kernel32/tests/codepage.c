@@ -985,6 +985,58 @@ static void test_undefined_byte_char(void)
     }
 }
 
+static void test_long_strings(void)
+{
+    char str[300], utf8[600], buf[600];
+    WCHAR strW[300], bufW[300];
+    int i, len, utf8_len, ret;
+
+    /* long runs of ASCII chars with a few others in between */
+    for (i = len = utf8_len = 0; i < 290; i++, len++)
+    {
+        if (i % 37 == 36 || i == 17 || i == 100 || i == 101)
+        {
+            str[len] = '\xe9';
+            strW[len] = 0xe9;
+            utf8[utf8_len++] = '\xc3';
+            utf8[utf8_len++] = '\xa9';
+        }
+        else
+        {
+            str[len] = utf8[utf8_len++] = 'a' + i % 26;
+            strW[len] = 'a' + i % 26;
+        }
+    }
+
+    ret = MultiByteToWideChar(1252, 0, str, len, bufW, len);
+    ok(ret == len, "got %d\n", ret);
+    ok(!memcmp(bufW, strW, len * sizeof(WCHAR)), "wrong 1252 conversion\n");
+
+    ret = WideCharToMultiByte(1252, 0, strW, len, buf, len, NULL, NULL);
+    ok(ret == len, "got %d\n", ret);
+    ok(!memcmp(buf, str, len), "wrong 1252 conversion\n");
+
+    ret = MultiByteToWideChar(CP_UTF8, 0, utf8, utf8_len, NULL, 0);
+    ok(ret == len, "got %d\n", ret);
+    ret = MultiByteToWideChar(CP_UTF8, 0, utf8, utf8_len, bufW, len);
+    ok(ret == len, "got %d\n", ret);
+    ok(!memcmp(bufW, strW, len * sizeof(WCHAR)), "wrong UTF-8 conversion\n");
+
+    ret = WideCharToMultiByte(CP_UTF8, 0, strW, len, NULL, 0, NULL, NULL);
+    ok(ret == utf8_len, "got %d\n", ret);
+    ret = WideCharToMultiByte(CP_UTF8, 0, strW, len, buf, utf8_len, NULL, NULL);
+    ok(ret == utf8_len, "got %d\n", ret);
+    ok(!memcmp(buf, utf8, utf8_len), "wrong UTF-8 conversion\n");
+
+    /* destination too small in the middle of an ASCII run */
+    SetLastError(0xdeadbeef);
+    ret = MultiByteToWideChar(CP_UTF8, 0, utf8, utf8_len, bufW, 50);
+    ok(!ret && GetLastError() == ERROR_INSUFFICIENT_BUFFER, "got %d error %u\n", ret, GetLastError());
+    SetLastError(0xdeadbeef);
+    ret = WideCharToMultiByte(CP_UTF8, 0, strW, len, buf, 50, NULL, NULL);
+    ok(!ret && GetLastError() == ERROR_INSUFFICIENT_BUFFER, "got %d error %u\n", ret, GetLastError());
+}
+
 static void test_threadcp(void)
 {
     static const LCID ENGLISH  = MAKELCID(MAKELANGID(LANG_ENGLISH,  SUBLANG_ENGLISH_US),         SORT_DEFAULT);
@@ -1145,5 +1197,6 @@ START_TEST(codepage)
     test_utf7_decoding();
 
     test_undefined_byte_char();
+    test_long_strings();
     test_threadcp();
 }
@@ -4235,12 +4235,13 @@ static void test_WriteFileGather(void)
 {
     char temp_path[MAX_PATH], filename[MAX_PATH];
     HANDLE hfile, hiocp1, hiocp2;
-    DWORD ret, size;
+    DWORD ret, size, i;
     ULONG_PTR key;
-    FILE_SEGMENT_ELEMENT fse[2];
+    FILE_SEGMENT_ELEMENT fse[4];
     OVERLAPPED ovl, *povl = NULL;
     SYSTEM_INFO si;
     LPVOID buf = NULL;
+    char *pages;
 
     ret = GetTempPathA( MAX_PATH, temp_path );
     ok( ret != 0, "GetTempPathA error %d\n", GetLastError() );
@@ -4281,10 +4282,48 @@ static void test_WriteFileGather(void)
     ok( ret, "GetQueuedCompletionStatus failed err %u\n", GetLastError());
     ok( povl == &ovl, "wrong ovl %p\n", povl );
 
+    /* several pages, read back into the buffers in reverse order */
+    pages = VirtualAlloc( NULL, 3 * si.dwPageSize, MEM_COMMIT, PAGE_READWRITE );
+    ok( pages != NULL, "VirtualAlloc failed err %u\n", GetLastError() );
+
+    memset( fse, 0, sizeof(fse) );
+    for (i = 0; i < 3; i++)
+    {
+        memset( pages + i * si.dwPageSize, 'a' + i, si.dwPageSize );
+        fse[i].Buffer = pages + i * si.dwPageSize;
+    }
+    memset( &ovl, 0, sizeof(ovl) );
+    ovl.hEvent = CreateEventW( NULL, TRUE, FALSE, NULL );
+    if (!WriteFileGather( hfile, fse, 3 * si.dwPageSize, NULL, &ovl ))
+        ok( GetLastError() == ERROR_IO_PENDING, "WriteFileGather failed err %u\n", GetLastError() );
+    ret = GetOverlappedResult( hfile, &ovl, &size, TRUE );
+    ok( ret, "GetOverlappedResult failed err %u\n", GetLastError() );
+    ok( size == 3 * si.dwPageSize, "wrong size %u\n", size );
+    ret = GetQueuedCompletionStatus( hiocp2, &size, &key, &povl, 1000 );
+    ok( ret, "GetQueuedCompletionStatus failed err %u\n", GetLastError());
+    ok( povl == &ovl, "wrong ovl %p\n", povl );
+
+    memset( pages, 0, 3 * si.dwPageSize );
+    for (i = 0; i < 3; i++) fse[i].Buffer = pages + (2 - i) * si.dwPageSize;
+    ResetEvent( ovl.hEvent );
+    if (!ReadFileScatter( hfile, fse, 3 * si.dwPageSize, NULL, &ovl ))
+        ok( GetLastError() == ERROR_IO_PENDING, "ReadFileScatter failed err %u\n", GetLastError() );
+    ret = GetOverlappedResult( hfile, &ovl, &size, TRUE );
+    ok( ret, "GetOverlappedResult failed err %u\n", GetLastError() );
+    ok( size == 3 * si.dwPageSize, "wrong size %u\n", size );
+    ret = GetQueuedCompletionStatus( hiocp2, &size, &key, &povl, 1000 );
+    ok( ret, "GetQueuedCompletionStatus failed err %u\n", GetLastError());
+    ok( povl == &ovl, "wrong ovl %p\n", povl );
+    for (i = 0; i < 3; i++)
+        ok( pages[(2 - i) * si.dwPageSize] == 'a' + i && pages[(3 - i) * si.dwPageSize - 1] == 'a' + i,
+            "wrong data in page %u\n", i );
+
+    CloseHandle( ovl.hEvent );
     CloseHandle( hfile );
     CloseHandle( hiocp1 );
     CloseHandle( hiocp2 );
     VirtualFree( buf, 0, MEM_RELEASE );
+    VirtualFree( pages, 0, MEM_RELEASE );
     DeleteFileA( filename );
 }
 
@@ -1675,6 +1675,21 @@ static void test_CompareStringA(void)
     ret = CompareStringA(lcid, NORM_IGNORECASE, "Salut", 5, "saLuT", -1);
     ok (ret == CSTR_EQUAL, "(Salut/saLuT) Expected CSTR_EQUAL, got %d\n", ret);
 
+    /* diacritics are compared before case, whatever their position */
+    {
+        static const WCHAR resumesW[] = {'r','e','s','u','m','e','s',0};
+        static const WCHAR ResumeSW[] = {'R',0xe9,'s','u','m',0xe9,'S',0};
+
+        ret = CompareStringW(lcid, 0, resumesW, -1, ResumeSW, -1);
+        ok (ret == CSTR_LESS_THAN, "Expected CSTR_LESS_THAN, got %d\n", ret);
+        ret = CompareStringW(lcid, 0, ResumeSW, -1, resumesW, -1);
+        ok (ret == CSTR_GREATER_THAN, "Expected CSTR_GREATER_THAN, got %d\n", ret);
+        ret = CompareStringW(lcid, NORM_IGNORENONSPACE, resumesW, -1, ResumeSW, -1);
+        ok (ret == CSTR_LESS_THAN, "Expected CSTR_LESS_THAN, got %d\n", ret);
+        ret = CompareStringW(lcid, NORM_IGNORENONSPACE | NORM_IGNORECASE, resumesW, -1, ResumeSW, -1);
+        ok (ret == CSTR_EQUAL, "Expected CSTR_EQUAL, got %d\n", ret);
+    }
+
     /* test for CompareStringA flags */
     SetLastError(0xdeadbeef);
     ret = CompareStringA(LOCALE_SYSTEM_DEFAULT, 0x8, "NULL", -1, "NULL", -1);
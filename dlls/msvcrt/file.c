@@ -673,17 +673,37 @@ static BOOL msvcrt_alloc_buffer(MSVCRT_FILE* file)
     return TRUE;
 }
 
+static char std_buffers[2][MSVCRT_BUFSIZ];
+
 /* INTERNAL: Allocate temporary buffer for stdout and stderr */
+/* Unbuffered streams get the thread's buffer, so that every call issues a single write */
 static BOOL add_std_buffer(MSVCRT_FILE *file)
 {
-    static char buffers[2][MSVCRT_BUFSIZ];
+    if((file->_flag & MSVCRT__IONBF) && !file->_cnt) {
+        thread_data_t *data = msvcrt_get_thread_data();
+
+        /* leave streams that can't be written to to the regular error handling */
+        if(!(file->_flag & (MSVCRT__IOWRT | MSVCRT__IORW)))
+            return FALSE;
+        if((file->_flag & MSVCRT__IOREAD) && !(file->_flag & MSVCRT__IOEOF))
+            return FALSE;
+
+        if(!data->stream_buffer && !(data->stream_buffer = MSVCRT_malloc(MSVCRT_BUFSIZ)))
+            return FALSE;
+
+        file->_ptr = file->_base = data->stream_buffer;
+        file->_bufsiz = file->_cnt = MSVCRT_BUFSIZ;
+        file->_flag = (file->_flag & ~(MSVCRT__IONBF | MSVCRT__IOREAD | MSVCRT__IOEOF))
+            | MSVCRT__USERBUF | MSVCRT__IOWRT;
+        return TRUE;
+    }
 
     if((file->_file!=MSVCRT_STDOUT_FILENO && file->_file!=MSVCRT_STDERR_FILENO)
             || (file->_flag & (MSVCRT__IONBF | MSVCRT__IOMYBUF | MSVCRT__USERBUF))
             || !MSVCRT__isatty(file->_file))
         return FALSE;
 
-    file->_ptr = file->_base = buffers[file->_file == MSVCRT_STDOUT_FILENO ? 0 : 1];
+    file->_ptr = file->_base = std_buffers[file->_file == MSVCRT_STDOUT_FILENO ? 0 : 1];
     file->_bufsiz = file->_cnt = MSVCRT_BUFSIZ;
     file->_flag |= MSVCRT__USERBUF;
     return TRUE;
@@ -691,12 +711,21 @@ static BOOL add_std_buffer(MSVCRT_FILE *file)
 
 /* INTERNAL: Removes temporary buffer from stdout or stderr */
 /* Only call this function when add_std_buffer returned TRUE */
-static void remove_std_buffer(MSVCRT_FILE *file)
+static int remove_std_buffer(MSVCRT_FILE *file)
 {
-    msvcrt_flush_buffer(file);
-    file->_ptr = file->_base = NULL;
-    file->_bufsiz = file->_cnt = 0;
-    file->_flag &= ~MSVCRT__USERBUF;
+    int ret = msvcrt_flush_buffer(file);
+
+    if(file->_base == std_buffers[0] || file->_base == std_buffers[1]) {
+        file->_ptr = file->_base = NULL;
+        file->_bufsiz = 0;
+        file->_flag &= ~MSVCRT__USERBUF;
+    } else {
+        file->_ptr = file->_base = (char*)&file->_charbuf;
+        file->_bufsiz = 2;
+        file->_flag = (file->_flag & ~MSVCRT__USERBUF) | MSVCRT__IONBF;
+    }
+    file->_cnt = 0;
+    return ret;
 }
 
 /* INTERNAL: Convert integer to base32 string (0-9a-v), 0 becomes "" */
@@ -4562,9 +4591,9 @@ int CDECL MSVCRT_fputws(const MSVCRT_wchar_t *s, MSVCRT_FILE* file)
         }
     }
 
-    if(tmp_buf) remove_std_buffer(file);
+    ret = (tmp_buf && remove_std_buffer(file)) ? MSVCRT_WEOF : 0;
     MSVCRT__unlock_file(file);
-    return 0;
+    return ret;
 }
 
 /*********************************************************************
@@ -4883,31 +4912,24 @@ int CDECL MSVCRT_tmpfile_s(MSVCRT_FILE** file)
     return 0;
 }
 
+/* the printf callbacks are called with the file lock held */
 static int puts_clbk_file_a(void *file, int len, const char *str)
 {
-    return MSVCRT_fwrite(str, sizeof(char), len, file);
+    return MSVCRT__fwrite_nolock(str, sizeof(char), len, file);
 }
 
 static int puts_clbk_file_w(void *file, int len, const MSVCRT_wchar_t *str)
 {
-    int i, ret;
+    int i;
 
-    MSVCRT__lock_file(file);
-
-    if(!(get_ioinfo_nolock(((MSVCRT_FILE*)file)->_file)->wxflag & WX_TEXT)) {
-        ret = MSVCRT__fwrite_nolock(str, sizeof(MSVCRT_wchar_t), len, file);
-        MSVCRT__unlock_file(file);
-        return ret;
-    }
+    if(!(get_ioinfo_nolock(((MSVCRT_FILE*)file)->_file)->wxflag & WX_TEXT))
+        return MSVCRT__fwrite_nolock(str, sizeof(MSVCRT_wchar_t), len, file);
 
     for(i=0; i<len; i++) {
-        if(MSVCRT__fputwc_nolock(str[i], file) == MSVCRT_WEOF) {
-            MSVCRT__unlock_file(file);
+        if(MSVCRT__fputwc_nolock(str[i], file) == MSVCRT_WEOF)
             return -1;
-        }
     }
 
-    MSVCRT__unlock_file(file);
     return len;
 }
 
@@ -4922,7 +4944,7 @@ int CDECL MSVCRT_vfprintf(MSVCRT_FILE* file, const char *format, __ms_va_list va
     MSVCRT__lock_file(file);
     tmp_buf = add_std_buffer(file);
     ret = pf_printf_a(puts_clbk_file_a, file, format, NULL, FALSE, FALSE, arg_clbk_valist, NULL, &valist);
-    if(tmp_buf) remove_std_buffer(file);
+    if(tmp_buf && remove_std_buffer(file)) ret = -1;
     MSVCRT__unlock_file(file);
 
     return ret;
@@ -4941,7 +4963,7 @@ int CDECL MSVCRT_vfprintf_s(MSVCRT_FILE* file, const char *format, __ms_va_list
     MSVCRT__lock_file(file);
     tmp_buf = add_std_buffer(file);
     ret = pf_printf_a(puts_clbk_file_a, file, format, NULL, FALSE, TRUE, arg_clbk_valist, NULL, &valist);
-    if(tmp_buf) remove_std_buffer(file);
+    if(tmp_buf && remove_std_buffer(file)) ret = -1;
     MSVCRT__unlock_file(file);
 
     return ret;
@@ -4958,7 +4980,7 @@ int CDECL MSVCRT_vfwprintf(MSVCRT_FILE* file, const MSVCRT_wchar_t *format, __ms
     MSVCRT__lock_file(file);
     tmp_buf = add_std_buffer(file);
     ret = pf_printf_w(puts_clbk_file_w, file, format, NULL, FALSE, FALSE, arg_clbk_valist, NULL, &valist);
-    if(tmp_buf) remove_std_buffer(file);
+    if(tmp_buf && remove_std_buffer(file)) ret = -1;
     MSVCRT__unlock_file(file);
 
     return ret;
@@ -4977,7 +4999,7 @@ int CDECL MSVCRT_vfwprintf_s(MSVCRT_FILE* file, const MSVCRT_wchar_t *format, __
     MSVCRT__lock_file(file);
     tmp_buf = add_std_buffer(file);
     ret = pf_printf_w(puts_clbk_file_w, file, format, NULL, FALSE, TRUE, arg_clbk_valist, NULL, &valist);
-    if(tmp_buf) remove_std_buffer(file);
+    if(tmp_buf && remove_std_buffer(file)) ret = -1;
     MSVCRT__unlock_file(file);
 
     return ret;
@@ -4997,7 +5019,7 @@ int CDECL MSVCRT__stdio_common_vfprintf(unsigned __int64 options, MSVCRT_FILE *f
     MSVCRT__lock_file(file);
     tmp_buf = add_std_buffer(file);
     ret = pf_printf_a(puts_clbk_file_a, file, format, locale, FALSE, FALSE, arg_clbk_valist, NULL, &valist);
-    if(tmp_buf) remove_std_buffer(file);
+    if(tmp_buf && remove_std_buffer(file)) ret = -1;
     MSVCRT__unlock_file(file);
 
     return ret;
@@ -5017,7 +5039,7 @@ int CDECL MSVCRT__vfwprintf_l(MSVCRT_FILE* file, const MSVCRT_wchar_t *format,
     MSVCRT__lock_file(file);
     tmp_buf = add_std_buffer(file);
     ret = pf_printf_w(puts_clbk_file_w, file, format, locale, FALSE, FALSE, arg_clbk_valist, NULL, &valist);
-    if(tmp_buf) remove_std_buffer(file);
+    if(tmp_buf && remove_std_buffer(file)) ret = -1;
     MSVCRT__unlock_file(file);
 
     return ret;
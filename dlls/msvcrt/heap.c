@@ -40,7 +40,45 @@ WINE_DEFAULT_DEBUG_CHANNEL(msvcrt);
 
 #define SB_HEAP_ALIGN 16
 
-static HANDLE heap, sb_heap;
+/* The small blocks heap is carved out of a reserved region, in runs of
+ * blocks of a single size class. Every block has a SB_HEAP_ALIGN bytes
+ * header with its requested size, and freed blocks are kept in per-thread
+ * caches before going back to the global free lists. */
+#define SB_HEAP_CLASSES     (1024 / SB_HEAP_ALIGN)
+#define SB_HEAP_RUN_SIZE    0x10000
+#define SB_HEAP_REGION_SIZE 0x2000000
+#define SB_HEAP_CACHE_SIZE  32
+#define SB_HEAP_FREE        (~(MSVCRT_size_t)0)
+
+struct sb_block
+{
+    MSVCRT_size_t    size;  /* requested size, SB_HEAP_FREE for free blocks */
+    struct sb_block *next;  /* next free block of the same class */
+};
+
+struct sb_run
+{
+    unsigned int class;
+};
+
+struct sb_cache
+{
+    struct sb_block *head[SB_HEAP_CLASSES];
+    unsigned int     count[SB_HEAP_CLASSES];
+};
+
+static HANDLE heap;
+static char *sb_heap, *sb_heap_next;
+static struct sb_block *sb_free_list[SB_HEAP_CLASSES];
+
+static CRITICAL_SECTION sb_heap_cs;
+static CRITICAL_SECTION_DEBUG sb_heap_cs_debug =
+{
+    0, 0, &sb_heap_cs,
+    { &sb_heap_cs_debug.ProcessLocksList, &sb_heap_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": sb_heap_cs") }
+};
+static CRITICAL_SECTION sb_heap_cs = { &sb_heap_cs_debug, -1, 0, 0, 0, 0 };
 
 typedef int (CDECL *MSVCRT_new_handler_func)(MSVCRT_size_t size);
 
@@ -52,19 +90,170 @@ static unsigned int MSVCRT_amblksiz = 16;
 /* FIXME - According to documentation it should be 480 bytes, at runtime default is 0 */
 static MSVCRT_size_t MSVCRT_sbh_threshold = 0;
 
-static void* msvcrt_heap_alloc(DWORD flags, MSVCRT_size_t size)
+static inline BOOL sb_heap_owns(const void *ptr)
 {
-    if(size < MSVCRT_sbh_threshold)
+    return sb_heap && (const char *)ptr >= sb_heap && (const char *)ptr < sb_heap + SB_HEAP_REGION_SIZE;
+}
+
+static inline struct sb_block *sb_heap_block(void *ptr)
+{
+    return (struct sb_block *)((char *)ptr - SB_HEAP_ALIGN);
+}
+
+static inline unsigned int sb_heap_class(const struct sb_block *block)
+{
+    return ((const struct sb_run *)((DWORD_PTR)block & ~(DWORD_PTR)(SB_HEAP_RUN_SIZE - 1)))->class;
+}
+
+static inline MSVCRT_size_t sb_heap_slot_size(unsigned int class)
+{
+    return (class + 2) * SB_HEAP_ALIGN;
+}
+
+/* commit a new run and add its blocks to the free list, sb_heap_cs must be held */
+static void sb_heap_add_run(unsigned int class)
+{
+    MSVCRT_size_t slot = sb_heap_slot_size(class);
+    struct sb_run *run = (struct sb_run *)sb_heap_next;
+    unsigned int i;
+
+    if(sb_heap_next == sb_heap + SB_HEAP_REGION_SIZE)
+        return;
+    if(!VirtualAlloc(run, SB_HEAP_RUN_SIZE, MEM_COMMIT, PAGE_READWRITE))
+        return;
+    sb_heap_next += SB_HEAP_RUN_SIZE;
+
+    run->class = class;
+    for(i = (SB_HEAP_RUN_SIZE - SB_HEAP_ALIGN) / slot; i > 0; i--)
     {
-        void *memblock, *temp, **saved;
+        struct sb_block *block = (struct sb_block *)((char *)run + SB_HEAP_ALIGN + (i - 1) * slot);
+        block->size = SB_HEAP_FREE;
+        block->next = sb_free_list[class];
+        sb_free_list[class] = block;
+    }
+}
 
-        temp = HeapAlloc(sb_heap, flags, size+sizeof(void*)+SB_HEAP_ALIGN);
-        if(!temp) return NULL;
+/* move count blocks from the thread cache back to the free list */
+static void sb_heap_flush_cache(struct sb_cache *cache, unsigned int class, unsigned int count)
+{
+    EnterCriticalSection(&sb_heap_cs);
+    while(count-- && cache->head[class])
+    {
+        struct sb_block *block = cache->head[class];
+        cache->head[class] = block->next;
+        cache->count[class]--;
+        block->next = sb_free_list[class];
+        sb_free_list[class] = block;
+    }
+    LeaveCriticalSection(&sb_heap_cs);
+}
 
-        memblock = ALIGN_PTR(temp, SB_HEAP_ALIGN, 0);
-        saved = SAVED_PTR(memblock);
-        *saved = temp;
-        return memblock;
+static struct sb_cache *sb_heap_get_cache(void)
+{
+    thread_data_t *data = msvcrt_get_thread_data();
+
+    if(!data->sb_cache)
+        data->sb_cache = HeapAlloc(heap, HEAP_ZERO_MEMORY, sizeof(*data->sb_cache));
+    return data->sb_cache;
+}
+
+static void* sb_heap_alloc(DWORD flags, MSVCRT_size_t size)
+{
+    unsigned int class = size ? (size - 1) / SB_HEAP_ALIGN : 0;
+    struct sb_cache *cache = sb_heap_get_cache();
+    struct sb_block *block;
+
+    if(!cache || !cache->head[class])
+    {
+        EnterCriticalSection(&sb_heap_cs);
+        if(!sb_free_list[class])
+            sb_heap_add_run(class);
+        /* refill the thread cache with a batch of blocks */
+        while(cache && sb_free_list[class] && cache->count[class] < SB_HEAP_CACHE_SIZE / 2)
+        {
+            block = sb_free_list[class];
+            sb_free_list[class] = block->next;
+            block->next = cache->head[class];
+            cache->head[class] = block;
+            cache->count[class]++;
+        }
+        block = NULL;
+        if(!cache && (block = sb_free_list[class]))
+            sb_free_list[class] = block->next;
+        LeaveCriticalSection(&sb_heap_cs);
+    }
+
+    if(cache && (block = cache->head[class]))
+    {
+        cache->head[class] = block->next;
+        cache->count[class]--;
+    }
+    if(!block) return NULL;
+
+    block->size = size;
+    if(flags & HEAP_ZERO_MEMORY)
+        memset((char *)block + SB_HEAP_ALIGN, 0, size);
+    return (char *)block + SB_HEAP_ALIGN;
+}
+
+static BOOL sb_heap_free(void *ptr)
+{
+    struct sb_block *block = sb_heap_block(ptr);
+    unsigned int class = sb_heap_class(block);
+    struct sb_cache *cache;
+
+    if(block->size == SB_HEAP_FREE)
+        return FALSE;
+    block->size = SB_HEAP_FREE;
+
+    if(!(cache = sb_heap_get_cache()))
+    {
+        EnterCriticalSection(&sb_heap_cs);
+        block->next = sb_free_list[class];
+        sb_free_list[class] = block;
+        LeaveCriticalSection(&sb_heap_cs);
+        return TRUE;
+    }
+
+    if(cache->count[class] == SB_HEAP_CACHE_SIZE)
+        sb_heap_flush_cache(cache, class, SB_HEAP_CACHE_SIZE / 2);
+    block->next = cache->head[class];
+    cache->head[class] = block;
+    cache->count[class]++;
+    return TRUE;
+}
+
+/* find the small block following ptr, or the first one */
+static struct sb_block *sb_heap_next_block(void *ptr)
+{
+    char *run, *p;
+
+    if(ptr)
+    {
+        struct sb_block *block = sb_heap_block(ptr);
+        run = (char *)((DWORD_PTR)block & ~(DWORD_PTR)(SB_HEAP_RUN_SIZE - 1));
+        p = (char *)block + sb_heap_slot_size(sb_heap_class(block));
+    }
+    else
+    {
+        run = sb_heap;
+        p = run + SB_HEAP_ALIGN;
+    }
+
+    for(; run < sb_heap_next; run += SB_HEAP_RUN_SIZE, p = run + SB_HEAP_ALIGN)
+    {
+        if(p + sb_heap_slot_size(((struct sb_run *)run)->class) <= run + SB_HEAP_RUN_SIZE)
+            return (struct sb_block *)p;
+    }
+    return NULL;
+}
+
+static void* msvcrt_heap_alloc(DWORD flags, MSVCRT_size_t size)
+{
+    if(size < MSVCRT_sbh_threshold)
+    {
+        void *memblock = sb_heap_alloc(flags, size);
+        if(memblock) return memblock;
     }
 
     return HeapAlloc(heap, flags, size);
@@ -72,30 +261,27 @@ static void* msvcrt_heap_alloc(DWORD flags, MSVCRT_size_t size)
 
 static void* msvcrt_heap_realloc(DWORD flags, void *ptr, MSVCRT_size_t size)
 {
-    if(sb_heap && ptr && !HeapValidate(heap, 0, ptr))
+    if(sb_heap_owns(ptr))
     {
-        /* TODO: move data to normal heap if it exceeds sbh_threshold limit */
-        void *memblock, *temp, **saved;
-        MSVCRT_size_t old_padding, new_padding, old_size;
-
-        saved = SAVED_PTR(ptr);
-        old_padding = (char*)ptr - (char*)*saved;
-        old_size = HeapSize(sb_heap, 0, *saved);
-        if(old_size == -1)
-            return NULL;
-        old_size -= old_padding;
+        struct sb_block *block = sb_heap_block(ptr);
+        MSVCRT_size_t old_size = block->size;
+        void *memblock;
 
-        temp = HeapReAlloc(sb_heap, flags, *saved, size+sizeof(void*)+SB_HEAP_ALIGN);
-        if(!temp) return NULL;
-
-        memblock = ALIGN_PTR(temp, SB_HEAP_ALIGN, 0);
-        saved = SAVED_PTR(memblock);
-        new_padding = (char*)memblock - (char*)temp;
+        if(old_size == SB_HEAP_FREE)
+            return NULL;
 
-        if(new_padding != old_padding)
-            memmove(memblock, (char*)temp+old_padding, old_size>size ? size : old_size);
+        if(size <= sb_heap_slot_size(sb_heap_class(block)) - SB_HEAP_ALIGN)
+        {
+            block->size = size;
+            return ptr;
+        }
+        if(flags & HEAP_REALLOC_IN_PLACE_ONLY)
+            return NULL;
 
-        *saved = temp;
+        memblock = msvcrt_heap_alloc(flags, size);
+        if(!memblock) return NULL;
+        memcpy(memblock, ptr, old_size);
+        sb_heap_free(ptr);
         return memblock;
     }
 
@@ -104,22 +290,16 @@ static void* msvcrt_heap_realloc(DWORD flags, void *ptr, MSVCRT_size_t size)
 
 static BOOL msvcrt_heap_free(void *ptr)
 {
-    if(sb_heap && ptr && !HeapValidate(heap, 0, ptr))
-    {
-        void **saved = SAVED_PTR(ptr);
-        return HeapFree(sb_heap, 0, *saved);
-    }
+    if(sb_heap_owns(ptr))
+        return sb_heap_free(ptr);
 
     return HeapFree(heap, 0, ptr);
 }
 
 static MSVCRT_size_t msvcrt_heap_size(void *ptr)
 {
-    if(sb_heap && ptr && !HeapValidate(heap, 0, ptr))
-    {
-        void **saved = SAVED_PTR(ptr);
-        return HeapSize(sb_heap, 0, *saved);
-    }
+    if(sb_heap_owns(ptr))
+        return sb_heap_block(ptr)->size;
 
     return HeapSize(heap, 0, ptr);
 }
@@ -252,8 +432,7 @@ void* CDECL _expand(void* mem, MSVCRT_size_t size)
  */
 int CDECL _heapchk(void)
 {
-  if (!HeapValidate(heap, 0, NULL) ||
-          (sb_heap && !HeapValidate(sb_heap, 0, NULL)))
+  if (!HeapValidate(heap, 0, NULL))
   {
     msvcrt_set_errno(GetLastError());
     return MSVCRT__HEAPBADNODE;
@@ -266,8 +445,7 @@ int CDECL _heapchk(void)
  */
 int CDECL _heapmin(void)
 {
-  if (!HeapCompact( heap, 0 ) ||
-          (sb_heap && !HeapCompact( sb_heap, 0 )))
+  if (!HeapCompact( heap, 0 ))
   {
     if (GetLastError() != ERROR_CALL_NOT_IMPLEMENTED)
       msvcrt_set_errno(GetLastError());
@@ -276,6 +454,29 @@ int CDECL _heapmin(void)
   return 0;
 }
 
+static int sb_heap_walk(struct MSVCRT__heapinfo *next, void *ptr)
+{
+    struct sb_block *block;
+
+    EnterCriticalSection(&sb_heap_cs);
+    if ((block = sb_heap_next_block(ptr)))
+    {
+        next->_pentry = (int *)((char *)block + SB_HEAP_ALIGN);
+        if (block->size == SB_HEAP_FREE)
+        {
+            next->_size = sb_heap_slot_size(sb_heap_class(block)) - SB_HEAP_ALIGN;
+            next->_useflag = MSVCRT__FREEENTRY;
+        }
+        else
+        {
+            next->_size = block->size;
+            next->_useflag = MSVCRT__USEDENTRY;
+        }
+    }
+    LeaveCriticalSection(&sb_heap_cs);
+    return block ? MSVCRT__HEAPOK : MSVCRT__HEAPEND;
+}
+
 /*********************************************************************
  *		_heapwalk (MSVCRT.@)
  */
@@ -283,8 +484,9 @@ int CDECL _heapwalk(struct MSVCRT__heapinfo* next)
 {
   PROCESS_HEAP_ENTRY phe;
 
-  if (sb_heap)
-      FIXME("small blocks heap not supported\n");
+  /* the small blocks are walked after the heap */
+  if (sb_heap_owns(next->_pentry))
+      return sb_heap_walk(next, next->_pentry);
 
   LOCK_HEAP;
   phe.lpData = next->_pentry;
@@ -305,7 +507,7 @@ int CDECL _heapwalk(struct MSVCRT__heapinfo* next)
     {
       UNLOCK_HEAP;
       if (GetLastError() == ERROR_NO_MORE_ITEMS)
-         return MSVCRT__HEAPEND;
+         return sb_heap ? sb_heap_walk(next, NULL) : MSVCRT__HEAPEND;
       msvcrt_set_errno(GetLastError());
       if (!phe.lpData)
         return MSVCRT__HEAPBADBEGIN;
@@ -477,12 +679,17 @@ int CDECL _set_sbh_threshold(MSVCRT_size_t threshold)
   if(threshold > 1016)
      return 0;
 
+  EnterCriticalSection(&sb_heap_cs);
   if(!sb_heap)
   {
-      sb_heap = HeapCreate(0, 0, 0);
+      sb_heap = sb_heap_next = VirtualAlloc(NULL, SB_HEAP_REGION_SIZE, MEM_RESERVE, PAGE_READWRITE);
       if(!sb_heap)
+      {
+          LeaveCriticalSection(&sb_heap_cs);
           return 0;
+      }
   }
+  LeaveCriticalSection(&sb_heap_cs);
 
   MSVCRT_sbh_threshold = (threshold+0xf) & ~0xf;
   return 1;
@@ -816,9 +1023,22 @@ BOOL msvcrt_init_heap(void)
     return heap != NULL;
 }
 
+void msvcrt_free_heap_cache(thread_data_t *data)
+{
+    unsigned int i;
+
+    if(!data->sb_cache)
+        return;
+
+    for(i=0; i<SB_HEAP_CLASSES; i++)
+        sb_heap_flush_cache(data->sb_cache, i, SB_HEAP_CACHE_SIZE);
+    HeapFree(heap, 0, data->sb_cache);
+    data->sb_cache = NULL;
+}
+
 void msvcrt_destroy_heap(void)
 {
     HeapDestroy(heap);
     if(sb_heap)
-        HeapDestroy(sb_heap);
+        VirtualFree(sb_heap, 0, MEM_RELEASE);
 }
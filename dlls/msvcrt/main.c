@@ -76,10 +76,13 @@ static inline void msvcrt_free_tls_mem(void)
     MSVCRT_free(tls->time_buffer);
     MSVCRT_free(tls->tmpnam_buffer);
     MSVCRT_free(tls->wtmpnam_buffer);
+    MSVCRT_free(tls->stream_buffer);
     if(tls->have_locale) {
         free_locinfo(tls->locinfo);
         free_mbcinfo(tls->mbcinfo);
     }
+    /* last, the frees above may put blocks back in the cache */
+    msvcrt_free_heap_cache(tls);
   }
   HeapFree(GetProcessHeap(), 0, tls);
 }
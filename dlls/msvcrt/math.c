@@ -73,6 +73,190 @@ int CDECL MSVCRT__set_SSE2_enable(int flag)
     return sse2_enabled;
 }
 
+/* The error checks live in inline helpers, so that the exported functions,
+ * the _CI x87 intrinsics and the __libm_sse2 entry points all inline them
+ * instead of calling each other through the PLT. */
+
+static inline float math_acosf( float x )
+{
+  if (x < -1.0 || x > 1.0 || !finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  /* glibc implements acos() as the FPU equivalent of atan2(sqrt(1 - x ^ 2), x).
+   * asin() uses a similar construction. This is bad because as x gets nearer to
+   * 1 the error in the expression "1 - x^2" can get relatively large due to
+   * cancellation. The sqrt() makes things worse. A safer way to calculate
+   * acos() is to use atan2(sqrt((1 - x) * (1 + x)), x). */
+  return atan2f(sqrtf((1 - x) * (1 + x)), x);
+}
+
+static inline float math_asinf( float x )
+{
+  if (x < -1.0 || x > 1.0 || !finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return atan2f(x, sqrtf((1 - x) * (1 + x)));
+}
+
+static inline float math_atanf( float x )
+{
+  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return atanf(x);
+}
+
+static inline float math_atan2f( float x, float y )
+{
+  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return atan2f(x,y);
+}
+
+static inline float math_cosf( float x )
+{
+  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return cosf(x);
+}
+
+static inline float math_expf( float x )
+{
+  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return expf(x);
+}
+
+static inline float math_log10f( float x )
+{
+  if (x < 0.0 || !finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  if (x == 0.0) *MSVCRT__errno() = MSVCRT_ERANGE;
+  return log10f(x);
+}
+
+static inline float math_logf( float x)
+{
+  if (x < 0.0 || !finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  if (x == 0.0) *MSVCRT__errno() = MSVCRT_ERANGE;
+  return logf(x);
+}
+
+static inline float math_powf( float x, float y )
+{
+  /* FIXME: If x < 0 and y is not integral, set EDOM */
+  float z = powf(x,y);
+  if (!finitef(z)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return z;
+}
+
+static inline float math_sinf( float x )
+{
+  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return sinf(x);
+}
+
+static inline float math_tanf( float x )
+{
+  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return tanf(x);
+}
+
+static inline double math_acos( double x )
+{
+  if (x < -1.0 || x > 1.0 || !isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  /* glibc implements acos() as the FPU equivalent of atan2(sqrt(1 - x ^ 2), x).
+   * asin() uses a similar construction. This is bad because as x gets nearer to
+   * 1 the error in the expression "1 - x^2" can get relatively large due to
+   * cancellation. The sqrt() makes things worse. A safer way to calculate
+   * acos() is to use atan2(sqrt((1 - x) * (1 + x)), x). */
+  return atan2(sqrt((1 - x) * (1 + x)), x);
+}
+
+static inline double math_asin( double x )
+{
+  if (x < -1.0 || x > 1.0 || !isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return atan2(x, sqrt((1 - x) * (1 + x)));
+}
+
+static inline double math_atan( double x )
+{
+  if (isnan(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return atan(x);
+}
+
+static inline double math_atan2( double x, double y )
+{
+  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return atan2(x,y);
+}
+
+static inline double math_cos( double x )
+{
+  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return cos(x);
+}
+
+static inline double math_cosh( double x )
+{
+  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return cosh(x);
+}
+
+static inline double math_exp( double x )
+{
+  if (isnan(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return exp(x);
+}
+
+static inline double math_fmod( double x, double y )
+{
+  if (!isfinite(x) || !isfinite(y)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return fmod(x,y);
+}
+
+static inline double math_log( double x)
+{
+  if (x < 0.0 || !isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  if (x == 0.0) *MSVCRT__errno() = MSVCRT_ERANGE;
+  return log(x);
+}
+
+static inline double math_log10( double x )
+{
+  if (x < 0.0 || !isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  if (x == 0.0) *MSVCRT__errno() = MSVCRT_ERANGE;
+  return log10(x);
+}
+
+static inline double math_pow( double x, double y )
+{
+  /* FIXME: If x < 0 and y is not integral, set EDOM */
+  double z = pow(x,y);
+  if (!isfinite(z)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return z;
+}
+
+static inline double math_sin( double x )
+{
+  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return sin(x);
+}
+
+static inline double math_sinh( double x )
+{
+  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return sinh(x);
+}
+
+static inline double math_sqrt( double x )
+{
+  if (x < 0.0 || !isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return sqrt(x);
+}
+
+static inline double math_tan( double x )
+{
+  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return tan(x);
+}
+
+static inline double math_tanh( double x )
+{
+  if (isnan(x)) *MSVCRT__errno() = MSVCRT_EDOM;
+  return tanh(x);
+}
+
 #if defined(__x86_64__) || defined(__arm__) || _MSVCR_VER>=120
 
 /*********************************************************************
@@ -139,13 +323,7 @@ float CDECL MSVCRT__nextafterf( float num, float next )
  */
 float CDECL MSVCRT_acosf( float x )
 {
-  if (x < -1.0 || x > 1.0 || !finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  /* glibc implements acos() as the FPU equivalent of atan2(sqrt(1 - x ^ 2), x).
-   * asin() uses a similar construction. This is bad because as x gets nearer to
-   * 1 the error in the expression "1 - x^2" can get relatively large due to
-   * cancellation. The sqrt() makes things worse. A safer way to calculate
-   * acos() is to use atan2(sqrt((1 - x) * (1 + x)), x). */
-  return atan2f(sqrtf((1 - x) * (1 + x)), x);
+  return math_acosf( x );
 }
 
 /*********************************************************************
@@ -153,8 +331,7 @@ float CDECL MSVCRT_acosf( float x )
  */
 float CDECL MSVCRT_asinf( float x )
 {
-  if (x < -1.0 || x > 1.0 || !finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return atan2f(x, sqrtf((1 - x) * (1 + x)));
+  return math_asinf( x );
 }
 
 /*********************************************************************
@@ -162,8 +339,7 @@ float CDECL MSVCRT_asinf( float x )
  */
 float CDECL MSVCRT_atanf( float x )
 {
-  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return atanf(x);
+  return math_atanf( x );
 }
 
 /*********************************************************************
@@ -171,8 +347,7 @@ float CDECL MSVCRT_atanf( float x )
  */
 float CDECL MSVCRT_atan2f( float x, float y )
 {
-  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return atan2f(x,y);
+  return math_atan2f( x, y );
 }
 
 /*********************************************************************
@@ -180,8 +355,7 @@ float CDECL MSVCRT_atan2f( float x, float y )
  */
 float CDECL MSVCRT_cosf( float x )
 {
-  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return cosf(x);
+  return math_cosf( x );
 }
 
 /*********************************************************************
@@ -198,8 +372,7 @@ float CDECL MSVCRT_coshf( float x )
  */
 float CDECL MSVCRT_expf( float x )
 {
-  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return expf(x);
+  return math_expf( x );
 }
 
 /*********************************************************************
@@ -216,9 +389,7 @@ float CDECL MSVCRT_fmodf( float x, float y )
  */
 float CDECL MSVCRT_logf( float x)
 {
-  if (x < 0.0 || !finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  if (x == 0.0) *MSVCRT__errno() = MSVCRT_ERANGE;
-  return logf(x);
+  return math_logf( x );
 }
 
 /*********************************************************************
@@ -226,9 +397,7 @@ float CDECL MSVCRT_logf( float x)
  */
 float CDECL MSVCRT_log10f( float x )
 {
-  if (x < 0.0 || !finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  if (x == 0.0) *MSVCRT__errno() = MSVCRT_ERANGE;
-  return log10f(x);
+  return math_log10f( x );
 }
 
 /*********************************************************************
@@ -236,10 +405,7 @@ float CDECL MSVCRT_log10f( float x )
  */
 float CDECL MSVCRT_powf( float x, float y )
 {
-  /* FIXME: If x < 0 and y is not integral, set EDOM */
-  float z = powf(x,y);
-  if (!finitef(z)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return z;
+  return math_powf( x, y );
 }
 
 /*********************************************************************
@@ -247,8 +413,7 @@ float CDECL MSVCRT_powf( float x, float y )
  */
 float CDECL MSVCRT_sinf( float x )
 {
-  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return sinf(x);
+  return math_sinf( x );
 }
 
 /*********************************************************************
@@ -274,8 +439,7 @@ float CDECL MSVCRT_sqrtf( float x )
  */
 float CDECL MSVCRT_tanf( float x )
 {
-  if (!finitef(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return tanf(x);
+  return math_tanf( x );
 }
 
 /*********************************************************************
@@ -343,13 +507,7 @@ double CDECL MSVCRT_modff( float x, float *iptr )
  */
 double CDECL MSVCRT_acos( double x )
 {
-  if (x < -1.0 || x > 1.0 || !isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  /* glibc implements acos() as the FPU equivalent of atan2(sqrt(1 - x ^ 2), x).
-   * asin() uses a similar construction. This is bad because as x gets nearer to
-   * 1 the error in the expression "1 - x^2" can get relatively large due to
-   * cancellation. The sqrt() makes things worse. A safer way to calculate
-   * acos() is to use atan2(sqrt((1 - x) * (1 + x)), x). */
-  return atan2(sqrt((1 - x) * (1 + x)), x);
+  return math_acos( x );
 }
 
 /*********************************************************************
@@ -357,8 +515,7 @@ double CDECL MSVCRT_acos( double x )
  */
 double CDECL MSVCRT_asin( double x )
 {
-  if (x < -1.0 || x > 1.0 || !isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return atan2(x, sqrt((1 - x) * (1 + x)));
+  return math_asin( x );
 }
 
 /*********************************************************************
@@ -366,8 +523,7 @@ double CDECL MSVCRT_asin( double x )
  */
 double CDECL MSVCRT_atan( double x )
 {
-  if (isnan(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return atan(x);
+  return math_atan( x );
 }
 
 /*********************************************************************
@@ -375,8 +531,7 @@ double CDECL MSVCRT_atan( double x )
  */
 double CDECL MSVCRT_atan2( double x, double y )
 {
-  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return atan2(x,y);
+  return math_atan2( x, y );
 }
 
 /*********************************************************************
@@ -384,8 +539,7 @@ double CDECL MSVCRT_atan2( double x, double y )
  */
 double CDECL MSVCRT_cos( double x )
 {
-  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return cos(x);
+  return math_cos( x );
 }
 
 /*********************************************************************
@@ -393,8 +547,7 @@ double CDECL MSVCRT_cos( double x )
  */
 double CDECL MSVCRT_cosh( double x )
 {
-  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return cosh(x);
+  return math_cosh( x );
 }
 
 /*********************************************************************
@@ -402,8 +555,7 @@ double CDECL MSVCRT_cosh( double x )
  */
 double CDECL MSVCRT_exp( double x )
 {
-  if (isnan(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return exp(x);
+  return math_exp( x );
 }
 
 /*********************************************************************
@@ -411,8 +563,7 @@ double CDECL MSVCRT_exp( double x )
  */
 double CDECL MSVCRT_fmod( double x, double y )
 {
-  if (!isfinite(x) || !isfinite(y)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return fmod(x,y);
+  return math_fmod( x, y );
 }
 
 /*********************************************************************
@@ -420,9 +571,7 @@ double CDECL MSVCRT_fmod( double x, double y )
  */
 double CDECL MSVCRT_log( double x)
 {
-  if (x < 0.0 || !isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  if (x == 0.0) *MSVCRT__errno() = MSVCRT_ERANGE;
-  return log(x);
+  return math_log( x );
 }
 
 /*********************************************************************
@@ -430,9 +579,7 @@ double CDECL MSVCRT_log( double x)
  */
 double CDECL MSVCRT_log10( double x )
 {
-  if (x < 0.0 || !isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  if (x == 0.0) *MSVCRT__errno() = MSVCRT_ERANGE;
-  return log10(x);
+  return math_log10( x );
 }
 
 /*********************************************************************
@@ -440,10 +587,7 @@ double CDECL MSVCRT_log10( double x )
  */
 double CDECL MSVCRT_pow( double x, double y )
 {
-  /* FIXME: If x < 0 and y is not integral, set EDOM */
-  double z = pow(x,y);
-  if (!isfinite(z)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return z;
+  return math_pow( x, y );
 }
 
 /*********************************************************************
@@ -451,8 +595,7 @@ double CDECL MSVCRT_pow( double x, double y )
  */
 double CDECL MSVCRT_sin( double x )
 {
-  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return sin(x);
+  return math_sin( x );
 }
 
 /*********************************************************************
@@ -460,8 +603,7 @@ double CDECL MSVCRT_sin( double x )
  */
 double CDECL MSVCRT_sinh( double x )
 {
-  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return sinh(x);
+  return math_sinh( x );
 }
 
 /*********************************************************************
@@ -469,8 +611,7 @@ double CDECL MSVCRT_sinh( double x )
  */
 double CDECL MSVCRT_sqrt( double x )
 {
-  if (x < 0.0 || !isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return sqrt(x);
+  return math_sqrt( x );
 }
 
 /*********************************************************************
@@ -478,8 +619,7 @@ double CDECL MSVCRT_sqrt( double x )
  */
 double CDECL MSVCRT_tan( double x )
 {
-  if (!isfinite(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return tan(x);
+  return math_tan( x );
 }
 
 /*********************************************************************
@@ -487,8 +627,7 @@ double CDECL MSVCRT_tan( double x )
  */
 double CDECL MSVCRT_tanh( double x )
 {
-  if (isnan(x)) *MSVCRT__errno() = MSVCRT_EDOM;
-  return tanh(x);
+  return math_tanh( x );
 }
 
 
@@ -506,7 +645,7 @@ double CDECL MSVCRT_tanh( double x )
 double CDECL _CIacos(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_acos(x);
+  return math_acos(x);
 }
 
 /*********************************************************************
@@ -515,7 +654,7 @@ double CDECL _CIacos(void)
 double CDECL _CIasin(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_asin(x);
+  return math_asin(x);
 }
 
 /*********************************************************************
@@ -524,7 +663,7 @@ double CDECL _CIasin(void)
 double CDECL _CIatan(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_atan(x);
+  return math_atan(x);
 }
 
 /*********************************************************************
@@ -533,7 +672,7 @@ double CDECL _CIatan(void)
 double CDECL _CIatan2(void)
 {
   FPU_DOUBLES(x,y);
-  return MSVCRT_atan2(x,y);
+  return math_atan2(x,y);
 }
 
 /*********************************************************************
@@ -542,7 +681,7 @@ double CDECL _CIatan2(void)
 double CDECL _CIcos(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_cos(x);
+  return math_cos(x);
 }
 
 /*********************************************************************
@@ -551,7 +690,7 @@ double CDECL _CIcos(void)
 double CDECL _CIcosh(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_cosh(x);
+  return math_cosh(x);
 }
 
 /*********************************************************************
@@ -560,7 +699,7 @@ double CDECL _CIcosh(void)
 double CDECL _CIexp(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_exp(x);
+  return math_exp(x);
 }
 
 /*********************************************************************
@@ -569,7 +708,7 @@ double CDECL _CIexp(void)
 double CDECL _CIfmod(void)
 {
   FPU_DOUBLES(x,y);
-  return MSVCRT_fmod(x,y);
+  return math_fmod(x,y);
 }
 
 /*********************************************************************
@@ -578,7 +717,7 @@ double CDECL _CIfmod(void)
 double CDECL _CIlog(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_log(x);
+  return math_log(x);
 }
 
 /*********************************************************************
@@ -587,7 +726,7 @@ double CDECL _CIlog(void)
 double CDECL _CIlog10(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_log10(x);
+  return math_log10(x);
 }
 
 /*********************************************************************
@@ -596,7 +735,7 @@ double CDECL _CIlog10(void)
 double CDECL _CIpow(void)
 {
   FPU_DOUBLES(x,y);
-  return MSVCRT_pow(x,y);
+  return math_pow(x,y);
 }
 
 /*********************************************************************
@@ -605,7 +744,7 @@ double CDECL _CIpow(void)
 double CDECL _CIsin(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_sin(x);
+  return math_sin(x);
 }
 
 /*********************************************************************
@@ -614,7 +753,7 @@ double CDECL _CIsin(void)
 double CDECL _CIsinh(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_sinh(x);
+  return math_sinh(x);
 }
 
 /*********************************************************************
@@ -623,7 +762,7 @@ double CDECL _CIsinh(void)
 double CDECL _CIsqrt(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_sqrt(x);
+  return math_sqrt(x);
 }
 
 /*********************************************************************
@@ -632,7 +771,7 @@ double CDECL _CIsqrt(void)
 double CDECL _CItan(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_tan(x);
+  return math_tan(x);
 }
 
 /*********************************************************************
@@ -641,7 +780,7 @@ double CDECL _CItan(void)
 double CDECL _CItanh(void)
 {
   FPU_DOUBLE(x);
-  return MSVCRT_tanh(x);
+  return math_tanh(x);
 }
 
 /*********************************************************************
@@ -1984,7 +2123,7 @@ void __cdecl __libm_sse2_acos(void)
 {
     double d;
     __asm__ __volatile__( "movq %%xmm0,%0" : "=m" (d) );
-    d = acos( d );
+    d = math_acos( d );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d) );
 }
 
@@ -1995,7 +2134,7 @@ void __cdecl __libm_sse2_acosf(void)
 {
     float f;
     __asm__ __volatile__( "movd %%xmm0,%0" : "=g" (f) );
-    f = acosf( f );
+    f = math_acosf( f );
     __asm__ __volatile__( "movd %0,%%xmm0" : : "g" (f) );
 }
 
@@ -2006,7 +2145,7 @@ void __cdecl __libm_sse2_asin(void)
 {
     double d;
     __asm__ __volatile__( "movq %%xmm0,%0" : "=m" (d) );
-    d = asin( d );
+    d = math_asin( d );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d) );
 }
 
@@ -2017,7 +2156,7 @@ void __cdecl __libm_sse2_asinf(void)
 {
     float f;
     __asm__ __volatile__( "movd %%xmm0,%0" : "=g" (f) );
-    f = asinf( f );
+    f = math_asinf( f );
     __asm__ __volatile__( "movd %0,%%xmm0" : : "g" (f) );
 }
 
@@ -2028,7 +2167,7 @@ void __cdecl __libm_sse2_atan(void)
 {
     double d;
     __asm__ __volatile__( "movq %%xmm0,%0" : "=m" (d) );
-    d = atan( d );
+    d = math_atan( d );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d) );
 }
 
@@ -2039,7 +2178,7 @@ void __cdecl __libm_sse2_atan2(void)
 {
     double d1, d2;
     __asm__ __volatile__( "movq %%xmm0,%0; movq %%xmm1,%1 " : "=m" (d1), "=m" (d2) );
-    d1 = atan2( d1, d2 );
+    d1 = math_atan2( d1, d2 );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d1) );
 }
 
@@ -2050,7 +2189,7 @@ void __cdecl __libm_sse2_atanf(void)
 {
     float f;
     __asm__ __volatile__( "movd %%xmm0,%0" : "=g" (f) );
-    f = atanf( f );
+    f = math_atanf( f );
     __asm__ __volatile__( "movd %0,%%xmm0" : : "g" (f) );
 }
 
@@ -2061,7 +2200,7 @@ void __cdecl __libm_sse2_cos(void)
 {
     double d;
     __asm__ __volatile__( "movq %%xmm0,%0" : "=m" (d) );
-    d = cos( d );
+    d = math_cos( d );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d) );
 }
 
@@ -2072,7 +2211,7 @@ void __cdecl __libm_sse2_cosf(void)
 {
     float f;
     __asm__ __volatile__( "movd %%xmm0,%0" : "=g" (f) );
-    f = cosf( f );
+    f = math_cosf( f );
     __asm__ __volatile__( "movd %0,%%xmm0" : : "g" (f) );
 }
 
@@ -2083,7 +2222,7 @@ void __cdecl __libm_sse2_exp(void)
 {
     double d;
     __asm__ __volatile__( "movq %%xmm0,%0" : "=m" (d) );
-    d = exp( d );
+    d = math_exp( d );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d) );
 }
 
@@ -2094,7 +2233,7 @@ void __cdecl __libm_sse2_expf(void)
 {
     float f;
     __asm__ __volatile__( "movd %%xmm0,%0" : "=g" (f) );
-    f = expf( f );
+    f = math_expf( f );
     __asm__ __volatile__( "movd %0,%%xmm0" : : "g" (f) );
 }
 
@@ -2105,7 +2244,7 @@ void __cdecl __libm_sse2_log(void)
 {
     double d;
     __asm__ __volatile__( "movq %%xmm0,%0" : "=m" (d) );
-    d = log( d );
+    d = math_log( d );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d) );
 }
 
@@ -2116,7 +2255,7 @@ void __cdecl __libm_sse2_log10(void)
 {
     double d;
     __asm__ __volatile__( "movq %%xmm0,%0" : "=m" (d) );
-    d = log10( d );
+    d = math_log10( d );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d) );
 }
 
@@ -2127,7 +2266,7 @@ void __cdecl __libm_sse2_log10f(void)
 {
     float f;
     __asm__ __volatile__( "movd %%xmm0,%0" : "=g" (f) );
-    f = log10f( f );
+    f = math_log10f( f );
     __asm__ __volatile__( "movd %0,%%xmm0" : : "g" (f) );
 }
 
@@ -2138,7 +2277,7 @@ void __cdecl __libm_sse2_logf(void)
 {
     float f;
     __asm__ __volatile__( "movd %%xmm0,%0" : "=g" (f) );
-    f = logf( f );
+    f = math_logf( f );
     __asm__ __volatile__( "movd %0,%%xmm0" : : "g" (f) );
 }
 
@@ -2149,7 +2288,7 @@ void __cdecl __libm_sse2_pow(void)
 {
     double d1, d2;
     __asm__ __volatile__( "movq %%xmm0,%0; movq %%xmm1,%1 " : "=m" (d1), "=m" (d2) );
-    d1 = pow( d1, d2 );
+    d1 = math_pow( d1, d2 );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d1) );
 }
 
@@ -2160,7 +2299,7 @@ void __cdecl __libm_sse2_powf(void)
 {
     float f1, f2;
     __asm__ __volatile__( "movd %%xmm0,%0; movd %%xmm1,%1" : "=g" (f1), "=g" (f2) );
-    f1 = powf( f1, f2 );
+    f1 = math_powf( f1, f2 );
     __asm__ __volatile__( "movd %0,%%xmm0" : : "g" (f1) );
 }
 
@@ -2171,7 +2310,7 @@ void __cdecl __libm_sse2_sin(void)
 {
     double d;
     __asm__ __volatile__( "movq %%xmm0,%0" : "=m" (d) );
-    d = sin( d );
+    d = math_sin( d );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d) );
 }
 
@@ -2182,7 +2321,7 @@ void __cdecl __libm_sse2_sinf(void)
 {
     float f;
     __asm__ __volatile__( "movd %%xmm0,%0" : "=g" (f) );
-    f = sinf( f );
+    f = math_sinf( f );
     __asm__ __volatile__( "movd %0,%%xmm0" : : "g" (f) );
 }
 
@@ -2193,7 +2332,7 @@ void __cdecl __libm_sse2_tan(void)
 {
     double d;
     __asm__ __volatile__( "movq %%xmm0,%0" : "=m" (d) );
-    d = tan( d );
+    d = math_tan( d );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d) );
 }
 
@@ -2204,7 +2343,7 @@ void __cdecl __libm_sse2_tanf(void)
 {
     float f;
     __asm__ __volatile__( "movd %%xmm0,%0" : "=g" (f) );
-    f = tanf( f );
+    f = math_tanf( f );
     __asm__ __volatile__( "movd %0,%%xmm0" : : "g" (f) );
 }
 
@@ -2215,7 +2354,7 @@ void __cdecl __libm_sse2_sqrt_precise(void)
 {
     double d;
     __asm__ __volatile__( "movq %%xmm0,%0" : "=m" (d) );
-    d = sqrt( d );
+    d = math_sqrt( d );
     __asm__ __volatile__( "movq %0,%%xmm0" : : "m" (d) );
 }
 
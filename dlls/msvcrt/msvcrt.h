@@ -242,7 +242,9 @@ struct __thread_data {
     int                             unk9[3];
     DWORD                           cached_cp;
     char                            cached_locale[131];
-    void                           *unk10[100];
+    char                           *stream_buffer;      /* buffer for printf to unbuffered streams */
+    struct sb_cache                *sb_cache;           /* free small blocks heap blocks */
+    void                           *unk10[98];
 };
 
 typedef struct __thread_data thread_data_t;
@@ -302,6 +304,7 @@ extern void msvcrt_free_signals(void) DECLSPEC_HIDDEN;
 extern void msvcrt_free_popen_data(void) DECLSPEC_HIDDEN;
 extern BOOL msvcrt_init_heap(void) DECLSPEC_HIDDEN;
 extern void msvcrt_destroy_heap(void) DECLSPEC_HIDDEN;
+extern void msvcrt_free_heap_cache(thread_data_t*) DECLSPEC_HIDDEN;
 
 extern unsigned msvcrt_create_io_inherit_block(WORD*, BYTE**) DECLSPEC_HIDDEN;
 
@@ -1009,6 +1012,33 @@ void free_locinfo(MSVCRT_pthreadlocinfo) DECLSPEC_HIDDEN;
 void free_mbcinfo(MSVCRT_pthreadmbcinfo) DECLSPEC_HIDDEN;
 int _setmbcp_l(int, LCID, MSVCRT_pthreadmbcinfo) DECLSPEC_HIDDEN;
 
+/* enough significant digits to round any decimal number correctly to a double */
+#define FPNUM_DIGITS 800
+
+/* decimal digits of a floating point number, value is digits * 10^exp */
+struct fpnum
+{
+    int  count;
+    int  exp;
+    BOOL dropped;   /* nonzero digits were dropped past FPNUM_DIGITS */
+    char digits[FPNUM_DIGITS];
+};
+
+static inline void fpnum_add_digit(struct fpnum *fp, int digit, BOOL fraction)
+{
+    if(!fp->count && !digit) {
+        if(fraction) fp->exp--;
+    } else if(fp->count < FPNUM_DIGITS) {
+        fp->digits[fp->count++] = '0' + digit;
+        if(fraction) fp->exp--;
+    } else {
+        if(!fraction) fp->exp++;
+        if(digit) fp->dropped = TRUE;
+    }
+}
+
+double fpnum_double(struct fpnum*, int) DECLSPEC_HIDDEN;
+
 #ifndef __WINE_MSVCRT_TEST
 int            __cdecl MSVCRT__write(int,const void*,unsigned int);
 int            __cdecl _getch(void);
@@ -304,17 +304,129 @@ void CDECL MSVCRT__swab(char* src, char* dst, int len)
   }
 }
 
-static double strtod_helper(const char *str, char **end, MSVCRT__locale_t locale, int *err)
+static const double fpnum_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* strips trailing zeros, returns the number of significant digits */
+static int fpnum_trim(const struct fpnum *fp, int exp, LONGLONG *e)
+{
+    int count = fp->count;
+
+    *e = (LONGLONG)fp->exp + exp;
+    if(count && !fp->dropped) {
+        while(fp->digits[count-1] == '0') {
+            count--;
+            (*e)++;
+        }
+    }
+    return count;
+}
+
+static ULONGLONG fpnum_mantissa(const struct fpnum *fp, int count)
+{
+    ULONGLONG m = 0;
+    int i;
+
+    for(i=0; i<count; i++)
+        m = m*10 + fp->digits[i] - '0';
+    return m;
+}
+
+/* formats the digits for the host strtod and strtof, without a decimal point */
+static void fpnum_format(const struct fpnum *fp, int count, LONGLONG e, char *buf)
+{
+    /* the result is 0 or infinity well before these exponents */
+    if(e > 10000)
+        e = 10000;
+    else if(e < -10000)
+        e = -10000;
+
+    memcpy(buf, fp->digits, count);
+    if(fp->dropped) {
+        buf[count++] = '1';
+        e--;
+    }
+    sprintf(buf+count, "e%d", (int)e);
+}
+
+/*********************************************************************
+ *		fpnum_double (INTERNAL)
+ *
+ * Rounds the digits times 10^exp to the nearest double. Numbers that are
+ * exactly representable take a single floating point operation, the
+ * others go through the correctly rounded host strtod.
+ */
+double fpnum_double(struct fpnum *fp, int exp)
+{
+    char buf[FPNUM_DIGITS + 16];
+    ULONGLONG m;
+    LONGLONG e;
+    int count = fpnum_trim(fp, exp, &e);
+
+    if(!count)
+        return 0.0;
+
+    /* up to 15 digits and 10^22 are exact doubles */
+    if(count <= 15) {
+        m = fpnum_mantissa(fp, count);
+        if(e>=0 && e<=22+15-count) {
+            for(; e>22; e--)
+                m *= 10;
+            return (double)m * fpnum_pow10[e];
+        }
+        if(e<0 && e>=-22)
+            return (double)m / fpnum_pow10[-e];
+    }
+
+    fpnum_format(fp, count, e, buf);
+    return strtod(buf, NULL);
+}
+
+/*********************************************************************
+ *		fpnum_float (INTERNAL)
+ *
+ * Rounds the digits times 10^exp to the nearest float. Rounding to a
+ * double first and narrowing that would round twice, which is wrong for
+ * numbers just above halfway between two floats.
+ */
+static float fpnum_float(struct fpnum *fp, int exp)
+{
+    char buf[FPNUM_DIGITS + 16];
+    ULONGLONG m;
+    LONGLONG e;
+    int count = fpnum_trim(fp, exp, &e);
+
+    if(!count)
+        return 0.0f;
+
+    /* up to 7 digits and 10^10 are exact floats. A double has more than
+     * twice their precision, so one double operation on them followed by
+     * the narrowing still rounds correctly. */
+    if(count <= 7 && e>=-10 && e<=10) {
+        m = fpnum_mantissa(fp, count);
+        if(e >= 0)
+            return (double)m * fpnum_pow10[e];
+        return (double)m / fpnum_pow10[-e];
+    }
+
+    fpnum_format(fp, count, e, buf);
+    return strtof(buf, NULL);
+}
+
+static double strtod_helper(const char *str, char **end, MSVCRT__locale_t locale, int *err, BOOL flt)
 {
     MSVCRT_pthreadlocinfo locinfo;
     unsigned __int64 d=0, hlp;
     unsigned fpcontrol;
-    int exp=0, sign=1;
+    int exp=0, exp10=0, sign=1;
     const char *p;
     double ret;
     long double lret=1, expcnt = 10;
     BOOL found_digit = FALSE, negexp;
     int base = 10;
+    struct fpnum fp;
 
     if(err)
         *err = 0;
@@ -329,6 +441,9 @@ static double strtod_helper(const char *str, char **end, MSVCRT__locale_t locale
     else
         locinfo = locale->locinfo;
 
+    fp.count = fp.exp = 0;
+    fp.dropped = FALSE;
+
     /* FIXME: use *_l functions */
     p = str;
     while(isspace(*p))
@@ -375,6 +490,8 @@ static double strtod_helper(const char *str, char **end, MSVCRT__locale_t locale
             val = 10 + c - 'a';
         else
             val = 10 + c - 'A';
+        if(base == 10)
+            fpnum_add_digit(&fp, val, FALSE);
         hlp = d*base+val;
         if(d>MSVCRT_UI64_MAX/base || hlp<d) {
             exp++;
@@ -384,6 +501,8 @@ static double strtod_helper(const char *str, char **end, MSVCRT__locale_t locale
     }
     while(isdigit(*p) ||
           (base == 16 && ((*p >= 'a' && *p <= 'f') || (*p >= 'A' && *p <= 'F')))) {
+        if(base == 10)
+            fpnum_add_digit(&fp, *p - '0', FALSE);
         exp++;
         p++;
     }
@@ -402,6 +521,8 @@ static double strtod_helper(const char *str, char **end, MSVCRT__locale_t locale
             val = 10 + c - 'a';
         else
             val = 10 + c - 'A';
+        if(base == 10)
+            fpnum_add_digit(&fp, val, TRUE);
         hlp = d*base+val;
         if(d>MSVCRT_UI64_MAX/base || hlp<d)
             break;
@@ -409,8 +530,11 @@ static double strtod_helper(const char *str, char **end, MSVCRT__locale_t locale
         exp--;
     }
     while(isdigit(*p) ||
-          (base == 16 && ((*p >= 'a' && *p <= 'f') || (*p >= 'A' && *p <= 'F'))))
+          (base == 16 && ((*p >= 'a' && *p <= 'f') || (*p >= 'A' && *p <= 'F')))) {
+        if(base == 10)
+            fpnum_add_digit(&fp, *p - '0', TRUE);
         p++;
+    }
 
     if(!found_digit) {
         if(end)
@@ -439,6 +563,7 @@ static double strtod_helper(const char *str, char **end, MSVCRT__locale_t locale
                 p++;
             }
             e *= s;
+            exp10 = e;
 
             if(exp<0 && e<0 && exp+e>=0) exp = INT_MIN;
             else if(exp>0 && e>0 && exp+e<0) exp = INT_MAX;
@@ -452,18 +577,23 @@ static double strtod_helper(const char *str, char **end, MSVCRT__locale_t locale
 
     fpcontrol = _control87(0, 0);
     _control87(MSVCRT__EM_DENORMAL|MSVCRT__EM_INVALID|MSVCRT__EM_ZERODIVIDE
-            |MSVCRT__EM_OVERFLOW|MSVCRT__EM_UNDERFLOW|MSVCRT__EM_INEXACT, 0xffffffff);
-
-    negexp = (exp < 0);
-    if(negexp)
-        exp = -exp;
-    while(exp) {
-        if(exp & 1)
-            lret *= expcnt;
-        exp /= 2;
-        expcnt = expcnt*expcnt;
+            |MSVCRT__EM_OVERFLOW|MSVCRT__EM_UNDERFLOW|MSVCRT__EM_INEXACT
+            |(base == 10 ? MSVCRT__PC_53 : MSVCRT__PC_64), 0xffffffff);
+
+    if(base == 10) {
+        ret = sign * (flt ? fpnum_float(&fp, exp10) : fpnum_double(&fp, exp10));
+    } else {
+        negexp = (exp < 0);
+        if(negexp)
+            exp = -exp;
+        while(exp) {
+            if(exp & 1)
+                lret *= expcnt;
+            exp /= 2;
+            expcnt = expcnt*expcnt;
+        }
+        ret = (long double)sign * (negexp ? d/lret : d*lret);
     }
-    ret = (long double)sign * (negexp ? d/lret : d*lret);
 
     _control87(fpcontrol, 0xffffffff);
 
@@ -485,7 +615,7 @@ static double strtod_helper(const char *str, char **end, MSVCRT__locale_t locale
  */
 double CDECL MSVCRT_strtod_l(const char *str, char **end, MSVCRT__locale_t locale)
 {
-    return strtod_helper(str, end, locale, NULL);
+    return strtod_helper(str, end, locale, NULL, FALSE);
 }
 
 /*********************************************************************
@@ -520,7 +650,7 @@ int CDECL MSVCRT__atoflt_l( MSVCRT__CRT_FLOAT *value, char *str, MSVCRT__locale_
     double d;
     int err;
 
-    d = strtod_helper(str, NULL, locale, &err);
+    d = strtod_helper(str, NULL, locale, &err, TRUE);
     value->f = d;
     if(isinf(value->f))
         return MSVCRT__OVERFLOW;
@@ -544,7 +674,7 @@ int CDECL MSVCRT__atodbl_l(MSVCRT__CRT_DOUBLE *value, char *str, MSVCRT__locale_
 {
     int err;
 
-    value->x = strtod_helper(str, NULL, locale, &err);
+    value->x = strtod_helper(str, NULL, locale, &err, FALSE);
     if(isinf(value->x))
         return MSVCRT__OVERFLOW;
     if((value->x!=0 || err) && value->x>-MSVCRT_DBL_MIN && value->x<MSVCRT_DBL_MIN)
@@ -585,6 +585,63 @@ static void test_fputc( void )
   free(tempf);
 }
 
+static void test_fprintf_unbuffered( void )
+{
+  char* tempf;
+  FILE *tempfh;
+  char buf[6000];
+  int  i, ret;
+
+  tempf=_tempnam(".","wne");
+  tempfh = fopen(tempf,"wb");
+  setvbuf(tempfh,NULL,_IONBF,0);
+  for (i = 0; i < 3; i++)
+  {
+    ret = fprintf(tempfh, "%d %s %.2000d\n", i, "abc", 42);
+    ok(ret == 2007, "fprintf returned %d\n", ret);
+    ok(tempfh->_cnt == 0, "_cnt = %d\n", tempfh->_cnt);
+    ok(tempfh->_bufsiz == 2, "_bufsiz = %d\n", tempfh->_bufsiz);
+  }
+  fclose(tempfh);
+
+  tempfh = fopen(tempf,"rb");
+  ret = fread(buf, 1, sizeof(buf), tempfh);
+  ok(ret == 3 * 2007, "read %d bytes\n", ret);
+  for (i = 0; i < 3; i++)
+  {
+    ok(buf[i * 2007] == '0' + i, "got %c\n", buf[i * 2007]);
+    ok(!memcmp(buf + i * 2007 + 1, " abc 00", 7), "got %.7s\n", buf + i * 2007 + 1);
+    ok(!memcmp(buf + i * 2007 + 2004, "42\n", 3), "got %.3s\n", buf + i * 2007 + 2004);
+  }
+  fclose(tempfh);
+
+  /* read-only streams */
+  tempfh = fopen(tempf,"rb");
+  setvbuf(tempfh,NULL,_IONBF,0);
+  ret = fprintf(tempfh, "%d %s", 1, "abc");
+  ok(ret < 0, "fprintf returned %d\n", ret);
+  ok(ferror(tempfh), "ferror not set\n");
+  fclose(tempfh);
+
+  /* update streams */
+  tempfh = fopen(tempf,"w+");
+  setvbuf(tempfh,NULL,_IONBF,0);
+  ret = fprintf(tempfh, "%d %s %.2000d\n", 7, "abc", 42);
+  ok(ret == 2007, "fprintf returned %d\n", ret);
+  ret = fprintf(tempfh, "%s", "end");
+  ok(ret == 3, "fprintf returned %d\n", ret);
+  fseek(tempfh, 0, SEEK_SET);
+  memset(buf, 0, sizeof(buf));
+  ret = fread(buf, 1, sizeof(buf), tempfh);
+  ok(ret == 2010, "read %d bytes\n", ret);
+  ok(!memcmp(buf, "7 abc 00", 8), "got %.8s\n", buf);
+  ok(!memcmp(buf + 2004, "42\nend", 6), "got %.6s\n", buf + 2004);
+  fclose(tempfh);
+
+  unlink(tempf);
+  free(tempf);
+}
+
 static void test_flsbuf( void )
 {
   char* tempf;
@@ -2372,6 +2429,7 @@ START_TEST(file)
     test_readboundary();
     test_fgetc();
     test_fputc();
+    test_fprintf_unbuffered();
     test_flsbuf();
     test_fflush();
     test_fgetwc();
@@ -448,6 +448,18 @@ static void test_sbheap(void)
     mem = realloc(mem, 10);
     ok(mem != NULL, "realloc failed\n");
     ok(!((UINT_PTR)mem & 0xf), "incorrect alignement (%p)\n", mem);
+    ok(_msize(mem) == 10, "_msize returned %d\n", (int)_msize(mem));
+
+    memset(mem, 0xcc, 10);
+    mem = realloc(mem, 2000);
+    ok(mem != NULL, "realloc failed\n");
+    ok(_msize(mem) == 2000, "_msize returned %d\n", (int)_msize(mem));
+    ok(((unsigned char *)mem)[9] == 0xcc, "data not preserved\n");
+
+    mem = realloc(mem, 100);
+    ok(mem != NULL, "realloc failed\n");
+    ok(_msize(mem) == 100, "_msize returned %d\n", (int)_msize(mem));
+    ok(((unsigned char *)mem)[9] == 0xcc, "data not preserved\n");
 
     ok(_set_sbh_threshold(0), "_set_sbh_threshold failed\n");
     threshold = _get_sbh_threshold();
@@ -28,6 +28,7 @@
 #include <locale.h>
 #include <errno.h>
 #include <limits.h>
+#include <float.h>
 #include <math.h>
 
 /* make it use a definition from string.h */
@@ -90,6 +91,7 @@ static int (__cdecl *p_tolower)(int);
 static size_t (__cdecl *p_mbrlen)(const char*, size_t, mbstate_t*);
 static size_t (__cdecl *p_mbrtowc)(wchar_t*, const char*, size_t, mbstate_t*);
 static int (__cdecl *p__atodbl_l)(_CRT_DOUBLE*,char*,_locale_t);
+static int (__cdecl *p__atoflt_l)(_CRT_FLOAT*,char*,_locale_t);
 static double (__cdecl *p__atof_l)(const char*,_locale_t);
 static double (__cdecl *p__strtod_l)(const char *,char**,_locale_t);
 static int (__cdecl *p__strnset_s)(char*,size_t,int,size_t);
@@ -1817,6 +1819,14 @@ static void test__strtod(void)
     ok(almost_equal(d, 0.1e238L), "d = %lf\n", d);
     d = strtod("0.1D-4736", NULL);
     ok(almost_equal(d, 0.1e-4736L), "d = %lf\n", d);
+    d = strtod("0.1", NULL);
+    ok(d == 0.1, "d = %.17g\n", d);
+    d = strtod("123.456", NULL);
+    ok(d == 123.456, "d = %.17g\n", d);
+    d = strtod("1.7976931348623157e308", NULL);
+    ok(d == DBL_MAX, "d = %.17g\n", d);
+    d = strtod("2.2250738585072014e-308", NULL);
+    ok(d == DBL_MIN, "d = %.17g\n", d);
 
     errno = 0xdeadbeef;
     strtod(overflow, &end);
@@ -2738,6 +2748,43 @@ static void test__atodbl(void)
     ok(ret == _OVERFLOW, "_atodbl(&d, \"1e309\") returned %d, expected _OVERFLOW\n", ret);
 }
 
+static void test__atoflt(void)
+{
+    _CRT_FLOAT f;
+    char num[64];
+    int ret;
+
+    if(!p__atoflt_l) {
+        win_skip("_atoflt_l is not available\n");
+        return;
+    }
+
+    strcpy(num, "0.1");
+    ret = p__atoflt_l(&f, num, NULL);
+    ok(ret == 0, "_atoflt_l(&f, \"0.1\", NULL) returned %d, expected 0\n", ret);
+    ok(f.f == 0.1f, "f.f = %.9g\n", f.f);
+
+    /* exactly halfway between 1 and the next float, rounds to even */
+    strcpy(num, "1.000000059604644775390625");
+    ret = p__atoflt_l(&f, num, NULL);
+    ok(ret == 0, "_atoflt_l(&f, \"%s\", NULL) returned %d, expected 0\n", num, ret);
+    ok(f.f == 1.0f, "f.f = %.9g\n", f.f);
+
+    /* just above halfway, but rounds to the halfway point as a double */
+    strcpy(num, "1.00000005960464477539062500001");
+    ret = p__atoflt_l(&f, num, NULL);
+    ok(ret == 0, "_atoflt_l(&f, \"%s\", NULL) returned %d, expected 0\n", num, ret);
+    ok(f.f == 1.0f + FLT_EPSILON, "f.f = %.9g\n", f.f);
+
+    strcpy(num, "1e39");
+    ret = p__atoflt_l(&f, num, NULL);
+    ok(ret == _OVERFLOW, "_atoflt_l(&f, \"1e39\", NULL) returned %d, expected _OVERFLOW\n", ret);
+
+    strcpy(num, "1e-46");
+    ret = p__atoflt_l(&f, num, NULL);
+    ok(ret == _UNDERFLOW, "_atoflt_l(&f, \"1e-46\", NULL) returned %d, expected _UNDERFLOW\n", ret);
+}
+
 static void test__stricmp(void)
 {
     int ret;
@@ -3107,6 +3154,7 @@ START_TEST(string)
     p_mbrtowc = (void*)GetProcAddress(hMsvcrt, "mbrtowc");
     p_mbsrtowcs = (void*)GetProcAddress(hMsvcrt, "mbsrtowcs");
     p__atodbl_l = (void*)GetProcAddress(hMsvcrt, "_atodbl_l");
+    p__atoflt_l = (void*)GetProcAddress(hMsvcrt, "_atoflt_l");
     p__atof_l = (void*)GetProcAddress(hMsvcrt, "_atof_l");
     p__strtod_l = (void*)GetProcAddress(hMsvcrt, "_strtod_l");
     p__strnset_s = (void*)GetProcAddress(hMsvcrt, "_strnset_s");
@@ -3163,6 +3211,7 @@ START_TEST(string)
     test_wctob();
     test_wctomb();
     test__atodbl();
+    test__atoflt();
     test__stricmp();
     test__wcstoi64();
     test_atoi();
@@ -349,13 +349,12 @@ double CDECL MSVCRT__wcstod_l(const MSVCRT_wchar_t* str, MSVCRT_wchar_t** end,
         MSVCRT__locale_t locale)
 {
     MSVCRT_pthreadlocinfo locinfo;
-    unsigned __int64 d=0, hlp;
     unsigned fpcontrol;
     int exp=0, sign=1;
     const MSVCRT_wchar_t *p;
     double ret;
-    long double lret=1, expcnt = 10;
-    BOOL found_digit = FALSE, negexp;
+    BOOL found_digit = FALSE;
+    struct fpnum fp;
 
     if (!MSVCRT_CHECK_PMT(str != NULL)) return 0;
 
@@ -364,6 +363,9 @@ double CDECL MSVCRT__wcstod_l(const MSVCRT_wchar_t* str, MSVCRT_wchar_t** end,
     else
         locinfo = locale->locinfo;
 
+    fp.count = fp.exp = 0;
+    fp.dropped = FALSE;
+
     p = str;
     while(isspaceW(*p))
         p++;
@@ -376,31 +378,15 @@ double CDECL MSVCRT__wcstod_l(const MSVCRT_wchar_t* str, MSVCRT_wchar_t** end,
 
     while(isdigitW(*p)) {
         found_digit = TRUE;
-        hlp = d*10+*(p++)-'0';
-        if(d>MSVCRT_UI64_MAX/10 || hlp<d) {
-            exp++;
-            break;
-        } else
-            d = hlp;
-    }
-    while(isdigitW(*p)) {
-        exp++;
-        p++;
+        fpnum_add_digit(&fp, *p++ - '0', FALSE);
     }
     if(*p == *locinfo->lconv->decimal_point)
         p++;
 
     while(isdigitW(*p)) {
         found_digit = TRUE;
-        hlp = d*10+*(p++)-'0';
-        if(d>MSVCRT_UI64_MAX/10 || hlp<d)
-            break;
-
-        d = hlp;
-        exp--;
+        fpnum_add_digit(&fp, *p++ - '0', TRUE);
     }
-    while(isdigitW(*p))
-        p++;
 
     if(!found_digit) {
         if(end)
@@ -424,11 +410,7 @@ double CDECL MSVCRT__wcstod_l(const MSVCRT_wchar_t* str, MSVCRT_wchar_t** end,
                     e = INT_MAX;
                 p++;
             }
-            e *= s;
-
-            if(exp<0 && e<0 && exp+e>=0) exp = INT_MIN;
-            else if(exp>0 && e>0 && exp+e<0) exp = INT_MAX;
-            else exp += e;
+            exp = e * s;
         } else {
             if(*p=='-' || *p=='+')
                 p--;
@@ -438,22 +420,13 @@ double CDECL MSVCRT__wcstod_l(const MSVCRT_wchar_t* str, MSVCRT_wchar_t** end,
 
     fpcontrol = _control87(0, 0);
     _control87(MSVCRT__EM_DENORMAL|MSVCRT__EM_INVALID|MSVCRT__EM_ZERODIVIDE
-            |MSVCRT__EM_OVERFLOW|MSVCRT__EM_UNDERFLOW|MSVCRT__EM_INEXACT, 0xffffffff);
-
-    negexp = (exp < 0);
-    if(negexp)
-        exp = -exp;
-    while(exp) {
-        if(exp & 1)
-            lret *= expcnt;
-        exp /= 2;
-        expcnt = expcnt*expcnt;
-    }
-    ret = (long double)sign * (negexp ? d/lret : d*lret);
+            |MSVCRT__EM_OVERFLOW|MSVCRT__EM_UNDERFLOW|MSVCRT__EM_INEXACT|MSVCRT__PC_53, 0xffffffff);
+
+    ret = sign * fpnum_double(&fp, exp);
 
     _control87(fpcontrol, 0xffffffff);
 
-    if((d && ret==0.0) || isinf(ret))
+    if((fp.count && ret==0.0) || isinf(ret))
         *MSVCRT__errno() = MSVCRT_ERANGE;
 
     if(end)
@@ -2192,22 +2165,6 @@ int CDECL MSVCRT_towlower(MSVCRT_wint_t c)
     return MSVCRT__towlower_l(c, NULL);
 }
 
-/*********************************************************************
- *              wcschr (MSVCRT.@)
- */
-MSVCRT_wchar_t* CDECL MSVCRT_wcschr(const MSVCRT_wchar_t *str, MSVCRT_wchar_t ch)
-{
-    return strchrW(str, ch);
-}
-
-/***********************************************************************
- *              wcslen (MSVCRT.@)
- */
-int CDECL MSVCRT_wcslen(const MSVCRT_wchar_t *str)
-{
-    return strlenW(str);
-}
-
 /*********************************************************************
  *              wcsstr (MSVCRT.@)
  */
@@ -37,6 +37,7 @@
 #include "wine/exception.h"
 #include "wine/debug.h"
 #include "wine/unicode.h"
+#include "wine/list.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(actctx);
 
@@ -530,15 +531,72 @@ typedef struct _ACTIVATION_CONTEXT
     struct guidsection_header *comserver_section;
     struct guidsection_header *ifaceps_section;
     struct guidsection_header *clrsurrogate_section;
+    /* hash tables of the section indexes */
+    struct section_hash *wndclass_hash;
+    struct section_hash *dllredirect_hash;
+    struct section_hash *progid_hash;
+    struct section_hash *tlib_hash;
+    struct section_hash *comserver_hash;
+    struct section_hash *ifaceps_hash;
+    struct section_hash *clrsurrogate_hash;
 } ACTIVATION_CONTEXT;
 
+/* open addressing hash table pointing into the index of a string or guid section */
+struct section_hash
+{
+    ULONG mask;      /* table size - 1 */
+    ULONG slots[1];  /* index entry + 1, 0 for empty slots */
+};
+
 struct actctx_loader
 {
     ACTIVATION_CONTEXT       *actctx;
     struct assembly_identity *dependencies;
     unsigned int              num_dependencies;
     unsigned int              allocated_dependencies;
+    struct manifest_cache_entry *cache_entry;  /* cache entry being filled by the parser */
+};
+
+/* Parsed manifests are kept around so that manifest files that are referenced
+ * repeatedly (typically shared assemblies like common controls) are only
+ * parsed once per process. Entries are keyed by file identity, so that a
+ * modified file is parsed again. */
+
+struct manifest_cache_key
+{
+    LARGE_INTEGER index;        /* file id */
+    LARGE_INTEGER change_time;
+    LARGE_INTEGER write_time;
+    LARGE_INTEGER size;
+    ULONG_PTR     resid;        /* resource id for PE files, 0 for manifest files */
+    ULONG         lang;
+    BOOL          shared;
+};
+
+struct manifest_cache_entry
+{
+    struct list               entry;
+    struct manifest_cache_key key;
+    struct assembly           assembly;
+    struct assembly_identity *dependencies;
+    unsigned int              num_dependencies;
+    unsigned int              allocated_dependencies;
+    DWORD                     sections;
+};
+
+#define MANIFEST_CACHE_SIZE 32
+
+static struct list manifest_cache = LIST_INIT( manifest_cache );
+static unsigned int manifest_cache_count;
+
+static RTL_CRITICAL_SECTION manifest_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG manifest_cache_section_debug =
+{
+    0, 0, &manifest_cache_section,
+    { &manifest_cache_section_debug.ProcessLocksList, &manifest_cache_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": manifest_cache_section") }
 };
+static RTL_CRITICAL_SECTION manifest_cache_section = { &manifest_cache_section_debug, -1, 0, 0, 0, 0 };
 
 static const WCHAR asmv1W[] = {'a','s','m','v','1',':',0};
 static const WCHAR asmv2W[] = {'a','s','m','v','2',':',0};
@@ -873,6 +931,152 @@ static void free_entity_array(struct entity_array *array)
     RtlFreeHeap( GetProcessHeap(), 0, array->base );
 }
 
+static BOOL copy_string( WCHAR **dst, const WCHAR *src )
+{
+    if (!src)
+    {
+        *dst = NULL;
+        return TRUE;
+    }
+    return (*dst = strdupW( src )) != NULL;
+}
+
+static BOOL copy_assembly_identity( struct assembly_identity *dst, const struct assembly_identity *src )
+{
+    *dst = *src;
+    dst->name = dst->arch = dst->public_key = dst->language = dst->type = NULL;
+    return copy_string( &dst->name, src->name ) &&
+           copy_string( &dst->arch, src->arch ) &&
+           copy_string( &dst->public_key, src->public_key ) &&
+           copy_string( &dst->language, src->language ) &&
+           copy_string( &dst->type, src->type );
+}
+
+static BOOL copy_entity( struct entity *dst, const struct entity *src )
+{
+    unsigned int i;
+
+    dst->kind = src->kind;
+    switch (src->kind)
+    {
+    case ACTIVATION_CONTEXT_SECTION_COM_SERVER_REDIRECTION:
+        dst->u.comclass = src->u.comclass;
+        dst->u.comclass.clsid = dst->u.comclass.tlbid = dst->u.comclass.progid = NULL;
+        dst->u.comclass.name = dst->u.comclass.version = NULL;
+        dst->u.comclass.progids.progids = NULL;
+        dst->u.comclass.progids.num = dst->u.comclass.progids.allocated = 0;
+        if (!copy_string( &dst->u.comclass.clsid, src->u.comclass.clsid ) ||
+            !copy_string( &dst->u.comclass.tlbid, src->u.comclass.tlbid ) ||
+            !copy_string( &dst->u.comclass.progid, src->u.comclass.progid ) ||
+            !copy_string( &dst->u.comclass.name, src->u.comclass.name ) ||
+            !copy_string( &dst->u.comclass.version, src->u.comclass.version ))
+            return FALSE;
+        if (src->u.comclass.progids.num)
+        {
+            if (!(dst->u.comclass.progids.progids = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                     src->u.comclass.progids.num * sizeof(WCHAR *) )))
+                return FALSE;
+            dst->u.comclass.progids.allocated = src->u.comclass.progids.num;
+            for (i = 0; i < src->u.comclass.progids.num; i++)
+            {
+                if (!copy_string( &dst->u.comclass.progids.progids[i], src->u.comclass.progids.progids[i] ))
+                    return FALSE;
+                dst->u.comclass.progids.num++;
+            }
+        }
+        return TRUE;
+    case ACTIVATION_CONTEXT_SECTION_COM_INTERFACE_REDIRECTION:
+        dst->u.ifaceps = src->u.ifaceps;
+        dst->u.ifaceps.iid = dst->u.ifaceps.base = dst->u.ifaceps.tlib = NULL;
+        dst->u.ifaceps.name = dst->u.ifaceps.ps32 = NULL;
+        return copy_string( &dst->u.ifaceps.iid, src->u.ifaceps.iid ) &&
+               copy_string( &dst->u.ifaceps.base, src->u.ifaceps.base ) &&
+               copy_string( &dst->u.ifaceps.tlib, src->u.ifaceps.tlib ) &&
+               copy_string( &dst->u.ifaceps.name, src->u.ifaceps.name ) &&
+               copy_string( &dst->u.ifaceps.ps32, src->u.ifaceps.ps32 );
+    case ACTIVATION_CONTEXT_SECTION_COM_TYPE_LIBRARY_REDIRECTION:
+        dst->u.typelib = src->u.typelib;
+        dst->u.typelib.tlbid = dst->u.typelib.helpdir = NULL;
+        return copy_string( &dst->u.typelib.tlbid, src->u.typelib.tlbid ) &&
+               copy_string( &dst->u.typelib.helpdir, src->u.typelib.helpdir );
+    case ACTIVATION_CONTEXT_SECTION_WINDOW_CLASS_REDIRECTION:
+        dst->u.class = src->u.class;
+        dst->u.class.name = NULL;
+        return copy_string( &dst->u.class.name, src->u.class.name );
+    case ACTIVATION_CONTEXT_SECTION_CLR_SURROGATES:
+        dst->u.clrsurrogate.name = dst->u.clrsurrogate.clsid = dst->u.clrsurrogate.version = NULL;
+        return copy_string( &dst->u.clrsurrogate.name, src->u.clrsurrogate.name ) &&
+               copy_string( &dst->u.clrsurrogate.clsid, src->u.clrsurrogate.clsid ) &&
+               copy_string( &dst->u.clrsurrogate.version, src->u.clrsurrogate.version );
+    default:
+        FIXME("Unknown entity kind %d\n", src->kind);
+        return FALSE;
+    }
+}
+
+static BOOL copy_entity_array( struct entity_array *dst, const struct entity_array *src )
+{
+    unsigned int i;
+
+    dst->base = NULL;
+    dst->num = dst->allocated = 0;
+    if (!src->num) return TRUE;
+
+    if (!(dst->base = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, src->num * sizeof(*dst->base) )))
+        return FALSE;
+    dst->allocated = src->num;
+    for (i = 0; i < src->num; i++)
+    {
+        /* count the entity first so that a partial copy gets freed */
+        dst->num++;
+        if (!copy_entity( &dst->base[i], &src->base[i] )) return FALSE;
+    }
+    return TRUE;
+}
+
+/* copy the parsed contents of an assembly; dst must be zero-initialized */
+static BOOL copy_assembly( struct assembly *dst, const struct assembly *src )
+{
+    unsigned int i;
+
+    dst->no_inherit = src->no_inherit;
+    if (!copy_assembly_identity( &dst->id, &src->id )) return FALSE;
+    if (!copy_entity_array( &dst->entities, &src->entities )) return FALSE;
+    if (!src->num_dlls) return TRUE;
+
+    if (!(dst->dlls = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, src->num_dlls * sizeof(*dst->dlls) )))
+        return FALSE;
+    dst->allocated_dlls = src->num_dlls;
+    for (i = 0; i < src->num_dlls; i++)
+    {
+        struct dll_redirect *dll = &dst->dlls[dst->num_dlls++];
+
+        if (!copy_string( &dll->name, src->dlls[i].name ) ||
+            !copy_string( &dll->hash, src->dlls[i].hash ) ||
+            !copy_entity_array( &dll->entities, &src->dlls[i].entities ))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void free_assembly( struct assembly *assembly )
+{
+    unsigned int i;
+
+    for (i = 0; i < assembly->num_dlls; i++)
+    {
+        struct dll_redirect *dll = &assembly->dlls[i];
+        free_entity_array( &dll->entities );
+        RtlFreeHeap( GetProcessHeap(), 0, dll->name );
+        RtlFreeHeap( GetProcessHeap(), 0, dll->hash );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, assembly->dlls );
+    RtlFreeHeap( GetProcessHeap(), 0, assembly->manifest.info );
+    RtlFreeHeap( GetProcessHeap(), 0, assembly->directory );
+    free_entity_array( &assembly->entities );
+    free_assembly_identity( &assembly->id );
+}
+
 static BOOL is_matching_string( const WCHAR *str1, const WCHAR *str2 )
 {
     if (!str1) return !str2;
@@ -956,6 +1160,47 @@ static void free_depend_manifests(struct actctx_loader* acl)
     RtlFreeHeap(GetProcessHeap(), 0, acl->dependencies);
 }
 
+static BOOL add_cached_dependency(struct manifest_cache_entry *cache, const struct assembly_identity *ai)
+{
+    if (cache->num_dependencies == cache->allocated_dependencies)
+    {
+        void *ptr;
+        unsigned int new_count;
+        if (cache->dependencies)
+        {
+            new_count = cache->allocated_dependencies * 2;
+            ptr = RtlReAllocateHeap(GetProcessHeap(), 0, cache->dependencies,
+                                    new_count * sizeof(cache->dependencies[0]));
+        }
+        else
+        {
+            new_count = 4;
+            ptr = RtlAllocateHeap(GetProcessHeap(), 0, new_count * sizeof(cache->dependencies[0]));
+        }
+        if (!ptr) return FALSE;
+        cache->dependencies = ptr;
+        cache->allocated_dependencies = new_count;
+    }
+    if (!copy_assembly_identity(&cache->dependencies[cache->num_dependencies], ai))
+    {
+        free_assembly_identity(&cache->dependencies[cache->num_dependencies]);
+        return FALSE;
+    }
+    cache->num_dependencies++;
+    return TRUE;
+}
+
+static void free_manifest_cache_entry(struct manifest_cache_entry *cache)
+{
+    unsigned int i;
+
+    for (i = 0; i < cache->num_dependencies; i++)
+        free_assembly_identity(&cache->dependencies[i]);
+    RtlFreeHeap(GetProcessHeap(), 0, cache->dependencies);
+    free_assembly(&cache->assembly);
+    RtlFreeHeap(GetProcessHeap(), 0, cache);
+}
+
 static WCHAR *build_assembly_dir(struct assembly_identity* ai)
 {
     static const WCHAR undW[] = {'_',0};
@@ -1060,24 +1305,9 @@ static void actctx_release( ACTIVATION_CONTEXT *actctx )
 {
     if (interlocked_xchg_add( &actctx->ref_count, -1 ) == 1)
     {
-        unsigned int i, j;
+        unsigned int i;
 
-        for (i = 0; i < actctx->num_assemblies; i++)
-        {
-            struct assembly *assembly = &actctx->assemblies[i];
-            for (j = 0; j < assembly->num_dlls; j++)
-            {
-                struct dll_redirect *dll = &assembly->dlls[j];
-                free_entity_array( &dll->entities );
-                RtlFreeHeap( GetProcessHeap(), 0, dll->name );
-                RtlFreeHeap( GetProcessHeap(), 0, dll->hash );
-            }
-            RtlFreeHeap( GetProcessHeap(), 0, assembly->dlls );
-            RtlFreeHeap( GetProcessHeap(), 0, assembly->manifest.info );
-            RtlFreeHeap( GetProcessHeap(), 0, assembly->directory );
-            free_entity_array( &assembly->entities );
-            free_assembly_identity(&assembly->id);
-        }
+        for (i = 0; i < actctx->num_assemblies; i++) free_assembly( &actctx->assemblies[i] );
         RtlFreeHeap( GetProcessHeap(), 0, actctx->config.info );
         RtlFreeHeap( GetProcessHeap(), 0, actctx->appdir.info );
         RtlFreeHeap( GetProcessHeap(), 0, actctx->assemblies );
@@ -1088,6 +1318,13 @@ static void actctx_release( ACTIVATION_CONTEXT *actctx )
         RtlFreeHeap( GetProcessHeap(), 0, actctx->ifaceps_section );
         RtlFreeHeap( GetProcessHeap(), 0, actctx->clrsurrogate_section );
         RtlFreeHeap( GetProcessHeap(), 0, actctx->progid_section );
+        RtlFreeHeap( GetProcessHeap(), 0, actctx->dllredirect_hash );
+        RtlFreeHeap( GetProcessHeap(), 0, actctx->wndclass_hash );
+        RtlFreeHeap( GetProcessHeap(), 0, actctx->tlib_hash );
+        RtlFreeHeap( GetProcessHeap(), 0, actctx->comserver_hash );
+        RtlFreeHeap( GetProcessHeap(), 0, actctx->ifaceps_hash );
+        RtlFreeHeap( GetProcessHeap(), 0, actctx->clrsurrogate_hash );
+        RtlFreeHeap( GetProcessHeap(), 0, actctx->progid_hash );
         actctx->magic = 0;
         RtlFreeHeap( GetProcessHeap(), 0, actctx );
     }
@@ -2054,6 +2291,9 @@ static BOOL parse_dependent_assembly_elem(xmlbuf_t* xmlbuf, struct actctx_loader
     TRACE( "adding name=%s version=%s arch=%s\n",
            debugstr_w(ai.name), debugstr_version(&ai.version), debugstr_w(ai.arch) );
 
+    /* remember it in the cache entry, the parser won't run again for that file */
+    if (acl->cache_entry && !add_cached_dependency(acl->cache_entry, &ai)) return FALSE;
+
     /* store the newly found identity for later loading */
     if (!add_dependent_assembly_id(acl, &ai)) return FALSE;
 
@@ -2208,6 +2448,35 @@ static BOOL parse_file_elem(xmlbuf_t* xmlbuf, struct assembly* assembly, struct
     return ret;
 }
 
+static BOOL check_assembly_version(const struct assembly *assembly,
+                                   const struct assembly_identity *expected_ai)
+{
+    if (!expected_ai) return TRUE;
+
+    /* FIXME: more tests */
+    if (assembly->type == ASSEMBLY_MANIFEST &&
+        memcmp(&assembly->id.version, &expected_ai->version, sizeof(assembly->id.version)))
+    {
+        FIXME("wrong version for assembly manifest: %u.%u.%u.%u / %u.%u.%u.%u\n",
+              expected_ai->version.major, expected_ai->version.minor,
+              expected_ai->version.build, expected_ai->version.revision,
+              assembly->id.version.major, assembly->id.version.minor,
+              assembly->id.version.build, assembly->id.version.revision);
+        return FALSE;
+    }
+    else if (assembly->type == ASSEMBLY_SHARED_MANIFEST &&
+             (assembly->id.version.major != expected_ai->version.major ||
+              assembly->id.version.minor != expected_ai->version.minor ||
+              assembly->id.version.build < expected_ai->version.build ||
+              (assembly->id.version.build == expected_ai->version.build &&
+               assembly->id.version.revision < expected_ai->version.revision)))
+    {
+        FIXME("wrong version for shared assembly manifest\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
 static BOOL parse_assembly_elem(xmlbuf_t* xmlbuf, struct actctx_loader* acl,
                                 struct assembly* assembly,
                                 struct assembly_identity* expected_ai)
@@ -2299,31 +2568,7 @@ static BOOL parse_assembly_elem(xmlbuf_t* xmlbuf, struct actctx_loader* acl,
         else if (xml_elem_cmp(&elem, assemblyIdentityW, asmv1W))
         {
             if (!parse_assembly_identity_elem(xmlbuf, acl->actctx, &assembly->id)) return FALSE;
-
-            if (expected_ai)
-            {
-                /* FIXME: more tests */
-                if (assembly->type == ASSEMBLY_MANIFEST &&
-                    memcmp(&assembly->id.version, &expected_ai->version, sizeof(assembly->id.version)))
-                {
-                    FIXME("wrong version for assembly manifest: %u.%u.%u.%u / %u.%u.%u.%u\n",
-                          expected_ai->version.major, expected_ai->version.minor,
-                          expected_ai->version.build, expected_ai->version.revision,
-                          assembly->id.version.major, assembly->id.version.minor,
-                          assembly->id.version.build, assembly->id.version.revision);
-                    ret = FALSE;
-                }
-                else if (assembly->type == ASSEMBLY_SHARED_MANIFEST &&
-                         (assembly->id.version.major != expected_ai->version.major ||
-                          assembly->id.version.minor != expected_ai->version.minor ||
-                          assembly->id.version.build < expected_ai->version.build ||
-                          (assembly->id.version.build == expected_ai->version.build &&
-                           assembly->id.version.revision < expected_ai->version.revision)))
-                {
-                    FIXME("wrong version for shared assembly manifest\n");
-                    ret = FALSE;
-                }
-            }
+            ret = check_assembly_version(assembly, expected_ai);
         }
         else
         {
@@ -2438,6 +2683,133 @@ static NTSTATUS parse_manifest( struct actctx_loader* acl, struct assembly_ident
     return status;
 }
 
+static BOOL get_manifest_cache_key( HANDLE file, ULONG_PTR resid, ULONG lang, BOOL shared,
+                                    struct manifest_cache_key *key )
+{
+    FILE_NETWORK_OPEN_INFORMATION info;
+    FILE_INTERNAL_INFORMATION internal;
+    IO_STATUS_BLOCK io;
+
+    if (NtQueryInformationFile( file, &io, &info, sizeof(info), FileNetworkOpenInformation ) ||
+        NtQueryInformationFile( file, &io, &internal, sizeof(internal), FileInternalInformation ))
+        return FALSE;
+
+    memset( key, 0, sizeof(*key) );
+    key->index       = internal.IndexNumber;
+    key->change_time = info.ChangeTime;
+    key->write_time  = info.LastWriteTime;
+    key->size        = info.EndOfFile;
+    key->resid       = resid;
+    key->lang        = lang;
+    key->shared      = shared;
+    return TRUE;
+}
+
+/* add an assembly from the manifest cache to the context, returns FALSE if not cached */
+static BOOL load_cached_manifest( struct actctx_loader* acl, struct assembly_identity* ai,
+                                  LPCWSTR filename, LPCWSTR directory,
+                                  const struct manifest_cache_key *key, NTSTATUS *status )
+{
+    struct manifest_cache_entry *cache;
+    struct assembly *assembly;
+    unsigned int i;
+
+    RtlEnterCriticalSection( &manifest_cache_section );
+
+    LIST_FOR_EACH_ENTRY( cache, &manifest_cache, struct manifest_cache_entry, entry )
+    {
+        if (!memcmp( &cache->key, key, sizeof(*key) )) goto found;
+    }
+    RtlLeaveCriticalSection( &manifest_cache_section );
+    return FALSE;
+
+found:
+    TRACE( "using cached manifest for %s\n", debugstr_w(filename) );
+
+    /* move it to the front of the list */
+    list_remove( &cache->entry );
+    list_add_head( &manifest_cache, &cache->entry );
+
+    *status = STATUS_SXS_CANT_GEN_ACTCTX;
+    if (!(assembly = add_assembly( acl->actctx, cache->assembly.type ))) goto done;
+
+    *status = STATUS_NO_MEMORY;
+    if (directory && !(assembly->directory = strdupW( directory ))) goto done;
+    if (filename) assembly->manifest.info = strdupW( filename + 4 /* skip \??\ prefix */ );
+    assembly->manifest.type = assembly->manifest.info ? ACTIVATION_CONTEXT_PATH_TYPE_WIN32_FILE
+                                                      : ACTIVATION_CONTEXT_PATH_TYPE_NONE;
+    if (!copy_assembly( assembly, &cache->assembly )) goto done;
+
+    *status = STATUS_SXS_CANT_GEN_ACTCTX;
+    if (!check_assembly_version( assembly, ai )) goto done;
+
+    for (i = 0; i < cache->num_dependencies; i++)
+    {
+        struct assembly_identity dep;
+        unsigned int count = acl->num_dependencies;
+
+        if (!copy_assembly_identity( &dep, &cache->dependencies[i] ) || !add_dependent_assembly_id( acl, &dep ))
+        {
+            free_assembly_identity( &dep );
+            goto done;
+        }
+        if (acl->num_dependencies == count) free_assembly_identity( &dep );
+    }
+    acl->actctx->sections |= cache->sections;
+    *status = STATUS_SUCCESS;
+
+done:
+    RtlLeaveCriticalSection( &manifest_cache_section );
+    return TRUE;
+}
+
+/* start recording the results of the next manifest parse */
+static void start_manifest_cache( struct actctx_loader* acl )
+{
+    if (!(acl->cache_entry = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*acl->cache_entry) )))
+        return;
+
+    /* only collect the sections needed by this manifest */
+    acl->cache_entry->sections = acl->actctx->sections;
+    acl->actctx->sections = 0;
+}
+
+/* store the assembly that was just parsed in the manifest cache */
+static void end_manifest_cache( struct actctx_loader* acl, const struct manifest_cache_key *key, NTSTATUS status )
+{
+    struct manifest_cache_entry *cache = acl->cache_entry, *old;
+    DWORD sections;
+
+    if (!cache) return;
+    acl->cache_entry = NULL;
+
+    sections = acl->actctx->sections;
+    acl->actctx->sections |= cache->sections;
+    cache->sections = sections;
+
+    if (status != STATUS_SUCCESS ||
+        !copy_assembly( &cache->assembly, &acl->actctx->assemblies[acl->actctx->num_assemblies - 1] ))
+    {
+        free_manifest_cache_entry( cache );
+        return;
+    }
+    cache->assembly.type = acl->actctx->assemblies[acl->actctx->num_assemblies - 1].type;
+    cache->key = *key;
+
+    RtlEnterCriticalSection( &manifest_cache_section );
+    list_add_head( &manifest_cache, &cache->entry );
+    if (++manifest_cache_count > MANIFEST_CACHE_SIZE)
+    {
+        old = LIST_ENTRY( list_tail( &manifest_cache ), struct manifest_cache_entry, entry );
+        list_remove( &old->entry );
+        manifest_cache_count--;
+    }
+    else old = NULL;
+    RtlLeaveCriticalSection( &manifest_cache_section );
+
+    if (old) free_manifest_cache_entry( old );
+}
+
 static NTSTATUS open_nt_file( HANDLE *handle, UNICODE_STRING *name )
 {
     OBJECT_ATTRIBUTES attr;
@@ -2542,9 +2914,16 @@ static NTSTATUS get_manifest_in_pe_file( struct actctx_loader* acl, struct assem
     NTSTATUS            status;
     SIZE_T              count;
     void               *base;
+    struct manifest_cache_key key;
+    BOOL                cached;
 
     TRACE( "looking for res %s in %s\n", debugstr_w(resname), debugstr_w(filename) );
 
+    /* only integer resource ids are cached */
+    cached = resname && !((ULONG_PTR)resname >> 16) &&
+             get_manifest_cache_key( file, (ULONG_PTR)resname, lang, shared, &key );
+    if (cached && load_cached_manifest( acl, ai, filename, directory, &key, &status )) return status;
+
     attr.Length                   = sizeof(attr);
     attr.RootDirectory            = 0;
     attr.ObjectName               = NULL;
@@ -2568,7 +2947,9 @@ static NTSTATUS get_manifest_in_pe_file( struct actctx_loader* acl, struct assem
     if (RtlImageNtHeader(base)) /* we got a PE file */
     {
         HANDLE module = (HMODULE)((ULONG_PTR)base | 1);  /* make it a LOAD_LIBRARY_AS_DATAFILE handle */
+        if (cached) start_manifest_cache( acl );
         status = get_manifest_in_module( acl, ai, filename, directory, shared, module, resname, lang );
+        if (cached) end_manifest_cache( acl, &key, status );
     }
     else status = STATUS_INVALID_IMAGE_FORMAT;
 
@@ -2588,9 +2969,14 @@ static NTSTATUS get_manifest_in_manifest_file( struct actctx_loader* acl, struct
     NTSTATUS            status;
     SIZE_T              count;
     void               *base;
+    struct manifest_cache_key key;
+    BOOL                cached;
 
     TRACE( "loading manifest file %s\n", debugstr_w(filename) );
 
+    cached = get_manifest_cache_key( file, 0, 0, shared, &key );
+    if (cached && load_cached_manifest( acl, ai, filename, directory, &key, &status )) return status;
+
     attr.Length                   = sizeof(attr);
     attr.RootDirectory            = 0;
     attr.ObjectName               = NULL;
@@ -2613,7 +2999,11 @@ static NTSTATUS get_manifest_in_manifest_file( struct actctx_loader* acl, struct
 
     status = NtQueryInformationFile( file, &io, &info, sizeof(info), FileEndOfFileInformation );
     if (status == STATUS_SUCCESS)
+    {
+        if (cached) start_manifest_cache( acl );
         status = parse_manifest(acl, ai, filename, directory, shared, base, info.EndOfFile.QuadPart);
+        if (cached) end_manifest_cache( acl, &key, status );
+    }
 
     NtUnmapViewOfSection( GetCurrentProcess(), base );
     return status;
@@ -3058,14 +3448,94 @@ static NTSTATUS build_dllredirect_section(ACTIVATION_CONTEXT* actctx, struct str
     return STATUS_SUCCESS;
 }
 
-static struct string_index *find_string_index(const struct strsection_header *section, const UNICODE_STRING *name)
+static struct section_hash *create_section_hash(ULONG count)
 {
+    struct section_hash *hash;
+    ULONG size = 8;
+
+    while (size < count * 2) size *= 2;
+    hash = RtlAllocateHeap(GetProcessHeap(), HEAP_ZERO_MEMORY, FIELD_OFFSET(struct section_hash, slots[size]));
+    if (hash) hash->mask = size - 1;
+    return hash;
+}
+
+static void add_section_hash(struct section_hash *hash, ULONG key, ULONG index)
+{
+    ULONG i = key & hash->mask;
+
+    while (hash->slots[i]) i = (i + 1) & hash->mask;
+    hash->slots[i] = index + 1;
+}
+
+static inline ULONG hash_guid(const GUID *guid)
+{
+    const ULONG *ptr = (const ULONG *)guid;
+    return ptr[0] ^ ptr[1] ^ ptr[2] ^ ptr[3];
+}
+
+/* the hash tables are built on first lookup, like the sections themselves */
+static const struct section_hash *get_string_section_hash(const struct strsection_header *section,
+                                                          struct section_hash **ptr)
+{
+    const struct string_index *index;
+    struct section_hash *hash;
+    ULONG i;
+
+    if (*ptr) return *ptr;
+    if (!(hash = create_section_hash(section->count))) return NULL;
+
+    index = (const struct string_index*)((const BYTE*)section + section->index_offset);
+    for (i = 0; i < section->count; i++) add_section_hash(hash, index[i].hash, i);
+
+    if (interlocked_cmpxchg_ptr((void**)ptr, hash, NULL))
+        RtlFreeHeap(GetProcessHeap(), 0, hash);
+    return *ptr;
+}
+
+static const struct section_hash *get_guid_section_hash(const struct guidsection_header *section,
+                                                        struct section_hash **ptr)
+{
+    const struct guid_index *index;
+    struct section_hash *hash;
+    ULONG i;
+
+    if (*ptr) return *ptr;
+    if (!(hash = create_section_hash(section->count))) return NULL;
+
+    index = (const struct guid_index*)((const BYTE*)section + section->index_offset);
+    for (i = 0; i < section->count; i++) add_section_hash(hash, hash_guid(&index[i].guid), i);
+
+    if (interlocked_cmpxchg_ptr((void**)ptr, hash, NULL))
+        RtlFreeHeap(GetProcessHeap(), 0, hash);
+    return *ptr;
+}
+
+static struct string_index *find_string_index(const struct strsection_header *section,
+                                              struct section_hash **hash_table, const UNICODE_STRING *name)
+{
+    const struct section_hash *table;
     struct string_index *iter, *index = NULL;
     ULONG hash = 0, i;
 
     RtlHashUnicodeString(name, TRUE, HASH_STRING_ALGORITHM_X65599, &hash);
     iter = (struct string_index*)((BYTE*)section + section->index_offset);
 
+    if ((table = get_string_section_hash(section, hash_table)))
+    {
+        for (i = hash & table->mask; table->slots[i]; i = (i + 1) & table->mask)
+        {
+            const WCHAR *nameW;
+
+            index = &iter[table->slots[i] - 1];
+            if (index->hash != hash) continue;
+
+            nameW = (WCHAR*)((BYTE*)section + index->name_offset);
+            if (!strcmpiW(nameW, name->Buffer)) return index;
+            WARN("hash collision 0x%08x, %s, %s\n", hash, debugstr_us(name), debugstr_w(nameW));
+        }
+        return NULL;
+    }
+
     for (i = 0; i < section->count; i++)
     {
         if (iter->hash == hash)
@@ -3086,13 +3556,25 @@ static struct string_index *find_string_index(const struct strsection_header *se
     return index;
 }
 
-static struct guid_index *find_guid_index(const struct guidsection_header *section, const GUID *guid)
+static struct guid_index *find_guid_index(const struct guidsection_header *section,
+                                          struct section_hash **hash_table, const GUID *guid)
 {
+    const struct section_hash *table;
     struct guid_index *iter, *index = NULL;
     ULONG i;
 
     iter = (struct guid_index*)((BYTE*)section + section->index_offset);
 
+    if ((table = get_guid_section_hash(section, hash_table)))
+    {
+        for (i = hash_guid(guid) & table->mask; table->slots[i]; i = (i + 1) & table->mask)
+        {
+            index = &iter[table->slots[i] - 1];
+            if (!memcmp(guid, &index->guid, sizeof(*guid))) return index;
+        }
+        return NULL;
+    }
+
     for (i = 0; i < section->count; i++)
     {
         if (!memcmp(guid, &iter->guid, sizeof(*guid)))
@@ -3130,7 +3612,7 @@ static NTSTATUS find_dll_redirection(ACTIVATION_CONTEXT* actctx, const UNICODE_S
             RtlFreeHeap(GetProcessHeap(), 0, section);
     }
 
-    index = find_string_index(actctx->dllredirect_section, name);
+    index = find_string_index(actctx->dllredirect_section, &actctx->dllredirect_hash, name);
     if (!index) return STATUS_SXS_KEY_NOT_FOUND;
 
     if (data)
@@ -3153,11 +3635,6 @@ static NTSTATUS find_dll_redirection(ACTIVATION_CONTEXT* actctx, const UNICODE_S
     return STATUS_SUCCESS;
 }
 
-static inline struct string_index *get_wndclass_first_index(ACTIVATION_CONTEXT *actctx)
-{
-    return (struct string_index*)((BYTE*)actctx->wndclass_section + actctx->wndclass_section->index_offset);
-}
-
 static inline struct wndclass_redirect_data *get_wndclass_data(ACTIVATION_CONTEXT *ctxt, struct string_index *index)
 {
     return (struct wndclass_redirect_data*)((BYTE*)ctxt->wndclass_section + index->data_offset);
@@ -3304,10 +3781,8 @@ static NTSTATUS build_wndclass_section(ACTIVATION_CONTEXT* actctx, struct strsec
 static NTSTATUS find_window_class(ACTIVATION_CONTEXT* actctx, const UNICODE_STRING *name,
                                   PACTCTX_SECTION_KEYED_DATA data)
 {
-    struct string_index *iter, *index = NULL;
+    struct string_index *index;
     struct wndclass_redirect_data *class;
-    ULONG hash;
-    int i;
 
     if (!(actctx->sections & WINDOWCLASS_SECTION)) return STATUS_SXS_KEY_NOT_FOUND;
 
@@ -3322,27 +3797,7 @@ static NTSTATUS find_window_class(ACTIVATION_CONTEXT* actctx, const UNICODE_STRI
             RtlFreeHeap(GetProcessHeap(), 0, section);
     }
 
-    hash = 0;
-    RtlHashUnicodeString(name, TRUE, HASH_STRING_ALGORITHM_X65599, &hash);
-    iter = get_wndclass_first_index(actctx);
-
-    for (i = 0; i < actctx->wndclass_section->count; i++)
-    {
-        if (iter->hash == hash)
-        {
-            const WCHAR *nameW = (WCHAR*)((BYTE*)actctx->wndclass_section + iter->name_offset);
-
-            if (!strcmpiW(nameW, name->Buffer))
-            {
-                index = iter;
-                break;
-            }
-            else
-                WARN("hash collision 0x%08x, %s, %s\n", hash, debugstr_us(name), debugstr_w(nameW));
-        }
-        iter++;
-    }
-
+    index = find_string_index(actctx->wndclass_section, &actctx->wndclass_hash, name);
     if (!index) return STATUS_SXS_KEY_NOT_FOUND;
 
     if (data)
@@ -3513,7 +3968,7 @@ static NTSTATUS find_tlib_redirection(ACTIVATION_CONTEXT* actctx, const GUID *gu
             RtlFreeHeap(GetProcessHeap(), 0, section);
     }
 
-    index = find_guid_index(actctx->tlib_section, guid);
+    index = find_guid_index(actctx->tlib_section, &actctx->tlib_hash, guid);
     if (!index) return STATUS_SXS_KEY_NOT_FOUND;
 
     tlib = get_tlib_data(actctx, index);
@@ -3848,7 +4303,7 @@ static NTSTATUS find_comserver_redirection(ACTIVATION_CONTEXT* actctx, const GUI
             RtlFreeHeap(GetProcessHeap(), 0, section);
     }
 
-    index = find_guid_index(actctx->comserver_section, guid);
+    index = find_guid_index(actctx->comserver_section, &actctx->comserver_hash, guid);
     if (!index) return STATUS_SXS_KEY_NOT_FOUND;
 
     comclass = get_comclass_data(actctx, index);
@@ -4038,7 +4493,7 @@ static NTSTATUS find_cominterface_redirection(ACTIVATION_CONTEXT* actctx, const
             RtlFreeHeap(GetProcessHeap(), 0, section);
     }
 
-    index = find_guid_index(actctx->ifaceps_section, guid);
+    index = find_guid_index(actctx->ifaceps_section, &actctx->ifaceps_hash, guid);
     if (!index) return STATUS_SXS_KEY_NOT_FOUND;
 
     iface = get_ifaceps_data(actctx, index);
@@ -4186,7 +4641,7 @@ static NTSTATUS find_clr_surrogate(ACTIVATION_CONTEXT* actctx, const GUID *guid,
             RtlFreeHeap(GetProcessHeap(), 0, section);
     }
 
-    index = find_guid_index(actctx->clrsurrogate_section, guid);
+    index = find_guid_index(actctx->clrsurrogate_section, &actctx->clrsurrogate_hash, guid);
     if (!index) return STATUS_SXS_KEY_NOT_FOUND;
 
     surrogate = get_surrogate_data(actctx, index);
@@ -4297,7 +4752,7 @@ static void add_progid_record(ACTIVATION_CONTEXT* actctx, struct strsection_head
             RtlInitUnicodeString(&str, entity->u.comclass.clsid);
             RtlGUIDFromString(&str, &clsid);
 
-            guid_index = find_guid_index(actctx->comserver_section, &clsid);
+            guid_index = find_guid_index(actctx->comserver_section, &actctx->comserver_hash, &clsid);
             comclass = get_comclass_data(actctx, guid_index);
 
             if (entity->u.comclass.progid)
@@ -4400,7 +4855,7 @@ static NTSTATUS find_progid_redirection(ACTIVATION_CONTEXT* actctx, const UNICOD
             RtlFreeHeap(GetProcessHeap(), 0, section);
     }
 
-    index = find_string_index(actctx->progid_section, name);
+    index = find_string_index(actctx->progid_section, &actctx->progid_hash, name);
     if (!index) return STATUS_SXS_KEY_NOT_FOUND;
 
     if (data)
@@ -4604,6 +5059,7 @@ NTSTATUS WINAPI RtlCreateActivationContext( HANDLE *handle, const void *ptr )
     acl.dependencies = NULL;
     acl.num_dependencies = 0;
     acl.allocated_dependencies = 0;
+    acl.cache_entry = NULL;
 
     if (pActCtx->dwFlags & ACTCTX_FLAG_LANGID_VALID) lang = pActCtx->wLangId;
     if (pActCtx->dwFlags & ACTCTX_FLAG_ASSEMBLY_DIRECTORY_VALID) directory = pActCtx->lpAssemblyDirectory;
@@ -39,6 +39,14 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 WINE_DECLARE_DEBUG_CHANNEL(relay);
+WINE_DECLARE_DEBUG_CHANNEL(lockstat);
+
+/* limits for sections created with RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN,
+ * whose current spin count is kept in the low bits of SpinCount */
+#define DYNAMIC_SPIN_MASK     0x00ffffff
+#define DYNAMIC_SPIN_MIN      32
+#define DYNAMIC_SPIN_MAX      4000
+#define DYNAMIC_SPIN_DEFAULT  2000
 
 static inline LONG interlocked_inc( PLONG dest )
 {
@@ -52,7 +60,7 @@ static inline LONG interlocked_dec( PLONG dest )
 
 static inline void small_pause(void)
 {
-#ifdef __i386__
+#if defined(__i386__) || defined(__x86_64__)
     __asm__ __volatile__( "rep;nop" : : : "memory" );
 #else
     __asm__ __volatile__( "" : : : "memory" );
@@ -240,6 +248,134 @@ static inline NTSTATUS wait_semaphore( RTL_CRITICAL_SECTION *crit, int timeout )
     return ret;
 }
 
+/***********************************************************************
+ *           Contention statistics
+ *
+ * With +lockstat, the wait count, the total and maximum wait time and the
+ * call site of the owner are recorded for every contended critical section.
+ * The statistics are printed every LOCKSTAT_INTERVAL while waits occur, and
+ * on process exit. Entries are never removed, so a deleted section whose
+ * memory is reused for another one shares its entry.
+ */
+
+#define LOCKSTAT_SIZE      1024
+#define LOCKSTAT_INTERVAL  ((ULONGLONG)10 * 10000000)  /* 10 seconds */
+
+struct lockstat_entry
+{
+    RTL_CRITICAL_SECTION *crit;
+    const char           *name;
+    void                 *owner;         /* caller which last entered the section */
+    void                 *blocker;       /* owner seen by the last waiter */
+    LONG                  waits;
+    ULONGLONG             wait_time;     /* in 100ns units */
+    ULONGLONG             max_wait_time;
+};
+
+static struct lockstat_entry lockstat[LOCKSTAT_SIZE];
+static ULONGLONG lockstat_last_dump;
+static LONG lockstat_dumping;
+
+static inline ULONGLONG lockstat_time(void)
+{
+    LARGE_INTEGER now;
+    NtQueryPerformanceCounter( &now, NULL );
+    return now.QuadPart;
+}
+
+static struct lockstat_entry *get_lockstat_entry( RTL_CRITICAL_SECTION *crit, BOOL create )
+{
+    unsigned int i, hash = ((ULONG_PTR)crit >> 3) % LOCKSTAT_SIZE;
+
+    for (i = 0; i < LOCKSTAT_SIZE; i++)
+    {
+        struct lockstat_entry *entry = &lockstat[(hash + i) % LOCKSTAT_SIZE];
+        RTL_CRITICAL_SECTION *cur = entry->crit;
+
+        if (cur == crit) return entry;
+        if (cur) continue;
+        if (!create) return NULL;
+        cur = interlocked_cmpxchg_ptr( (void **)&entry->crit, crit, NULL );
+        if (!cur || cur == crit) return entry;
+    }
+    return NULL;
+}
+
+static void lockstat_dump(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < LOCKSTAT_SIZE; i++)
+    {
+        struct lockstat_entry *entry = &lockstat[i];
+
+        if (!entry->crit || !entry->waits) continue;
+        TRACE_(lockstat)( "section %p %s: %u waits, total %s us, max %s us, last blocked by %p\n",
+                          entry->crit, debugstr_a(entry->name ? entry->name : "?"), entry->waits,
+                          wine_dbgstr_longlong( entry->wait_time / 10 ),
+                          wine_dbgstr_longlong( entry->max_wait_time / 10 ), entry->blocker );
+    }
+}
+
+static void lockstat_record_wait( RTL_CRITICAL_SECTION *crit, void *blocker, ULONGLONG start )
+{
+    struct lockstat_entry *entry;
+    ULONGLONG now = lockstat_time(), wait_time = now - start;
+
+    if (!(entry = get_lockstat_entry( crit, TRUE ))) return;
+
+    /* updated without locking, so the times may be slightly off under heavy contention */
+    if (crit->DebugInfo) entry->name = (const char *)crit->DebugInfo->Spare[0];
+    entry->blocker = blocker;
+    interlocked_inc( &entry->waits );
+    entry->wait_time += wait_time;
+    if (wait_time > entry->max_wait_time) entry->max_wait_time = wait_time;
+
+    if (now - lockstat_last_dump >= LOCKSTAT_INTERVAL &&
+        !interlocked_cmpxchg( &lockstat_dumping, 1, 0 ))
+    {
+        if (now - lockstat_last_dump >= LOCKSTAT_INTERVAL)
+        {
+            lockstat_last_dump = now;
+            lockstat_dump();
+        }
+        lockstat_dumping = 0;
+    }
+}
+
+static inline void lockstat_record_owner( RTL_CRITICAL_SECTION *crit, void *caller )
+{
+    struct lockstat_entry *entry;
+
+    /* only sections which have been contended before are tracked */
+    if ((entry = get_lockstat_entry( crit, FALSE ))) entry->owner = caller;
+}
+
+/***********************************************************************
+ *           critsect_dump_lockstat
+ *
+ * Prints the contention statistics gathered with +lockstat.
+ */
+void critsect_dump_lockstat(void)
+{
+    if (TRACE_ON(lockstat)) lockstat_dump();
+}
+
+/***********************************************************************
+ *           update_dynamic_spin
+ *
+ * Moves the spin count of a section with a dynamic spin count a quarter
+ * of the way towards the target.
+ */
+static inline void update_dynamic_spin( RTL_CRITICAL_SECTION *crit, ULONG spin, ULONG target )
+{
+    LONG count = spin + ((LONG)target - (LONG)spin) / 4;
+
+    if (count < DYNAMIC_SPIN_MIN) count = DYNAMIC_SPIN_MIN;
+    if (count > DYNAMIC_SPIN_MAX) count = DYNAMIC_SPIN_MAX;
+    crit->SpinCount = RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN | count;
+}
+
 /***********************************************************************
  *           RtlInitializeCriticalSection   (NTDLL.@)
  *
@@ -311,7 +447,7 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionAndSpinCount( RTL_CRITICAL_SECTION *
  */
 NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULONG spincount, ULONG flags )
 {
-    if (flags & (RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN|RTL_CRITICAL_SECTION_FLAG_STATIC_INIT))
+    if (flags & RTL_CRITICAL_SECTION_FLAG_STATIC_INIT)
         FIXME("(%p,%u,0x%08x) semi-stub\n", crit, spincount, flags);
 
     /* FIXME: if RTL_CRITICAL_SECTION_FLAG_STATIC_INIT is given, we should use
@@ -341,6 +477,12 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULON
     crit->OwningThread   = 0;
     crit->LockSemaphore  = 0;
     if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) spincount = 0;
+    else if (flags & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN)
+    {
+        /* the spin count adapts to the hold times observed in RtlEnterCriticalSection */
+        if (!spincount) spincount = DYNAMIC_SPIN_DEFAULT;
+        spincount = RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN | min( spincount, DYNAMIC_SPIN_MAX );
+    }
     crit->SpinCount = spincount & ~0x80000000;
     return STATUS_SUCCESS;
 }
@@ -370,6 +512,12 @@ ULONG WINAPI RtlSetCriticalSectionSpinCount( RTL_CRITICAL_SECTION *crit, ULONG s
 {
     ULONG oldspincount = crit->SpinCount;
     if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) spincount = 0;
+    else if (oldspincount & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN)
+    {
+        /* the new count is only used as a starting point */
+        oldspincount &= DYNAMIC_SPIN_MASK;
+        if (spincount) spincount = RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN | min( spincount, DYNAMIC_SPIN_MAX );
+    }
     crit->SpinCount = spincount;
     return oldspincount;
 }
@@ -436,6 +584,16 @@ NTSTATUS WINAPI RtlDeleteCriticalSection( RTL_CRITICAL_SECTION *crit )
 NTSTATUS WINAPI RtlpWaitForCriticalSection( RTL_CRITICAL_SECTION *crit )
 {
     LONGLONG timeout = NtCurrentTeb()->Peb->CriticalSectionTimeout.QuadPart / -10000000;
+    ULONGLONG start = 0;
+    void *blocker = NULL;
+
+    if (TRACE_ON(lockstat))
+    {
+        struct lockstat_entry *entry = get_lockstat_entry( crit, FALSE );
+        if (entry) blocker = entry->owner;
+        start = lockstat_time();
+    }
+
     for (;;)
     {
         EXCEPTION_RECORD rec;
@@ -477,6 +635,7 @@ NTSTATUS WINAPI RtlpWaitForCriticalSection( RTL_CRITICAL_SECTION *crit )
         RtlRaiseException( &rec );
     }
     if (crit->DebugInfo) crit->DebugInfo->ContentionCount++;
+    if (start) lockstat_record_wait( crit, blocker, start );
     return STATUS_SUCCESS;
 }
 
@@ -538,20 +697,35 @@ NTSTATUS WINAPI RtlpUnWaitCriticalSection( RTL_CRITICAL_SECTION *crit )
  */
 NTSTATUS WINAPI RtlEnterCriticalSection( RTL_CRITICAL_SECTION *crit )
 {
-    if (crit->SpinCount)
+    ULONG_PTR spin = crit->SpinCount;
+
+    if (spin)
     {
+        BOOL dynamic = (spin & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN) != 0;
         ULONG count;
 
-        if (RtlTryEnterCriticalSection( crit )) return STATUS_SUCCESS;
-        for (count = crit->SpinCount; count > 0; count--)
+        if (RtlTryEnterCriticalSection( crit ))
+        {
+            if (TRACE_ON(lockstat)) lockstat_record_owner( crit, __builtin_return_address(0) );
+            return STATUS_SUCCESS;
+        }
+        if (dynamic) spin &= DYNAMIC_SPIN_MASK;
+        for (count = spin; count > 0; count--)
         {
             if (crit->LockCount > 0) break;  /* more than one waiter, don't bother spinning */
             if (crit->LockCount == -1)       /* try again */
             {
-                if (interlocked_cmpxchg( &crit->LockCount, 0, -1 ) == -1) goto done;
+                if (interlocked_cmpxchg( &crit->LockCount, 0, -1 ) == -1)
+                {
+                    /* spin about twice as long as the section was held this time */
+                    if (dynamic) update_dynamic_spin( crit, spin, 2 * (spin - count) );
+                    goto done;
+                }
             }
             small_pause();
         }
+        /* the section is held for longer than we spin, reduce the spin count */
+        if (dynamic && !count) update_dynamic_spin( crit, spin, DYNAMIC_SPIN_MIN );
     }
 
     if (interlocked_inc( &crit->LockCount ))
@@ -568,6 +742,7 @@ NTSTATUS WINAPI RtlEnterCriticalSection( RTL_CRITICAL_SECTION *crit )
 done:
     crit->OwningThread   = ULongToHandle(GetCurrentThreadId());
     crit->RecursionCount = 1;
+    if (TRACE_ON(lockstat)) lockstat_record_owner( crit, __builtin_return_address(0) );
     return STATUS_SUCCESS;
 }
 
@@ -597,6 +772,7 @@ BOOL WINAPI RtlTryEnterCriticalSection( RTL_CRITICAL_SECTION *crit )
     {
         crit->OwningThread   = ULongToHandle(GetCurrentThreadId());
         crit->RecursionCount = 1;
+        if (TRACE_ON(lockstat)) lockstat_record_owner( crit, __builtin_return_address(0) );
         ret = TRUE;
     }
     else if (crit->OwningThread == ULongToHandle(GetCurrentThreadId()))
@@ -25,9 +25,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #include <ctype.h>
 
 #include "wine/debug.h"
@@ -52,6 +56,340 @@ static inline struct debug_info *get_info(void)
     return ntdll_get_thread_data()->debug_info;
 }
 
+/* Binary trace rings, enabled with WINEDEBUGRING=<file prefix>
+ *
+ * Instead of being formatted, debug messages are stored with their raw
+ * arguments in a per-thread ring mapped from <prefix>.<unix pid>.<n>. Format,
+ * function and channel strings are stored by address, and their contents
+ * are written once to <prefix>.<unix pid>.str. tools/decode-trace turns
+ * the files back into a text log.
+ *
+ * The ring file starts with a struct trace_ring header block, followed by
+ * TRACE_BLOCK_COUNT blocks that each start with their sequence number and
+ * contain trace_record entries, ended by a record of size 0 or by the end
+ * of the block.
+ *
+ * Strings that don't fit in the table of known strings are stored in the
+ * record itself, in front of the arguments, instead of in the strings file.
+ * Errors and fixmes are printed to stderr as well. */
+
+#define TRACE_BLOCK_SIZE  16384
+#define TRACE_BLOCK_COUNT 64
+#define TRACE_MAX_RECORD  2048   /* records never span blocks */
+#define TRACE_MAX_STRING  512    /* longer string arguments are truncated */
+#define TRACE_CLASS_CONT  0xff   /* continuation of the current line */
+#define TRACE_STRING_PROBES 8
+
+/* flags for the strings stored in the record */
+#define TRACE_INLINE_FORMAT   0x01
+#define TRACE_INLINE_FUNCTION 0x02
+#define TRACE_INLINE_CHANNEL  0x04
+
+struct trace_ring
+{
+    char      magic[8];     /* "WINETRC1" */
+    ULONGLONG pid;
+    ULONGLONG tid;
+    ULONGLONG frequency;    /* frequency of the timestamps */
+    ULONGLONG block_size;
+    ULONGLONG block_count;
+    ULONGLONG seq;          /* sequence number of the current block */
+    ULONGLONG pos;          /* offset of the next record in the current block */
+};
+
+struct trace_record
+{
+    ULONGLONG      time;     /* performance counter */
+    ULONGLONG      format;   /* address of the format string */
+    ULONGLONG      function; /* address of the function name */
+    ULONGLONG      channel;  /* address of the channel name */
+    unsigned short size;     /* size of the record including arguments */
+    unsigned char  cls;      /* debug class, or TRACE_CLASS_CONT */
+    unsigned char  inline_strings; /* TRACE_INLINE_* flags */
+    unsigned char  pad[4];
+    /* followed by the inline strings and the arguments; strings are stored as
+     * their length followed by the characters, numbers as 64-bit values, all
+     * aligned to 8 bytes */
+};
+
+/* entry of the strings file */
+struct trace_string
+{
+    ULONGLONG addr;
+    ULONGLONG len;
+    char      text[1024];
+};
+
+static const char *trace_prefix;
+static int trace_strings_fd = -1;
+static const char *trace_strings[8192];  /* strings already written to the strings file */
+
+/* write the contents of a string to the strings file the first time it is seen;
+ * returns FALSE if the table is full, the string then has to be stored inline */
+static BOOL trace_add_string( const char *str )
+{
+    unsigned int i, hash = ((ULONG_PTR)str >> 2) * 2654435761u;
+    struct trace_string buffer;
+    const char *prev;
+
+    if (!str) return TRUE;
+    for (i = 0; i < TRACE_STRING_PROBES; i++)
+    {
+        const char **entry = &trace_strings[(hash + i) % (sizeof(trace_strings) / sizeof(trace_strings[0]))];
+        if (*entry == str) return TRUE;
+        if (*entry) continue;
+        if (!(prev = interlocked_cmpxchg_ptr( (void **)entry, (void *)str, NULL ))) break;
+        if (prev == str) return TRUE;  /* another thread inserted it first */
+    }
+    if (i == TRACE_STRING_PROBES) return FALSE;
+
+    buffer.addr = (ULONG_PTR)str;
+    buffer.len  = min( strlen( str ), sizeof(buffer.text) );
+    memcpy( buffer.text, str, buffer.len );
+    write( trace_strings_fd, &buffer, FIELD_OFFSET( struct trace_string, text[buffer.len] ));
+    return TRUE;
+}
+
+/* store a string argument, truncating it if needed */
+static char *trace_put_string( char *ptr, char *end, const char *str, int wide )
+{
+    ULONGLONG len = 0, max;
+
+    if (ptr + sizeof(ULONGLONG) > end) return NULL;
+    if (!str)
+    {
+        *(ULONGLONG *)ptr = ~(ULONGLONG)0;
+        return ptr + sizeof(ULONGLONG);
+    }
+    max = min( end - ptr - sizeof(ULONGLONG), TRACE_MAX_STRING );
+    if (wide)
+    {
+        const wchar_t *strW = (const wchar_t *)str;
+        for (len = 0; len < max && strW[len]; len++)
+            ptr[sizeof(ULONGLONG) + len] = strW[len] < 0x80 ? strW[len] : '?';
+    }
+    else
+    {
+        while (len < max && str[len]) len++;
+        memcpy( ptr + sizeof(ULONGLONG), str, len );
+    }
+    *(ULONGLONG *)ptr = len;
+    return ptr + sizeof(ULONGLONG) + ((len + 7) & ~7);
+}
+
+static char *trace_put_number( char *ptr, char *end, ULONGLONG val )
+{
+    if (ptr + sizeof(ULONGLONG) > end) return NULL;
+    *(ULONGLONG *)ptr = val;
+    return ptr + sizeof(ULONGLONG);
+}
+
+/* store the arguments of a printf format; stops at the first one that doesn't fit */
+static char *trace_put_args( char *ptr, char *end, const char *format, va_list args )
+{
+    const char *p = format;
+    ULONGLONG val;
+    double d;
+
+    while (ptr && (p = strchr( p, '%' )))
+    {
+        int longs = 0, shorts = 0;
+
+        if (*++p == '%')
+        {
+            p++;
+            continue;
+        }
+        while (*p && strchr( "-+ #0'", *p )) p++;
+        if (*p == '*')
+        {
+            ptr = trace_put_number( ptr, end, va_arg( args, int ));
+            p++;
+        }
+        else while (isdigit( *p )) p++;
+        if (*p == '.')
+        {
+            if (*++p == '*')
+            {
+                ptr = trace_put_number( ptr, end, va_arg( args, int ));
+                p++;
+            }
+            else while (isdigit( *p )) p++;
+        }
+        for (;; p++)
+        {
+            if (*p == 'h') shorts++;
+            else if (*p == 'l') longs++;
+            else if (*p == 'q' || *p == 'L' || *p == 'j') longs = 2;
+            else if (*p == 'z' || *p == 't') longs = sizeof(size_t) > sizeof(int);
+            else break;
+        }
+        if (!ptr) break;
+
+        switch (*p++)
+        {
+        case 'd':
+        case 'i':
+            if (longs > 1) val = va_arg( args, LONGLONG );
+            else if (longs) val = va_arg( args, long );
+            else val = va_arg( args, int );
+            if (shorts == 1) val = (short)val;
+            else if (shorts > 1) val = (signed char)val;
+            ptr = trace_put_number( ptr, end, val );
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            if (longs > 1) val = va_arg( args, ULONGLONG );
+            else if (longs) val = va_arg( args, unsigned long );
+            else val = va_arg( args, unsigned int );
+            if (shorts == 1) val = (unsigned short)val;
+            else if (shorts > 1) val = (unsigned char)val;
+            ptr = trace_put_number( ptr, end, val );
+            break;
+        case 'c':
+            ptr = trace_put_number( ptr, end, va_arg( args, int ));
+            break;
+        case 'p':
+            ptr = trace_put_number( ptr, end, (ULONG_PTR)va_arg( args, void * ));
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (longs > 1) d = va_arg( args, long double );
+            else d = va_arg( args, double );
+            memcpy( &val, &d, sizeof(val) );
+            ptr = trace_put_number( ptr, end, val );
+            break;
+        case 's':
+            ptr = trace_put_string( ptr, end, va_arg( args, const char * ), longs );
+            break;
+        case 'n':
+            va_arg( args, void * );  /* nothing is printed, so nothing to count */
+            break;
+        default:
+            return ptr;
+        }
+    }
+    return ptr;
+}
+
+/* create the trace ring of the current thread */
+static struct trace_ring *create_trace_ring(void)
+{
+    static LONG ring_count;
+    size_t size = TRACE_BLOCK_SIZE * (TRACE_BLOCK_COUNT + 1);
+    struct trace_ring *ring = MAP_FAILED;
+    char name[MAX_PATH];
+    int fd;
+
+    snprintf( name, sizeof(name), "%s.%d.%d", trace_prefix, (int)getpid(),
+              interlocked_xchg_add( &ring_count, 1 ));
+    if ((fd = open( name, O_RDWR | O_CREAT | O_TRUNC, 0666 )) != -1)
+    {
+        if (!ftruncate( fd, size ))
+            ring = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        close( fd );
+    }
+    if (ring == MAP_FAILED)
+    {
+        fprintf( stderr, "wine: cannot create trace ring %s, falling back to text output\n", name );
+        trace_prefix = NULL;
+        return NULL;
+    }
+    memcpy( ring->magic, "WINETRC1", sizeof(ring->magic) );
+    ring->frequency   = 10000000;
+    ring->block_size  = TRACE_BLOCK_SIZE;
+    ring->block_count = TRACE_BLOCK_COUNT;
+    ring->seq         = 0;
+    ring->pos         = TRACE_BLOCK_SIZE;  /* start a new block on the first record */
+    return ring;
+}
+
+/* store a debug message in the trace ring of the current thread */
+static BOOL trace_message( struct debug_info *info, unsigned char cls, const char *channel,
+                           const char *function, const char *format, va_list args )
+{
+    struct trace_ring *ring = info->trace;
+    struct trace_record *rec;
+    LARGE_INTEGER time;
+    char *block, *ptr, *end, *args_ptr;
+    unsigned char inline_strings = 0;
+
+    if (!ring && !(ring = info->trace = create_trace_ring())) return FALSE;
+
+    if (ring->pos + TRACE_MAX_RECORD > TRACE_BLOCK_SIZE)
+    {
+        ring->seq++;
+        ring->pos = sizeof(ULONGLONG);
+        ring->pid = GetCurrentProcessId();
+        ring->tid = GetCurrentThreadId();
+        *(ULONGLONG *)((char *)ring + TRACE_BLOCK_SIZE * (1 + (ring->seq - 1) % TRACE_BLOCK_COUNT)) = ring->seq;
+    }
+    block = (char *)ring + TRACE_BLOCK_SIZE * (1 + (ring->seq - 1) % TRACE_BLOCK_COUNT);
+    rec = (struct trace_record *)(block + ring->pos);
+
+    ptr = (char *)(rec + 1);
+    end = (char *)rec + TRACE_MAX_RECORD;
+    if (!trace_add_string( format ))
+    {
+        inline_strings |= TRACE_INLINE_FORMAT;
+        ptr = trace_put_string( ptr, end, format, 0 );
+    }
+    if (!trace_add_string( function ))
+    {
+        inline_strings |= TRACE_INLINE_FUNCTION;
+        ptr = trace_put_string( ptr, end, function, 0 );
+    }
+    if (!trace_add_string( channel ))
+    {
+        inline_strings |= TRACE_INLINE_CHANNEL;
+        ptr = trace_put_string( ptr, end, channel, 0 );
+    }
+
+    args_ptr = ptr;
+    if (!format || !(ptr = trace_put_args( args_ptr, end, format, args ))) ptr = args_ptr;
+
+    NtQueryPerformanceCounter( &time, NULL );
+    rec->time     = time.QuadPart;
+    rec->format   = (ULONG_PTR)format;
+    rec->function = (ULONG_PTR)function;
+    rec->channel  = (ULONG_PTR)channel;
+    rec->cls      = cls;
+    rec->inline_strings = inline_strings;
+    rec->size     = ptr - (char *)rec;
+    ring->pos    += rec->size;
+    if (ring->pos + sizeof(*rec) <= TRACE_BLOCK_SIZE)
+        ((struct trace_record *)(block + ring->pos))->size = 0;
+    return TRUE;
+}
+
+/***********************************************************************
+ *		debug_exit_thread
+ *
+ * Release the debug data of the current thread. A thread terminated from a
+ * signal handler may be inside a heap call, so its relay stack is leaked.
+ */
+void debug_exit_thread( BOOL terminated )
+{
+    struct debug_info *info = get_info();
+
+    if (!terminated)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, info->relay_stack );
+        info->relay_stack = NULL;
+    }
+    if (!info->trace) return;
+    munmap( info->trace, TRACE_BLOCK_SIZE * (TRACE_BLOCK_COUNT + 1) );
+    info->trace = NULL;
+}
+
 /* allocate some tmp space for a string */
 static char *get_temp_buffer( size_t n )
 {
@@ -116,15 +454,12 @@ static const char *NTDLL_dbgstr_wn( const WCHAR *src, int n )
      return res;
 }
 
-/***********************************************************************
- *		NTDLL_dbg_vprintf
- */
-static int NTDLL_dbg_vprintf( const char *format, va_list args )
+/* format a debug message into the text output of the current thread */
+static int dbg_text_vprintf( struct debug_info *info, const char *format, va_list args )
 {
-    struct debug_info *info = get_info();
-    int end;
+    int end, ret;
 
-    int ret = vsnprintf( info->out_pos, sizeof(info->output) - (info->out_pos - info->output),
+    ret = vsnprintf( info->out_pos, sizeof(info->output) - (info->out_pos - info->output),
                          format, args );
 
     /* make sure we didn't exceed the buffer length
@@ -153,6 +488,38 @@ static int NTDLL_dbg_vprintf( const char *format, va_list args )
     return ret;
 }
 
+static int dbg_text_printf( struct debug_info *info, const char *format, ... )
+{
+    va_list args;
+    int ret;
+
+    va_start( args, format );
+    ret = dbg_text_vprintf( info, format, args );
+    va_end( args );
+    return ret;
+}
+
+/***********************************************************************
+ *		NTDLL_dbg_vprintf
+ */
+static int NTDLL_dbg_vprintf( const char *format, va_list args )
+{
+    struct debug_info *info = get_info();
+
+    if (trace_prefix)
+    {
+        va_list copy;
+        BOOL traced;
+
+        va_copy( copy, args );
+        traced = trace_message( info, TRACE_CLASS_CONT, NULL, NULL, format, copy );
+        va_end( copy );
+        /* a line started by an error or a fixme is completed on stderr too */
+        if (traced && info->out_pos == info->output) return 0;
+    }
+    return dbg_text_vprintf( info, format, args );
+}
+
 /***********************************************************************
  *		NTDLL_dbg_vlog
  */
@@ -163,23 +530,35 @@ static int NTDLL_dbg_vlog( enum __wine_debug_class cls, struct __wine_debug_chan
     struct debug_info *info = get_info();
     int ret = 0;
 
+    if (trace_prefix)
+    {
+        va_list copy;
+        BOOL traced;
+
+        va_copy( copy, args );
+        traced = trace_message( info, cls, channel->name, function, format, copy );
+        va_end( copy );
+        /* errors and fixmes still go to stderr, so that they get noticed */
+        if (traced && cls != __WINE_DBCL_ERR && cls != __WINE_DBCL_FIXME) return 0;
+    }
+
     /* only print header if we are at the beginning of the line */
     if (info->out_pos == info->output || info->out_pos[-1] == '\n')
     {
         if (TRACE_ON(timestamp))
         {
             ULONG ticks = NtGetTickCount();
-            ret = wine_dbg_printf( "%3u.%03u:", ticks / 1000, ticks % 1000 );
+            ret = dbg_text_printf( info, "%3u.%03u:", ticks / 1000, ticks % 1000 );
         }
         if (TRACE_ON(pid))
-            ret += wine_dbg_printf( "%04x:", GetCurrentProcessId() );
+            ret += dbg_text_printf( info, "%04x:", GetCurrentProcessId() );
         if (TRACE_ON(tid))
-            ret += wine_dbg_printf( "%04x:", GetCurrentThreadId() );
+            ret += dbg_text_printf( info, "%04x:", GetCurrentThreadId() );
         if (cls < sizeof(classes)/sizeof(classes[0]))
-            ret += wine_dbg_printf( "%s:%s:%s ", classes[cls], channel->name, function );
+            ret += dbg_text_printf( info, "%s:%s:%s ", classes[cls], channel->name, function );
     }
     if (format)
-        ret += NTDLL_dbg_vprintf( format, args );
+        ret += dbg_text_vprintf( info, format, args );
     return ret;
 }
 
@@ -199,5 +578,19 @@ static const struct __wine_debug_functions funcs =
  */
 void debug_init(void)
 {
+    const char *prefix = getenv( "WINEDEBUGRING" );
+
+    if (prefix && *prefix)
+    {
+        char name[MAX_PATH];
+
+        snprintf( name, sizeof(name), "%s.%d.str", prefix, (int)getpid() );
+        if ((trace_strings_fd = open( name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666 )) != -1)
+        {
+            fcntl( trace_strings_fd, F_SETFD, FD_CLOEXEC );
+            trace_prefix = prefix;
+        }
+        else fprintf( stderr, "wine: cannot create trace strings file %s\n", name );
+    }
     __wine_dbg_set_functions( &funcs, &default_funcs, sizeof(funcs) );
 }
@@ -173,6 +173,7 @@ union file_directory_info
     FILE_FULL_DIRECTORY_INFORMATION    full;
     FILE_ID_BOTH_DIRECTORY_INFORMATION id_both;
     FILE_ID_FULL_DIRECTORY_INFORMATION id_full;
+    FILE_NAMES_INFORMATION             names;
 };
 
 static BOOL show_dot_files;
@@ -255,6 +256,8 @@ static inline unsigned int dir_info_size( FILE_INFORMATION_CLASS class, unsigned
         return (FIELD_OFFSET( FILE_ID_BOTH_DIRECTORY_INFORMATION, FileName[len] ) + 7) & ~7;
     case FileIdFullDirectoryInformation:
         return (FIELD_OFFSET( FILE_ID_FULL_DIRECTORY_INFORMATION, FileName[len] ) + 7) & ~7;
+    case FileNamesInformation:
+        return (FIELD_OFFSET( FILE_NAMES_INFORMATION, FileName[len] ) + 7) & ~7;
     default:
         assert(0);
         return 0;
@@ -1435,14 +1438,16 @@ static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK
         if (!match_filename( &str, mask )) return NULL;
     }
 
-    if (get_file_info( long_name, &st, &attributes ) == -1) return NULL;
-    if (is_ignored_file( &st ))
+    /* names only don't need the file information, unless we have to check for ignored files */
+    if (class != FileNamesInformation || ignored_files_count)
     {
-        TRACE( "ignoring file %s\n", long_name );
-        return NULL;
+        if (get_file_info( long_name, &st, &attributes ) == -1) return NULL;
+        if (is_ignored_file( &st ))
+        {
+            TRACE( "ignoring file %s\n", long_name );
+            return NULL;
+        }
     }
-    if (!show_dot_files && long_name[0] == '.' && long_name[1] && (long_name[1] != '.' || long_name[2]))
-        attributes |= FILE_ATTRIBUTE_HIDDEN;
 
     total_len = dir_info_size( class, long_len );
     if (io->Information + total_len > max_length)
@@ -1451,14 +1456,24 @@ static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK
         io->u.Status = STATUS_BUFFER_OVERFLOW;
     }
     info = (union file_directory_info *)((char *)info_ptr + io->Information);
-    if (st.st_dev != curdir.dev) st.st_ino = 0;  /* ignore inode if on a different device */
-    /* all the structures start with a FileDirectoryInformation layout */
-    fill_file_info( &st, attributes, info, class );
+    if (class != FileNamesInformation)
+    {
+        if (!show_dot_files && long_name[0] == '.' && long_name[1] && (long_name[1] != '.' || long_name[2]))
+            attributes |= FILE_ATTRIBUTE_HIDDEN;
+        if (st.st_dev != curdir.dev) st.st_ino = 0;  /* ignore inode if on a different device */
+        /* all the structures start with a FileDirectoryInformation layout */
+        fill_file_info( &st, attributes, info, class );
+    }
     info->dir.NextEntryOffset = total_len;
     info->dir.FileIndex = 0;  /* NTFS always has 0 here, so let's not bother with it */
 
     switch (class)
     {
+    case FileNamesInformation:
+        info->names.FileNameLength = long_len * sizeof(WCHAR);
+        filename = info->names.FileName;
+        break;
+
     case FileDirectoryInformation:
         info->dir.FileNameLength = long_len * sizeof(WCHAR);
         filename = info->dir.FileName;
@@ -1656,6 +1671,47 @@ static char *read_first_dent_name( int which, int fd, off_t second_offs, KERNEL_
     return de->d_ino ? de->d_name : NULL;
 }
 
+/* position of the second entry in recently enumerated directories, to know
+ * when to return '..' when an enumeration is continued; protected by dir_section */
+#define SECOND_ENTRY_CACHE_SIZE 16
+
+static struct
+{
+    struct file_identity id;
+    off_t                pos;
+} second_entry_cache[SECOND_ENTRY_CACHE_SIZE];
+static unsigned int second_entry_cache_next;
+
+static BOOL get_second_entry_pos( off_t *pos )
+{
+    unsigned int i;
+
+    for (i = 0; i < SECOND_ENTRY_CACHE_SIZE; i++)
+    {
+        if (second_entry_cache[i].id.dev != curdir.dev || second_entry_cache[i].id.ino != curdir.ino)
+            continue;
+        *pos = second_entry_cache[i].pos;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static void set_second_entry_pos( off_t pos )
+{
+    unsigned int i;
+
+    for (i = 0; i < SECOND_ENTRY_CACHE_SIZE; i++)
+    {
+        if (second_entry_cache[i].id.dev != curdir.dev || second_entry_cache[i].id.ino != curdir.ino)
+            continue;
+        second_entry_cache[i].pos = pos;
+        return;
+    }
+    i = second_entry_cache_next++ % SECOND_ENTRY_CACHE_SIZE;
+    second_entry_cache[i].id  = curdir;
+    second_entry_cache[i].pos = pos;
+}
+
 /***********************************************************************
  *           read_directory_getdents
  *
@@ -1665,9 +1721,7 @@ static int read_directory_getdents( int fd, IO_STATUS_BLOCK *io, void *buffer, U
                                     BOOLEAN single_entry, const UNICODE_STRING *mask,
                                     BOOLEAN restart_scan, FILE_INFORMATION_CLASS class )
 {
-    static off_t second_entry_pos;
-    static struct file_identity last_dir_id;
-    off_t old_pos = 0, next_pos;
+    off_t second_entry_pos = -1, old_pos = 0, next_pos;
     size_t size = length;
     char *data, local_buffer[8192];
     KERNEL_DIRENT64 *de, *de_first_two = NULL;
@@ -1699,14 +1753,14 @@ static int read_directory_getdents( int fd, IO_STATUS_BLOCK *io, void *buffer, U
 
     /* if old_pos is not 0 we don't know how many entries have been returned already,
      * so maintain second_entry_pos to know when to return '..' */
-    if (old_pos != 0 && (last_dir_id.dev != curdir.dev || last_dir_id.ino != curdir.ino))
+    if (old_pos != 0 && !get_second_entry_pos( &second_entry_pos ))
     {
         lseek( fd, 0, SEEK_SET );
         res = getdents64( fd, data, size );
         if (res > 0)
         {
             second_entry_pos = de->d_off;
-            last_dir_id = curdir;
+            set_second_entry_pos( second_entry_pos );
         }
         lseek( fd, old_pos, SEEK_SET );
     }
@@ -1725,7 +1779,7 @@ static int read_directory_getdents( int fd, IO_STATUS_BLOCK *io, void *buffer, U
     if (old_pos == 0 && res > 0)
     {
         second_entry_pos = de->d_off;
-        last_dir_id = curdir;
+        set_second_entry_pos( second_entry_pos );
         if (res > de->d_reclen)
             de_first_two = de;
     }
@@ -2264,6 +2318,7 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
     case FileFullDirectoryInformation:
     case FileIdBothDirectoryInformation:
     case FileIdFullDirectoryInformation:
+    case FileNamesInformation:
         if (length < dir_info_size( info_class, 1 )) return io->u.Status = STATUS_INFO_LENGTH_MISMATCH;
         if (!buffer) return io->u.Status = STATUS_ACCESS_VIOLATION;
         break;
@@ -2324,6 +2379,227 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+/* cache of directory contents for case-insensitive lookups */
+
+#define DIR_CACHE_SIZE  32  /* max number of cached directories */
+
+struct dir_cache_name
+{
+    struct dir_cache_name *next;       /* next name in the same hash bucket */
+    const WCHAR           *nameW;      /* Unicode name */
+    int                    len;        /* length of nameW in chars */
+    char                   unix_name[1];
+};
+
+struct dir_cache
+{
+    struct list             entry;     /* entry in dir_cache_list, most recently used first */
+    dev_t                   dev;
+    ino_t                   ino;
+    time_t                  mtime;
+    long                    mtime_nsec;
+    unsigned int            hash_size;
+    struct dir_cache_name **hash;
+};
+
+static struct list dir_cache_list = LIST_INIT( dir_cache_list );
+static unsigned int dir_cache_count;
+
+static RTL_CRITICAL_SECTION dir_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG dir_cache_critsect_debug =
+{
+    0, 0, &dir_cache_section,
+    { &dir_cache_critsect_debug.ProcessLocksList, &dir_cache_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": dir_cache_section") }
+};
+static RTL_CRITICAL_SECTION dir_cache_section = { &dir_cache_critsect_debug, -1, 0, 0, 0, 0 };
+
+static inline long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/* must fold case the same way as memicmpW, which compares with tolowerW */
+static unsigned int hash_dir_cache_name( const WCHAR *name, int len )
+{
+    unsigned int hash = 0;
+    while (len--) hash = hash * 31 + tolowerW( *name++ );
+    return hash;
+}
+
+/***********************************************************************
+ *           free_dir_cache
+ */
+static void free_dir_cache( struct dir_cache *cache )
+{
+    struct dir_cache_name *name, *next;
+    unsigned int i;
+
+    for (i = 0; i < cache->hash_size; i++)
+    {
+        for (name = cache->hash[i]; name; name = next)
+        {
+            next = name->next;
+            RtlFreeHeap( GetProcessHeap(), 0, name );
+        }
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, cache->hash );
+    RtlFreeHeap( GetProcessHeap(), 0, cache );
+}
+
+/***********************************************************************
+ *           create_dir_cache
+ *
+ * Reads the contents of a directory into a new cache entry.
+ */
+static struct dir_cache *create_dir_cache( const char *unix_name, const struct stat *st )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    struct dir_cache_name *name, *next, *names = NULL;
+    struct dir_cache *cache;
+    struct dirent *de;
+    struct stat st2;
+    unsigned int count = 0, hash_size = 16;
+    DIR *dir;
+    BOOL ok = TRUE;
+
+    if (!(dir = opendir( unix_name ))) return NULL;
+    while ((de = readdir( dir )))
+    {
+        size_t unix_len = strlen( de->d_name ), size;
+        int len = ntdll_umbstowcs( 0, de->d_name, unix_len, buffer, MAX_DIR_ENTRY_LEN );
+
+        size = (FIELD_OFFSET( struct dir_cache_name, unix_name[unix_len + 1] ) + sizeof(WCHAR) - 1) & ~(sizeof(WCHAR) - 1);
+        if (!(name = RtlAllocateHeap( GetProcessHeap(), 0, size + len * sizeof(WCHAR) )))
+        {
+            ok = FALSE;
+            break;
+        }
+        memcpy( name->unix_name, de->d_name, unix_len + 1 );
+        name->nameW = (const WCHAR *)((char *)name + size);
+        memcpy( (WCHAR *)name->nameW, buffer, len * sizeof(WCHAR) );
+        name->len = len;
+        name->next = names;
+        names = name;
+        count++;
+    }
+
+    /* don't use the contents if the directory changed while we were reading it */
+    if (fstat( dirfd( dir ), &st2 ) == -1 || st2.st_mtime != st->st_mtime ||
+        get_mtime_nsec( &st2 ) != get_mtime_nsec( st ))
+        ok = FALSE;
+    closedir( dir );
+
+    while (hash_size < count) hash_size *= 2;
+    cache = NULL;
+    if (ok && (cache = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*cache) )))
+    {
+        if (!(cache->hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                             hash_size * sizeof(*cache->hash) )))
+        {
+            RtlFreeHeap( GetProcessHeap(), 0, cache );
+            cache = NULL;
+        }
+    }
+    if (!cache)
+    {
+        for (name = names; name; name = next)
+        {
+            next = name->next;
+            RtlFreeHeap( GetProcessHeap(), 0, name );
+        }
+        return NULL;
+    }
+
+    cache->dev        = st->st_dev;
+    cache->ino        = st->st_ino;
+    cache->mtime      = st->st_mtime;
+    cache->mtime_nsec = get_mtime_nsec( st );
+    cache->hash_size  = hash_size;
+    for (name = names; name; name = next)
+    {
+        unsigned int hash = hash_dir_cache_name( name->nameW, name->len ) & (hash_size - 1);
+        next = name->next;
+        name->next = cache->hash[hash];
+        cache->hash[hash] = name;
+    }
+    TRACE( "cached %u names for %s\n", count, debugstr_a(unix_name) );
+    return cache;
+}
+
+/***********************************************************************
+ *           find_file_in_dir_cache
+ *
+ * Look for a file in the cached contents of the directory unix_name,
+ * validated against the directory modification time. If found, the real
+ * name is appended to unix_name at pos.
+ * Returns 1 if found, 0 if the directory doesn't contain the name, and -1
+ * if the cache can't be used.
+ */
+static int find_file_in_dir_cache( char *unix_name, int pos, const WCHAR *name, int length )
+{
+    struct dir_cache *cache;
+    struct dir_cache_name *entry;
+    struct stat st;
+    int ret = 0;
+
+    if (stat( unix_name, &st ) == -1 || !S_ISDIR( st.st_mode )) return -1;
+
+    /* a directory modified within the granularity of its modification
+     * time could change again without the time changing */
+    if (time( NULL ) - st.st_mtime < 2) return -1;
+
+    RtlEnterCriticalSection( &dir_cache_section );
+
+    LIST_FOR_EACH_ENTRY( cache, &dir_cache_list, struct dir_cache, entry )
+    {
+        if (cache->dev != st.st_dev || cache->ino != st.st_ino) continue;
+        list_remove( &cache->entry );
+        if (cache->mtime == st.st_mtime && cache->mtime_nsec == get_mtime_nsec( &st )) goto found;
+        dir_cache_count--;
+        free_dir_cache( cache );
+        break;
+    }
+
+    if (!(cache = create_dir_cache( unix_name, &st )))
+    {
+        RtlLeaveCriticalSection( &dir_cache_section );
+        return -1;
+    }
+    if (dir_cache_count == DIR_CACHE_SIZE)
+    {
+        struct dir_cache *last = LIST_ENTRY( list_tail( &dir_cache_list ), struct dir_cache, entry );
+        list_remove( &last->entry );
+        free_dir_cache( last );
+    }
+    else dir_cache_count++;
+
+found:
+    list_add_head( &dir_cache_list, &cache->entry );
+
+    for (entry = cache->hash[hash_dir_cache_name( name, length ) & (cache->hash_size - 1)];
+         entry; entry = entry->next)
+    {
+        if (entry->len == length && !memicmpW( entry->nameW, name, length ))
+        {
+            unix_name[pos - 1] = '/';
+            strcpy( unix_name + pos, entry->unix_name );
+            ret = 1;
+            break;
+        }
+    }
+
+    RtlLeaveCriticalSection( &dir_cache_section );
+    return ret;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2434,6 +2710,16 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    /* short names are not cached, so only a match is conclusive for them */
+    switch (find_file_in_dir_cache( unix_name, pos, name, length ))
+    {
+    case 1:
+        goto success;
+    case 0:
+        if (!is_name_8_dot_3) goto not_found;
+        break;
+    }
+
     if (!(dir = opendir( unix_name )))
     {
         if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
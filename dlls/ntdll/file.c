@@ -30,6 +30,15 @@
 #ifdef HAVE_LINUX_MAJOR_H
 # include <linux/major.h>
 #endif
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
 #ifdef HAVE_SYS_STATVFS_H
 # include <sys/statvfs.h>
 #endif
@@ -95,6 +104,7 @@
 #define WIN32_NO_STATUS
 #define NONAMELESSUNION
 #include "wine/unicode.h"
+#include "wine/list.h"
 #include "wine/debug.h"
 #include "wine/server.h"
 #include "ntdll_misc.h"
@@ -486,6 +496,443 @@ NTSTATUS FILE_GetNtStatus(void)
     }
 }
 
+/***********************************************************************
+ *                  io_uring file I/O                                  *
+ *
+ * Overlapped reads and writes at an explicit offset on regular files that
+ * are waited for through an event are submitted to an io_uring instance and
+ * completed by a dedicated thread, instead of blocking the calling thread.
+ * Everything else keeps using the synchronous code paths.
+ *
+ * The completion thread only runs while requests are pending, so that it
+ * doesn't keep the process alive once the last application thread exits.
+ * If waiting for completions fails, the ring is destroyed, the requests it
+ * still holds are failed and later I/O uses the synchronous paths.
+ */
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+
+#define URING_ENTRIES 64
+
+struct uring_io
+{
+    struct list      entry;    /* entry in uring_requests */
+    HANDLE           handle;   /* duplicated file handle, for the completion port */
+    HANDLE           event;    /* duplicated event to signal on completion */
+    IO_STATUS_BLOCK *iosb;
+    ULONG_PTR        cvalue;   /* completion port value */
+    BOOL             is_read;
+    ULONG            length;   /* total length of the buffers */
+    struct iovec     iov[1];
+};
+
+static struct
+{
+    int                  fd;
+    unsigned int        *sq_tail;
+    unsigned int        *sq_mask;
+    unsigned int        *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned int        *cq_head;
+    unsigned int        *cq_tail;
+    unsigned int        *cq_mask;
+    struct io_uring_cqe *cqes;
+    char                *sq_ring;
+    char                *cq_ring;
+    size_t               sq_size;
+    size_t               cq_size;
+    size_t               sqes_size;
+} uring;
+
+static int uring_state;     /* 0: not initialized, 1: ready, -1: not available */
+static LONG uring_inflight; /* requests submitted and not yet completed */
+static BOOL uring_thread_running;
+/* requests queued to the kernel, protected by uring_section */
+static struct list uring_requests = LIST_INIT( uring_requests );
+
+static RTL_CRITICAL_SECTION uring_section;
+static RTL_CRITICAL_SECTION_DEBUG uring_critsect_debug =
+{
+    0, 0, &uring_section,
+    { &uring_critsect_debug.ProcessLocksList, &uring_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": uring_section") }
+};
+static RTL_CRITICAL_SECTION uring_section = { &uring_critsect_debug, -1, 0, 0, 0, 0 };
+
+static inline int io_uring_setup( unsigned int entries, struct io_uring_params *params )
+{
+    return syscall( __NR_io_uring_setup, entries, params );
+}
+
+static inline int io_uring_enter( int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags )
+{
+    return syscall( __NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0 );
+}
+
+/* release a request and the handles it holds */
+static void uring_free( struct uring_io *io )
+{
+    if (io->handle) NtClose( io->handle );
+    NtClose( io->event );
+    RtlFreeHeap( GetProcessHeap(), 0, io );
+}
+
+/* complete an io_uring request from the completion thread */
+static void uring_complete( struct uring_io *io, int res )
+{
+    NTSTATUS status;
+    ULONG total = 0;
+
+    if (res < 0)
+    {
+        errno = -res;
+        if (errno == EFAULT && !io->is_read) status = STATUS_INVALID_USER_BUFFER;
+        else status = FILE_GetNtStatus();
+    }
+    else
+    {
+        total = res;
+        status = (total || !io->length || !io->is_read) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
+    }
+    TRACE( "%p: %s status %x total %u\n", io->handle, io->is_read ? "read" : "write", status, total );
+
+    io->iosb->Information = total;
+    io->iosb->u.Status = status;
+    NtSetEvent( io->event, NULL );
+    if (io->cvalue) NTDLL_AddCompletion( io->handle, io->cvalue, status, total );
+    uring_free( io );
+    interlocked_xchg_add( &uring_inflight, -1 );
+}
+
+/* destroy the io_uring instance after a fatal error, and fail the requests it still holds;
+ * uring_section must be held */
+static void uring_shutdown( struct list *requests )
+{
+    uring_state = -1;
+    uring_thread_running = FALSE;
+    list_move_tail( requests, &uring_requests );
+
+    /* tearing down the ring cancels the requests, so the kernel no longer uses their buffers */
+    munmap( uring.sq_ring, uring.sq_size );
+    munmap( uring.cq_ring, uring.cq_size );
+    munmap( uring.sqes, uring.sqes_size );
+    close( uring.fd );
+}
+
+static void CALLBACK uring_completion_proc( void *arg )
+{
+    struct list failed = LIST_INIT( failed );
+    struct list *ptr;
+    unsigned int head, tail;
+    int err;
+
+    for (;;)
+    {
+        head = *uring.cq_head;
+        tail = __atomic_load_n( uring.cq_tail, __ATOMIC_ACQUIRE );
+        if (head == tail)
+        {
+            RtlEnterCriticalSection( &uring_section );
+            if (list_empty( &uring_requests ))
+            {
+                uring_thread_running = FALSE;
+                RtlLeaveCriticalSection( &uring_section );
+                break;
+            }
+            RtlLeaveCriticalSection( &uring_section );
+            if (io_uring_enter( uring.fd, 0, 1, IORING_ENTER_GETEVENTS ) == -1 && errno != EINTR)
+            {
+                err = errno;
+                ERR( "io_uring_enter failed, errno %d\n", err );
+                RtlEnterCriticalSection( &uring_section );
+                uring_shutdown( &failed );
+                RtlLeaveCriticalSection( &uring_section );
+                while ((ptr = list_head( &failed )))
+                {
+                    list_remove( ptr );
+                    uring_complete( LIST_ENTRY( ptr, struct uring_io, entry ), -err );
+                }
+                break;
+            }
+            continue;
+        }
+        while (head != tail)
+        {
+            struct io_uring_cqe *cqe = &uring.cqes[head & *uring.cq_mask];
+            struct uring_io *io = (struct uring_io *)(ULONG_PTR)cqe->user_data;
+            int res = cqe->res;
+
+            __atomic_store_n( uring.cq_head, ++head, __ATOMIC_RELEASE );
+            RtlEnterCriticalSection( &uring_section );
+            list_remove( &io->entry );
+            RtlLeaveCriticalSection( &uring_section );
+            uring_complete( io, res );
+        }
+    }
+    RtlExitUserThread( 0 );
+}
+
+/* create the io_uring instance */
+static BOOL uring_init(void)
+{
+    struct io_uring_params params;
+    size_t sq_size, cq_size, sqes_size;
+    char *sq_ring, *cq_ring;
+    struct io_uring_sqe *sqes;
+    const char *env;
+    int fd;
+
+    if ((env = getenv( "WINEIOURING" )) && !atoi( env )) return FALSE;
+
+    memset( &params, 0, sizeof(params) );
+    if ((fd = io_uring_setup( URING_ENTRIES, &params )) == -1)
+    {
+        TRACE( "io_uring not available, errno %d\n", errno );
+        return FALSE;
+    }
+    fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sq_ring = mmap( NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQ_RING );
+    cq_ring = mmap( NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_CQ_RING );
+    sqes = mmap( NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQES );
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) goto failed;
+
+    uring.fd       = fd;
+    uring.sq_tail  = (unsigned int *)(sq_ring + params.sq_off.tail);
+    uring.sq_mask  = (unsigned int *)(sq_ring + params.sq_off.ring_mask);
+    uring.sq_array = (unsigned int *)(sq_ring + params.sq_off.array);
+    uring.sqes     = sqes;
+    uring.cq_head  = (unsigned int *)(cq_ring + params.cq_off.head);
+    uring.cq_tail  = (unsigned int *)(cq_ring + params.cq_off.tail);
+    uring.cq_mask  = (unsigned int *)(cq_ring + params.cq_off.ring_mask);
+    uring.cqes     = (struct io_uring_cqe *)(cq_ring + params.cq_off.cqes);
+    uring.sq_ring  = sq_ring;
+    uring.cq_ring  = cq_ring;
+    uring.sq_size  = sq_size;
+    uring.cq_size  = cq_size;
+    uring.sqes_size = sqes_size;
+    TRACE( "using io_uring with %u entries\n", params.sq_entries );
+    return TRUE;
+
+failed:
+    if (sq_ring != MAP_FAILED) munmap( sq_ring, sq_size );
+    if (cq_ring != MAP_FAILED) munmap( cq_ring, cq_size );
+    if (sqes != MAP_FAILED) munmap( sqes, sqes_size );
+    close( fd );
+    return FALSE;
+}
+
+/***********************************************************************
+ *           uring_submitv
+ *
+ * Queue a vectored read or write on a regular file. Returns STATUS_NOT_SUPPORTED
+ * if the caller has to fall back to synchronous I/O.
+ */
+static NTSTATUS uring_submitv( HANDLE handle, int fd, HANDLE event, ULONG_PTR cvalue,
+                               IO_STATUS_BLOCK *iosb, const struct iovec *iov, unsigned int count,
+                               ULONGLONG offset, BOOL is_read )
+{
+    struct io_uring_sqe *sqe;
+    struct uring_io *io;
+    unsigned int i, tail, index;
+    HANDLE thread;
+    int ret;
+
+    if (!uring_state)
+    {
+        RtlEnterCriticalSection( &uring_section );
+        if (!uring_state) uring_state = uring_init() ? 1 : -1;
+        RtlLeaveCriticalSection( &uring_section );
+    }
+    if (uring_state < 0) return STATUS_NOT_SUPPORTED;
+
+    /* never have more requests in flight than the completion ring can hold */
+    if (interlocked_xchg_add( &uring_inflight, 1 ) >= URING_ENTRIES) goto failed;
+    if (!(io = RtlAllocateHeap( GetProcessHeap(), 0, FIELD_OFFSET( struct uring_io, iov[count] ))))
+        goto failed;
+
+    /* the caller may close its handles before the request completes */
+    io->handle = 0;
+    if (NtDuplicateObject( NtCurrentProcess(), event, NtCurrentProcess(), &io->event,
+                           0, 0, DUPLICATE_SAME_ACCESS ))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, io );
+        goto failed;
+    }
+    if (cvalue && NtDuplicateObject( NtCurrentProcess(), handle, NtCurrentProcess(), &io->handle,
+                                     0, 0, DUPLICATE_SAME_ACCESS ))
+    {
+        uring_free( io );
+        goto failed;
+    }
+    io->iosb    = iosb;
+    io->cvalue  = cvalue;
+    io->is_read = is_read;
+    io->length  = 0;
+    for (i = 0; i < count; i++)
+    {
+        io->iov[i] = iov[i];
+        io->length += iov[i].iov_len;
+    }
+
+    iosb->u.Status = STATUS_PENDING;
+    NtResetEvent( event, NULL );
+
+    RtlEnterCriticalSection( &uring_section );
+    if (uring_state < 0)  /* the ring has been shut down in the meantime */
+    {
+        RtlLeaveCriticalSection( &uring_section );
+        uring_free( io );
+        goto failed;
+    }
+    if (!uring_thread_running)
+    {
+        if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                 uring_completion_proc, NULL, &thread, NULL ))
+        {
+            RtlLeaveCriticalSection( &uring_section );
+            uring_free( io );
+            goto failed;
+        }
+        NtClose( thread );
+        uring_thread_running = TRUE;
+    }
+    tail  = *uring.sq_tail;
+    index = tail & *uring.sq_mask;
+    sqe   = &uring.sqes[index];
+    memset( sqe, 0, sizeof(*sqe) );
+    sqe->opcode    = is_read ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd        = fd;
+    sqe->off       = offset;
+    sqe->addr      = (ULONG_PTR)io->iov;
+    sqe->len       = count;
+    sqe->user_data = (ULONG_PTR)io;
+    uring.sq_array[index] = index;
+    __atomic_store_n( uring.sq_tail, tail + 1, __ATOMIC_RELEASE );
+    /* the kernel takes its own reference to the file, so the fd may be closed on return */
+    while ((ret = io_uring_enter( uring.fd, 1, 0, 0 )) == -1 && errno == EINTR);
+    if (ret == 1) list_add_tail( &uring_requests, &io->entry );
+    else __atomic_store_n( uring.sq_tail, tail, __ATOMIC_RELEASE );
+    RtlLeaveCriticalSection( &uring_section );
+
+    if (ret == 1) return STATUS_PENDING;
+
+    WARN( "submission failed, errno %d\n", errno );
+    uring_free( io );
+failed:
+    interlocked_xchg_add( &uring_inflight, -1 );
+    return STATUS_NOT_SUPPORTED;
+}
+
+#else  /* HAVE_LINUX_IO_URING_H */
+
+static inline NTSTATUS uring_submitv( HANDLE handle, int fd, HANDLE event, ULONG_PTR cvalue,
+                                      IO_STATUS_BLOCK *iosb, const struct iovec *iov, unsigned int count,
+                                      ULONGLONG offset, BOOL is_read )
+{
+    return STATUS_NOT_SUPPORTED;
+}
+
+#endif  /* HAVE_LINUX_IO_URING_H */
+
+static inline NTSTATUS uring_submit( HANDLE handle, int fd, HANDLE event, ULONG_PTR cvalue,
+                                     IO_STATUS_BLOCK *iosb, const void *buffer, ULONG length,
+                                     ULONGLONG offset, BOOL is_read )
+{
+    struct iovec iov;
+
+    iov.iov_base = (void *)buffer;
+    iov.iov_len  = length;
+    return uring_submitv( handle, fd, event, cvalue, iosb, &iov, 1, offset, is_read );
+}
+
+#ifndef HAVE_PREADV
+/* fallback that only transfers the first buffer; callers handle short reads */
+static ssize_t preadv( int fd, const struct iovec *iov, int count, off_t offset )
+{
+    return pread( fd, iov[0].iov_base, iov[0].iov_len, offset );
+}
+#endif
+
+#ifndef HAVE_PWRITEV
+/* fallback that only transfers the first buffer; callers handle short writes */
+static ssize_t pwritev( int fd, const struct iovec *iov, int count, off_t offset )
+{
+    return pwrite( fd, iov[0].iov_base, iov[0].iov_len, offset );
+}
+#endif
+
+/* maximum number of pages transferred by a single scatter/gather system call */
+#define MAX_SEGMENT_IOV 64
+
+/* fill an iovec array from a segment list, starting at offset pos in the first page */
+static unsigned int get_segment_iov( struct iovec *iov, FILE_SEGMENT_ELEMENT *segments,
+                                     ULONG pos, ULONG length )
+{
+    unsigned int count = 0;
+
+    while (length && count < MAX_SEGMENT_IOV)
+    {
+        iov[count].iov_base = (char *)segments[count].Buffer + pos;
+        iov[count].iov_len  = min( page_size - pos, length );
+        length -= iov[count].iov_len;
+        pos = 0;
+        count++;
+    }
+    return count;
+}
+
+/***********************************************************************
+ *           segment_io
+ *
+ * Synchronous transfer of a scatter/gather segment list, batching up to
+ * MAX_SEGMENT_IOV pages per system call.
+ */
+static NTSTATUS segment_io( int fd, FILE_SEGMENT_ELEMENT *segments, ULONG length,
+                            const LARGE_INTEGER *offset, BOOL is_read, ULONG *total )
+{
+    struct iovec iov[MAX_SEGMENT_IOV];
+    BOOL use_offset = offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION;
+    unsigned int count;
+    ULONG pos = 0;
+    ssize_t result;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    *total = 0;
+
+    while (length)
+    {
+        count = get_segment_iov( iov, segments, pos, length );
+        if (use_offset)
+            result = is_read ? preadv( fd, iov, count, offset->QuadPart + *total )
+                             : pwritev( fd, iov, count, offset->QuadPart + *total );
+        else
+            result = is_read ? readv( fd, iov, count ) : writev( fd, iov, count );
+
+        if (result == -1)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EFAULT && !is_read) status = STATUS_INVALID_USER_BUFFER;
+            else status = FILE_GetNtStatus();
+            break;
+        }
+        if (!result)
+        {
+            status = is_read ? STATUS_END_OF_FILE : STATUS_DISK_FULL;
+            break;
+        }
+        *total += result;
+        length -= result;
+        pos += result;
+        segments += pos / page_size;
+        pos %= page_size;
+    }
+    return status;
+}
+
 /***********************************************************************
  *             FILE_AsyncReadService      (INTERNAL)
  */
@@ -844,6 +1291,11 @@ NTSTATUS WINAPI NtReadFile(HANDLE hFile, HANDLE hEvent,
 
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
+            if (async_read && hEvent && !apc &&
+                (status = uring_submit( hFile, unix_handle, hEvent, cvalue, io_status, buffer, length,
+                                        offset->QuadPart, TRUE )) != STATUS_NOT_SUPPORTED)
+                goto err;
+
             /* async I/O doesn't make sense on regular files */
             while ((result = pread( unix_handle, buffer, length, offset->QuadPart )) == -1)
             {
@@ -1015,10 +1467,10 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
                                    PIO_STATUS_BLOCK io_status, FILE_SEGMENT_ELEMENT *segments,
                                    ULONG length, PLARGE_INTEGER offset, PULONG key )
 {
-    int result, unix_handle, needs_close;
+    int unix_handle, needs_close;
     unsigned int options;
     NTSTATUS status;
-    ULONG pos = 0, total = 0;
+    ULONG total = 0;
     enum server_fd_type type;
     ULONG_PTR cvalue = apc ? 0 : (ULONG_PTR)apc_user;
     BOOL send_completion = FALSE;
@@ -1041,34 +1493,18 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         goto error;
     }
 
-    while (length)
+    if (event && !apc && offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION &&
+        length <= MAX_SEGMENT_IOV * page_size)
     {
-        if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            result = pread( unix_handle, (char *)segments->Buffer + pos,
-                            page_size - pos, offset->QuadPart + total );
-        else
-            result = read( unix_handle, (char *)segments->Buffer + pos, page_size - pos );
+        struct iovec iov[MAX_SEGMENT_IOV];
+        unsigned int count = get_segment_iov( iov, segments, 0, length );
 
-        if (result == -1)
-        {
-            if (errno == EINTR) continue;
-            status = FILE_GetNtStatus();
-            break;
-        }
-        if (!result)
-        {
-            status = STATUS_END_OF_FILE;
-            break;
-        }
-        total += result;
-        length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
-        }
+        if ((status = uring_submitv( file, unix_handle, event, cvalue, io_status, iov, count,
+                                     offset->QuadPart, TRUE )) != STATUS_NOT_SUPPORTED)
+            goto error;
     }
 
+    status = segment_io( unix_handle, segments, length, offset, TRUE, &total );
     send_completion = cvalue != 0;
 
  error:
@@ -1260,6 +1696,10 @@ NTSTATUS WINAPI NtWriteFile(HANDLE hFile, HANDLE hEvent,
                 status = STATUS_INVALID_PARAMETER;
                 goto done;
             }
+            else if (async_write && hEvent && !apc &&
+                     (status = uring_submit( hFile, unix_handle, hEvent, cvalue, io_status, buffer, length,
+                                             off, FALSE )) != STATUS_NOT_SUPPORTED)
+                goto err;
 
             /* async I/O doesn't make sense on regular files */
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
@@ -1421,10 +1861,10 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
                                    PIO_STATUS_BLOCK io_status, FILE_SEGMENT_ELEMENT *segments,
                                    ULONG length, PLARGE_INTEGER offset, PULONG key )
 {
-    int result, unix_handle, needs_close;
+    int unix_handle, needs_close;
     unsigned int options;
     NTSTATUS status;
-    ULONG pos = 0, total = 0;
+    ULONG total = 0;
     enum server_fd_type type;
     ULONG_PTR cvalue = apc ? 0 : (ULONG_PTR)apc_user;
     BOOL send_completion = FALSE;
@@ -1447,39 +1887,19 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         goto error;
     }
 
-    while (length)
+    if (event && !apc && offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION &&
+        length <= MAX_SEGMENT_IOV * page_size)
     {
-        if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            result = pwrite( unix_handle, (char *)segments->Buffer + pos,
-                             page_size - pos, offset->QuadPart + total );
-        else
-            result = write( unix_handle, (char *)segments->Buffer + pos, page_size - pos );
+        struct iovec iov[MAX_SEGMENT_IOV];
+        unsigned int count = get_segment_iov( iov, segments, 0, length );
 
-        if (result == -1)
-        {
-            if (errno == EINTR) continue;
-            if (errno == EFAULT)
-            {
-                status = STATUS_INVALID_USER_BUFFER;
-                goto error;
-            }
-            status = FILE_GetNtStatus();
-            break;
-        }
-        if (!result)
-        {
-            status = STATUS_DISK_FULL;
-            break;
-        }
-        total += result;
-        length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
-        }
+        if ((status = uring_submitv( file, unix_handle, event, cvalue, io_status, iov, count,
+                                     offset->QuadPart, FALSE )) != STATUS_NOT_SUPPORTED)
+            goto error;
     }
 
+    status = segment_io( unix_handle, segments, length, offset, FALSE, &total );
+    if (status == STATUS_INVALID_USER_BUFFER) goto error;
     send_completion = cvalue != 0;
 
  error:
@@ -46,8 +46,10 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(module);
 WINE_DECLARE_DEBUG_CHANNEL(relay);
+WINE_DECLARE_DEBUG_CHANNEL(relaystat);
 WINE_DECLARE_DEBUG_CHANNEL(snoop);
 WINE_DECLARE_DEBUG_CHANNEL(loaddll);
+WINE_DECLARE_DEBUG_CHANNEL(loadtime);
 WINE_DECLARE_DEBUG_CHANNEL(imports);
 WINE_DECLARE_DEBUG_CHANNEL(pid);
 
@@ -84,6 +86,9 @@ typedef struct _wine_modref
     LDR_MODULE            ldr;
     int                   nDeps;
     struct _wine_modref **deps;
+    DWORD                *export_hash;       /* hash of exported names, built on demand */
+    DWORD                 export_hash_size;  /* number of buckets, a power of 2 */
+    struct _wine_modref  *hash_next[3];      /* next in module_hash buckets */
 } WINE_MODREF;
 
 /* info about the current builtin dll load */
@@ -117,6 +122,16 @@ static WINE_MODREF *cached_modref;
 static WINE_MODREF *current_modref;
 static WINE_MODREF *last_failed_modref;
 
+/* hash tables of the modules in the load order list, buckets are kept in load order */
+enum module_hash_type
+{
+    HASH_BASE,      /* base address */
+    HASH_BASENAME,  /* case-insensitive base name */
+    HASH_FULLNAME   /* case-insensitive full path name */
+};
+#define MODULE_HASH_SIZE 256
+static WINE_MODREF *module_hash[3][MODULE_HASH_SIZE];
+
 static NTSTATUS load_dll( LPCWSTR load_path, LPCWSTR libname, DWORD flags, WINE_MODREF** pwm );
 static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved );
 static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
@@ -130,6 +145,15 @@ static inline void *get_rva( HMODULE module, DWORD va )
     return (void *)((char *)module + va);
 }
 
+/* elapsed time in microseconds since a previous performance counter value */
+static inline ULONG elapsed_us( const LARGE_INTEGER *start )
+{
+    LARGE_INTEGER now, freq;
+
+    NtQueryPerformanceCounter( &now, &freq );
+    return (now.QuadPart - start->QuadPart) * 1000000 / freq.QuadPart;
+}
+
 /* check whether the file name contains a path */
 static inline BOOL contains_path( LPCWSTR name )
 {
@@ -336,6 +360,83 @@ static inline ULONG_PTR allocate_stub( const char *dll, const char *name ) { ret
 #endif  /* __i386__ */
 
 
+/*************************************************************************
+ *		hash_module_base
+ */
+static inline unsigned int hash_module_base( HMODULE hmod )
+{
+    return ((ULONG_PTR)hmod >> 16) % MODULE_HASH_SIZE;  /* modules are 64k aligned */
+}
+
+
+/*************************************************************************
+ *		hash_module_name
+ *
+ * Case-insensitive hash of a module name.
+ */
+static inline unsigned int hash_module_name( LPCWSTR name )
+{
+    unsigned int hash = 0;
+
+    while (*name) hash = hash * 31 + tolowerW( *name++ );
+    return hash % MODULE_HASH_SIZE;
+}
+
+
+/*************************************************************************
+ *		insert_module_hash
+ */
+static void insert_module_hash( enum module_hash_type type, unsigned int hash, WINE_MODREF *wm, BOOL head )
+{
+    WINE_MODREF **ptr = &module_hash[type][hash];
+
+    if (!head) while (*ptr) ptr = &(*ptr)->hash_next[type];
+    wm->hash_next[type] = *ptr;
+    *ptr = wm;
+}
+
+
+/*************************************************************************
+ *		remove_module_hash
+ */
+static void remove_module_hash( enum module_hash_type type, unsigned int hash, WINE_MODREF *wm )
+{
+    WINE_MODREF **ptr = &module_hash[type][hash];
+
+    while (*ptr && *ptr != wm) ptr = &(*ptr)->hash_next[type];
+    if (*ptr) *ptr = wm->hash_next[type];
+    wm->hash_next[type] = NULL;
+}
+
+
+/*************************************************************************
+ *		hash_module
+ *
+ * Add a module to the lookup hash tables, at the same position as in the load order list.
+ * The loader_section must be locked while calling this function.
+ */
+static void hash_module( WINE_MODREF *wm, BOOL head )
+{
+    insert_module_hash( HASH_BASE, hash_module_base( wm->ldr.BaseAddress ), wm, head );
+    insert_module_hash( HASH_BASENAME, hash_module_name( wm->ldr.BaseDllName.Buffer ), wm, head );
+    insert_module_hash( HASH_FULLNAME, hash_module_name( wm->ldr.FullDllName.Buffer ), wm, head );
+}
+
+
+/*************************************************************************
+ *		unhash_module
+ *
+ * Remove a module from the lookup hash tables.
+ * The loader_section must be locked while calling this function.
+ */
+static void unhash_module( WINE_MODREF *wm )
+{
+    remove_module_hash( HASH_BASE, hash_module_base( wm->ldr.BaseAddress ), wm );
+    remove_module_hash( HASH_BASENAME, hash_module_name( wm->ldr.BaseDllName.Buffer ), wm );
+    remove_module_hash( HASH_FULLNAME, hash_module_name( wm->ldr.FullDllName.Buffer ), wm );
+}
+
+
 /*************************************************************************
  *		get_modref
  *
@@ -344,19 +445,12 @@ static inline ULONG_PTR allocate_stub( const char *dll, const char *name ) { ret
  */
 static WINE_MODREF *get_modref( HMODULE hmod )
 {
-    PLIST_ENTRY mark, entry;
-    PLDR_MODULE mod;
+    WINE_MODREF *wm;
 
     if (cached_modref && cached_modref->ldr.BaseAddress == hmod) return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
-    {
-        mod = CONTAINING_RECORD(entry, LDR_MODULE, InMemoryOrderModuleList);
-        if (mod->BaseAddress == hmod)
-            return cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-        if (mod->BaseAddress > (void*)hmod) break;
-    }
+    for (wm = module_hash[HASH_BASE][hash_module_base( hmod )]; wm; wm = wm->hash_next[HASH_BASE])
+        if (wm->ldr.BaseAddress == hmod) return cached_modref = wm;
     return NULL;
 }
 
@@ -369,21 +463,13 @@ static WINE_MODREF *get_modref( HMODULE hmod )
  */
 static WINE_MODREF *find_basename_module( LPCWSTR name )
 {
-    PLIST_ENTRY mark, entry;
+    WINE_MODREF *wm;
 
     if (cached_modref && !strcmpiW( name, cached_modref->ldr.BaseDllName.Buffer ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
-    {
-        LDR_MODULE *mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
-        if (!strcmpiW( name, mod->BaseDllName.Buffer ))
-        {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
-        }
-    }
+    for (wm = module_hash[HASH_BASENAME][hash_module_name( name )]; wm; wm = wm->hash_next[HASH_BASENAME])
+        if (!strcmpiW( name, wm->ldr.BaseDllName.Buffer )) return cached_modref = wm;
     return NULL;
 }
 
@@ -396,21 +482,13 @@ static WINE_MODREF *find_basename_module( LPCWSTR name )
  */
 static WINE_MODREF *find_fullname_module( LPCWSTR name )
 {
-    PLIST_ENTRY mark, entry;
+    WINE_MODREF *wm;
 
     if (cached_modref && !strcmpiW( name, cached_modref->ldr.FullDllName.Buffer ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
-    {
-        LDR_MODULE *mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
-        if (!strcmpiW( name, mod->FullDllName.Buffer ))
-        {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
-        }
-    }
+    for (wm = module_hash[HASH_FULLNAME][hash_module_name( name )]; wm; wm = wm->hash_next[HASH_FULLNAME])
+        if (!strcmpiW( name, wm->ldr.FullDllName.Buffer )) return cached_modref = wm;
     return NULL;
 }
 
@@ -513,7 +591,7 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
         const WCHAR *user = current_modref ? current_modref->ldr.BaseDllName.Buffer : NULL;
         proc = SNOOP_GetProcAddress( module, exports, exp_size, proc, ordinal, user );
     }
-    if (TRACE_ON(relay))
+    if (TRACE_ON(relay) || TRACE_ON(relaystat))
     {
         const WCHAR *user = current_modref ? current_modref->ldr.BaseDllName.Buffer : NULL;
         proc = RELAY_GetProcAddress( module, exports, exp_size, proc, ordinal, user );
@@ -522,6 +600,75 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
 }
 
 
+/*************************************************************************
+ *		hash_export_name
+ */
+static inline DWORD hash_export_name( const char *name )
+{
+    DWORD hash = 2166136261u;  /* FNV-1a */
+
+    while (*name) hash = (hash ^ (unsigned char)*name++) * 16777619;
+    return hash;
+}
+
+
+/*************************************************************************
+ *		build_export_hash
+ *
+ * Build the hash table of exported names for a module.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL build_export_hash( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports )
+{
+    const DWORD *names = get_rva( wm->ldr.BaseAddress, exports->AddressOfNames );
+    DWORD i, pos, size = 16;
+
+    while (size < 2 * exports->NumberOfNames) size *= 2;
+    if (!(wm->export_hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                             size * sizeof(*wm->export_hash) )))
+        return FALSE;
+    wm->export_hash_size = size;
+
+    /* buckets store the name index + 1, 0 means empty */
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        pos = hash_export_name( get_rva( wm->ldr.BaseAddress, names[i] )) & (size - 1);
+        while (wm->export_hash[pos]) pos = (pos + 1) & (size - 1);
+        wm->export_hash[pos] = i + 1;
+    }
+    return TRUE;
+}
+
+
+/*************************************************************************
+ *		find_export_hash
+ *
+ * Find the index of an exported name using the module hash table.
+ * Returns -1 if the name is not found, -2 if no hash table is available.
+ * The loader_section must be locked while calling this function.
+ */
+static int find_export_hash( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports, const char *name )
+{
+    const DWORD *names = get_rva( module, exports->AddressOfNames );
+    WINE_MODREF *wm;
+    DWORD pos;
+
+    /* small tables are searched faster than hashed */
+    if (exports->NumberOfNames < 32) return -2;
+    if (!(wm = get_modref( module ))) return -2;
+    if (!wm->export_hash && !build_export_hash( wm, exports )) return -2;
+
+    pos = hash_export_name( name ) & (wm->export_hash_size - 1);
+    while (wm->export_hash[pos])
+    {
+        DWORD index = wm->export_hash[pos] - 1;
+        if (!strcmp( get_rva( module, names[index] ), name )) return index;
+        pos = (pos + 1) & (wm->export_hash_size - 1);
+    }
+    return -1;
+}
+
+
 /*************************************************************************
  *		find_named_export
  *
@@ -534,6 +681,7 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
     const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
     int min = 0, max = exports->NumberOfNames - 1;
+    int index;
 
     /* first check the hint */
     if (hint >= 0 && hint <= max)
@@ -543,6 +691,13 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
+    /* then try the hash table */
+    if ((index = find_export_hash( module, exports, name )) != -2)
+    {
+        if (index < 0) return NULL;
+        return find_ordinal_export( module, exports, exp_size, ordinals[index], load_path );
+    }
+
     /* then do a binary search */
     while (min <= max)
     {
@@ -927,6 +1082,8 @@ static WINE_MODREF *alloc_module( HMODULE hModule, LPCWSTR filename )
 
     wm->nDeps    = 0;
     wm->deps     = NULL;
+    wm->export_hash = NULL;
+    wm->export_hash_size = 0;
 
     wm->ldr.BaseAddress   = hModule;
     wm->ldr.EntryPoint    = NULL;
@@ -954,6 +1111,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, LPCWSTR filename )
 
     InsertTailList(&NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList,
                    &wm->ldr.InLoadOrderModuleList);
+    hash_module( wm, FALSE );
 
     /* insert module in MemoryList, sorted in increasing base addresses */
     mark = &NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList;
@@ -1203,8 +1361,14 @@ static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved )
     if (status == STATUS_SUCCESS)
     {
         WINE_MODREF *prev = current_modref;
+        LARGE_INTEGER start;
+
+        if (TRACE_ON(loadtime)) NtQueryPerformanceCounter( &start, NULL );
         current_modref = wm;
         status = MODULE_InitDLL( wm, DLL_PROCESS_ATTACH, lpReserved );
+        if (TRACE_ON(loadtime))
+            TRACE_(loadtime)( "process attach of %s took %u us\n",
+                              debugstr_w(wm->ldr.BaseDllName.Buffer), elapsed_us( &start ));
         if (status == STATUS_SUCCESS)
             wm->ldr.Flags |= LDR_PROCESS_ATTACHED;
         else
@@ -1602,6 +1766,7 @@ static void load_builtin_callback( void *module, const char *filename )
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
             RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+            unhash_module( wm );
             /* FIXME: free the modref */
             builtin_load_info->status = STATUS_DLL_NOT_FOUND;
             return;
@@ -1627,7 +1792,7 @@ static void load_builtin_callback( void *module, const char *filename )
     SERVER_END_REQ;
 
     /* setup relay debugging entry points */
-    if (TRACE_ON(relay)) RELAY_SetupDLL( module );
+    if (TRACE_ON(relay) || TRACE_ON(relaystat)) RELAY_SetupDLL( module );
 }
 
 
@@ -1687,12 +1852,15 @@ static NTSTATUS perform_relocations( void *module, SIZE_T len )
     const IMAGE_DATA_DIRECTORY *relocs;
     const IMAGE_SECTION_HEADER *sec;
     INT_PTR delta;
-    ULONG protect_old[96], i;
+    ULONG protect_old[96], protect_header, i;
+    void *header;
+    SIZE_T header_size;
 
     nt = RtlImageNtHeader( module );
     base = (char *)nt->OptionalHeader.ImageBase;
 
-    assert( module != base );
+    /* already relocated, the image was mapped from the relocation cache */
+    if (module == base) return STATUS_SUCCESS;
 
     /* no relocations are performed on non page-aligned binaries */
     if (nt->OptionalHeader.SectionAlignment < page_size)
@@ -1746,6 +1914,16 @@ static NTSTATUS perform_relocations( void *module, SIZE_T len )
         if (!rel) return STATUS_INVALID_IMAGE_FORMAT;
     }
 
+    /* like Windows, update the base in the header; this also marks the image as relocated */
+    header = &nt->OptionalHeader.ImageBase;
+    header_size = sizeof(nt->OptionalHeader.ImageBase);
+    if (!NtProtectVirtualMemory( NtCurrentProcess(), &header, &header_size, PAGE_READWRITE, &protect_header ))
+    {
+        nt->OptionalHeader.ImageBase = (ULONG_PTR)module;
+        NtProtectVirtualMemory( NtCurrentProcess(), &header, &header_size, protect_header, &protect_header );
+        virtual_cache_relocated_image( module );
+    }
+
     for (i = 0; i < nt->FileHeader.NumberOfSections; i++)
     {
         void *addr = get_rva( module, sec[i].VirtualAddress );
@@ -1816,6 +1994,7 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, LPCWSTR name, HANDLE file,
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
             RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+            unhash_module( wm );
 
             /* FIXME: there are several more dangling references
              * left. Including dlls loaded by this dll before the
@@ -2213,10 +2392,13 @@ static NTSTATUS load_dll( LPCWSTR load_path, LPCWSTR libname, DWORD flags, WINE_
     ULONG size;
     WINE_MODREF *main_exe;
     HANDLE handle = 0;
+    LARGE_INTEGER start;
     NTSTATUS nts;
 
     TRACE( "looking for %s in %s\n", debugstr_w(libname), debugstr_w(load_path) );
 
+    if (TRACE_ON(loadtime)) NtQueryPerformanceCounter( &start, NULL );
+
     *pwm = NULL;
     filename = buffer;
     size = sizeof(buffer);
@@ -2299,6 +2481,9 @@ static NTSTATUS load_dll( LPCWSTR load_path, LPCWSTR libname, DWORD flags, WINE_
         TRACE("Loaded module %s (%s) at %p\n", debugstr_w(filename),
               ((*pwm)->ldr.Flags & LDR_WINE_INTERNAL) ? "builtin" : "native",
               (*pwm)->ldr.BaseAddress);
+        if (TRACE_ON(loadtime))
+            TRACE_(loadtime)( "loading %s took %u us including imports\n",
+                              debugstr_w(filename), elapsed_us( &start ));
         if (handle) NtClose( handle );
         if (filename != buffer) RtlFreeHeap( GetProcessHeap(), 0, filename );
         return nts;
@@ -2723,6 +2908,9 @@ void WINAPI LdrShutdownProcess(void)
     TRACE("()\n");
     process_detaching = TRUE;
     process_detach();
+    critsect_dump_lockstat();
+    threadpool_dump_stats();
+    RELAY_DumpStats();
 }
 
 
@@ -2794,6 +2982,7 @@ static void free_modref( WINE_MODREF *wm )
 {
     RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
     RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+    unhash_module( wm );
     if (wm->ldr.InInitializationOrderModuleList.Flink)
         RemoveEntryList(&wm->ldr.InInitializationOrderModuleList);
 
@@ -2817,6 +3006,7 @@ static void free_modref( WINE_MODREF *wm )
     if (cached_modref == wm) cached_modref = NULL;
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
     RtlFreeHeap( GetProcessHeap(), 0, wm->deps );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_hash );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
 }
 
@@ -3077,6 +3267,8 @@ void WINAPI LdrInitializeThunk( void *kernel_start, ULONG_PTR unknown2,
     /* the main exe needs to be the first in the load order list */
     RemoveEntryList( &wm->ldr.InLoadOrderModuleList );
     InsertHeadList( &peb->LdrData->InLoadOrderModuleList, &wm->ldr.InLoadOrderModuleList );
+    unhash_module( wm );
+    hash_module( wm, TRUE );
 
     if ((status = virtual_alloc_thread_stack( NtCurrentTeb(), 0, 0 )) != STATUS_SUCCESS) goto error;
     if ((status = server_init_process_done()) != STATUS_SUCCESS) goto error;
@@ -3246,6 +3438,7 @@ void CDECL __wine_init_windows_dir( const WCHAR *windir, const WCHAR *sysdir )
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
         LDR_MODULE *mod = CONTAINING_RECORD( entry, LDR_MODULE, InLoadOrderModuleList );
+        WINE_MODREF *wm = CONTAINING_RECORD( mod, WINE_MODREF, ldr );
 
         assert( mod->Flags & LDR_WINE_INTERNAL );
 
@@ -3256,8 +3449,10 @@ void CDECL __wine_init_windows_dir( const WCHAR *windir, const WCHAR *sysdir )
         p = buffer + strlenW( buffer );
         if (p > buffer && p[-1] != '\\') *p++ = '\\';
         strcpyW( p, mod->FullDllName.Buffer );
+        unhash_module( wm );
         RtlInitUnicodeString( &mod->FullDllName, buffer );
         RtlInitUnicodeString( &mod->BaseDllName, p );
+        hash_module( wm, FALSE );
     }
 }
 
@@ -42,6 +42,7 @@ WINE_DEFAULT_DEBUG_CHANNEL(relay);
 
 WINE_DECLARE_DEBUG_CHANNEL(timestamp);
 WINE_DECLARE_DEBUG_CHANNEL(pid);
+WINE_DECLARE_DEBUG_CHANNEL(relaystat);
 
 struct relay_descr  /* descriptor for a module */
 {
@@ -65,14 +66,42 @@ struct relay_entry_point
     const char *name;         /* function name (if any) */
 };
 
+#define RELAY_HIST_BUCKETS 8  /* call time buckets: < 1us, then growing by a factor of 4 */
+
+/* call statistics gathered with +relaystat */
+struct relay_stat
+{
+    LONG        calls;
+    LONGLONG    time;                       /* inclusive time in 100ns units */
+    LONG        hist[RELAY_HIST_BUCKETS];   /* histogram of call times */
+    char       *name;                       /* copy of the function name, the dll may be unloaded */
+};
+
 struct relay_private_data
 {
     HMODULE                  module;            /* module handle of this dll */
     unsigned int             base;              /* ordinal base */
     char                     dllname[40];       /* dll name (without .dll extension) */
+    struct relay_private_data *next;            /* next dll with statistics */
+    struct relay_stat       *stats;             /* per entry point statistics, for +relaystat */
     struct relay_entry_point entry_points[1];   /* list of dll entry points */
 };
 
+/* per-thread stack of the calls being timed */
+#define RELAY_STACK_SIZE 256
+
+struct relay_stack
+{
+    unsigned int depth;
+    struct
+    {
+        const INT_PTR *stack;   /* stack pointer of the call, to match the return */
+        LONGLONG       start;
+    } frames[RELAY_STACK_SIZE];
+};
+
+static struct relay_private_data *stat_dlls;
+
 static const WCHAR **debug_relay_excludelist;
 static const WCHAR **debug_relay_includelist;
 static const WCHAR **debug_snoop_excludelist;
@@ -325,6 +354,103 @@ static void print_timestamp(void)
     DPRINTF( "%3u.%03u:", ticks / 1000, ticks % 1000 );
 }
 
+/***********************************************************************
+ *           relay_stat_entry
+ *
+ * Count a call and remember its start time for +relaystat.
+ */
+static void relay_stat_entry( struct relay_private_data *data, WORD ordinal, const INT_PTR *stack )
+{
+    struct debug_info *info = ntdll_get_thread_data()->debug_info;
+    struct relay_stack *rs = info->relay_stack;
+    LARGE_INTEGER now;
+
+    if (!data->stats) return;
+    interlocked_xchg_add( &data->stats[ordinal].calls, 1 );
+
+    if (!rs && !(rs = info->relay_stack = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*rs) )))
+        return;
+    if (rs->depth == RELAY_STACK_SIZE) return;  /* too deep, the call won't be timed */
+    NtQueryPerformanceCounter( &now, NULL );
+    rs->frames[rs->depth].stack = stack;
+    rs->frames[rs->depth].start = now.QuadPart;
+    rs->depth++;
+}
+
+/***********************************************************************
+ *           relay_stat_exit
+ *
+ * Record the time spent in a call for +relaystat.
+ */
+static void relay_stat_exit( struct relay_private_data *data, WORD ordinal, const INT_PTR *stack )
+{
+    struct relay_stack *rs = ntdll_get_thread_data()->debug_info->relay_stack;
+    struct relay_stat *stat;
+    LARGE_INTEGER now;
+    LONGLONG elapsed, limit;
+    unsigned int bucket;
+
+    if (!data->stats || !rs) return;
+    NtQueryPerformanceCounter( &now, NULL );
+
+    /* drop the calls that were left through an exception */
+    while (rs->depth && rs->frames[rs->depth - 1].stack < stack) rs->depth--;
+    if (!rs->depth || rs->frames[rs->depth - 1].stack != stack) return;
+    elapsed = now.QuadPart - rs->frames[--rs->depth].start;
+
+    for (bucket = 0, limit = 10; bucket < RELAY_HIST_BUCKETS - 1 && elapsed >= limit; bucket++) limit *= 4;
+
+    /* updated without locking, so the times may be slightly off with several threads */
+    stat = &data->stats[ordinal];
+    stat->time += elapsed;
+    interlocked_xchg_add( &stat->hist[bucket], 1 );
+}
+
+static int stat_compare( const void *a, const void *b )
+{
+    const struct relay_stat *stat1 = *(const struct relay_stat * const *)a;
+    const struct relay_stat *stat2 = *(const struct relay_stat * const *)b;
+
+    if (stat1->time != stat2->time) return stat1->time < stat2->time ? 1 : -1;
+    return stat2->calls - stat1->calls;
+}
+
+/***********************************************************************
+ *           RELAY_DumpStats
+ *
+ * Print the call statistics gathered with +relaystat, most expensive first.
+ */
+void RELAY_DumpStats(void)
+{
+    struct relay_private_data *data;
+    struct relay_stat **stats;
+    unsigned int i, j, count = 0;
+
+    if (!TRACE_ON(relaystat)) return;
+
+    for (data = stat_dlls; data; data = data->next)
+        for (i = 0; data->stats[i].name; i++) if (data->stats[i].calls) count++;
+    if (!count || !(stats = RtlAllocateHeap( GetProcessHeap(), 0, count * sizeof(*stats) ))) return;
+
+    count = 0;
+    for (data = stat_dlls; data; data = data->next)
+        for (i = 0; data->stats[i].name; i++) if (data->stats[i].calls) stats[count++] = &data->stats[i];
+    qsort( stats, count, sizeof(*stats), stat_compare );
+
+    TRACE_(relaystat)( "%u functions called, inclusive times in us, histogram of calls "
+                       "<1us <4us <16us <64us <256us <1ms <4ms more\n", count );
+    for (i = 0; i < count; i++)
+    {
+        char hist[RELAY_HIST_BUCKETS * 11 + 1], *p = hist;
+
+        for (j = 0; j < RELAY_HIST_BUCKETS; j++) p += sprintf( p, " %u", stats[i]->hist[j] );
+        TRACE_(relaystat)( "%s: %u calls, total %s, avg %s,%s\n", stats[i]->name, stats[i]->calls,
+                           wine_dbgstr_longlong( stats[i]->time / 10 ),
+                           wine_dbgstr_longlong( stats[i]->time / 10 / stats[i]->calls ), hist );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, stats );
+}
+
 /***********************************************************************
  *           relay_trace_entry
  *
@@ -337,6 +463,8 @@ void * WINAPI relay_trace_entry( struct relay_descr *descr, unsigned int idx, co
     struct relay_private_data *data = descr->private;
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
 
+    relay_stat_entry( data, ordinal, stack );
+
     if (TRACE_ON(relay))
     {
         if (TRACE_ON(timestamp)) print_timestamp();
@@ -365,6 +493,8 @@ void WINAPI relay_trace_exit( struct relay_descr *descr, unsigned int idx,
     struct relay_private_data *data = descr->private;
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
 
+    relay_stat_exit( data, ordinal, stack );
+
     if (!TRACE_ON(relay)) return;
 
     if (TRACE_ON(timestamp)) print_timestamp();
@@ -497,6 +627,8 @@ void WINAPI __regs_relay_call_regs( struct relay_descr *descr, unsigned int idx,
     context->Eip = ret_addr;
     context->Esp += nb_args * sizeof(int);
 
+    relay_stat_entry( data, ordinal, args );
+
     if (TRACE_ON(relay))
     {
         if (entry_point->name)
@@ -524,6 +656,8 @@ void WINAPI __regs_relay_call_regs( struct relay_descr *descr, unsigned int idx,
 
     call_entry_point( orig_func + 12 + *(int *)(orig_func + 1), nb_args, args_copy, 0 );
 
+    relay_stat_exit( data, ordinal, args );
+
     if (TRACE_ON(relay))
     {
         if (entry_point->name)
@@ -749,6 +883,26 @@ void RELAY_SetupDLL( HMODULE module )
         data->entry_points[i].orig_func = (char *)module + *funcs;
         *funcs = entry_point_rva + descr->entry_point_offsets[i];
     }
+
+    /* allocate the statistics, with an extra entry without name to end the list */
+
+    if (TRACE_ON(relaystat) &&
+        (data->stats = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                        (exports->NumberOfFunctions + 1) * sizeof(*data->stats) )))
+    {
+        for (i = 0; i < exports->NumberOfFunctions; i++)
+        {
+            char buffer[16], *name = buffer;
+
+            if (data->entry_points[i].name) name = (char *)data->entry_points[i].name;
+            else sprintf( buffer, "%u", i + exports->Base );
+            len = strlen( data->dllname ) + strlen( name ) + 2;
+            if (!(data->stats[i].name = RtlAllocateHeap( GetProcessHeap(), 0, len ))) break;
+            sprintf( data->stats[i].name, "%s.%s", data->dllname, name );
+        }
+        data->next = stat_dlls;
+        stat_dlls = data;
+    }
 }
 
 #else  /* __i386__ || __x86_64__ || __arm__ */
@@ -763,6 +917,10 @@ void RELAY_SetupDLL( HMODULE module )
 {
 }
 
+void RELAY_DumpStats(void)
+{
+}
+
 #endif  /* __i386__ || __x86_64__ || __arm__ */
 
 
@@ -26,6 +26,9 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -48,6 +51,60 @@ static const union cptable *ansi_table;
 static const union cptable *oem_table;
 static const union cptable* unix_table; /* NULL if UTF8 */
 
+/* length of the common prefix of two strings, ignoring case, in blocks of 8 chars;
+ * the blocks are compared case-insensitively only when they are 7-bit ASCII */
+static inline unsigned int caseless_prefix( const WCHAR *str1, const WCHAR *str2, unsigned int len )
+{
+    unsigned int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i non_ascii = _mm_set1_epi16( 0xff80 );
+    const __m128i case_bit = _mm_set1_epi16( 0x20 );
+
+    for ( ; i + 8 <= len; i += 8)
+    {
+        __m128i val1 = _mm_loadu_si128( (const __m128i *)(str1 + i) );
+        __m128i val2 = _mm_loadu_si128( (const __m128i *)(str2 + i) );
+
+        if (_mm_movemask_epi8( _mm_cmpeq_epi16( _mm_and_si128( _mm_or_si128( val1, val2 ), non_ascii ),
+                                                zero )) == 0xffff)
+        {
+            /* letters only differ by the case bit, other ASCII chars need an exact match */
+            __m128i diff = _mm_xor_si128( val1, val2 );
+            __m128i lower = _mm_or_si128( val1, case_bit );
+            __m128i letter = _mm_and_si128( _mm_cmpgt_epi16( lower, _mm_set1_epi16( 'a' - 1 )),
+                                            _mm_cmplt_epi16( lower, _mm_set1_epi16( 'z' + 1 )));
+            diff = _mm_andnot_si128( _mm_and_si128( letter, case_bit ), diff );
+            if (_mm_movemask_epi8( _mm_cmpeq_epi16( diff, zero )) != 0xffff) break;
+        }
+        else if (_mm_movemask_epi8( _mm_cmpeq_epi16( val1, val2 )) != 0xffff) break;
+    }
+#endif
+    return i;
+}
+
+/* upcase the leading blocks of 8 chars that are 7-bit ASCII */
+static inline unsigned int ascii_upcase( WCHAR *dst, const WCHAR *src, unsigned int len )
+{
+    unsigned int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i non_ascii = _mm_set1_epi16( 0xff80 );
+
+    for ( ; i + 8 <= len; i += 8)
+    {
+        __m128i val = _mm_loadu_si128( (const __m128i *)(src + i) );
+        __m128i lower;
+
+        if (_mm_movemask_epi8( _mm_cmpeq_epi16( _mm_and_si128( val, non_ascii ), zero )) != 0xffff) break;
+        lower = _mm_and_si128( _mm_cmpgt_epi16( val, _mm_set1_epi16( 'a' - 1 )),
+                               _mm_cmplt_epi16( val, _mm_set1_epi16( 'z' + 1 )));
+        _mm_storeu_si128( (__m128i *)(dst + i), _mm_sub_epi16( val, _mm_and_si128( lower, _mm_set1_epi16( 0x20 ))));
+    }
+#endif
+    return i;
+}
+
 
 /**************************************************************************
  *	__wine_init_codepages   (NTDLL.@)
@@ -467,7 +524,18 @@ LONG WINAPI RtlCompareUnicodeString( const UNICODE_STRING *s1, const UNICODE_STR
 
     if (CaseInsensitive)
     {
-        while (!ret && len--) ret = toupperW(*p1++) - toupperW(*p2++);
+        while (len)
+        {
+            unsigned int count = caseless_prefix( p1, p2, len );
+
+            p1 += count;
+            p2 += count;
+            if (!(len -= count)) break;
+            if ((ret = toupperW(*p1) - toupperW(*p2))) break;
+            p1++;
+            p2++;
+            len--;
+        }
     }
     else
     {
@@ -1026,8 +1094,15 @@ NTSTATUS WINAPI RtlUpcaseUnicodeString( UNICODE_STRING *dest,
     }
     else if (len > dest->MaximumLength) return STATUS_BUFFER_OVERFLOW;
 
-    for (i = 0; i < len/sizeof(WCHAR); i++) dest->Buffer[i] = toupperW(src->Buffer[i]);
-    dest->Length = len;
+    len /= sizeof(WCHAR);
+    for (i = 0; i < len; )
+    {
+        DWORD end;
+
+        i += ascii_upcase( dest->Buffer + i, src->Buffer + i, len - i );
+        for (end = min( i + 8, len ); i < end; i++) dest->Buffer[i] = toupperW(src->Buffer[i]);
+    }
+    dest->Length = len * sizeof(WCHAR);
     return STATUS_SUCCESS;
 }
 
@@ -315,8 +315,6 @@ static wine_signal_handler handlers[256];
 
 struct dynamic_unwind_entry
 {
-    struct list entry;
-
     /* memory region which matches this entry */
     DWORD64 base;
     DWORD size;
@@ -328,9 +326,17 @@ struct dynamic_unwind_entry
     /* user defined callback */
     PGET_RUNTIME_FUNCTION_CALLBACK callback;
     PVOID context;
+
+    /* registration order, earlier entries take precedence on overlap */
+    unsigned int seq;
 };
 
-static struct list dynamic_unwind_list = LIST_INIT(dynamic_unwind_list);
+/* registered entries, sorted by base address */
+static struct dynamic_unwind_entry **dynamic_unwind_table;
+static unsigned int dynamic_unwind_count;
+static unsigned int dynamic_unwind_max;
+static unsigned int dynamic_unwind_seq;
+static DWORD dynamic_unwind_max_size;  /* largest region size, bounds the lookup */
 
 static RTL_CRITICAL_SECTION dynamic_unwind_section;
 static RTL_CRITICAL_SECTION_DEBUG dynamic_unwind_debug =
@@ -2152,6 +2158,8 @@ static EXCEPTION_RECORD *setup_exception( ucontext_t *sigcontext, raise_func fun
 
 /**********************************************************************
  *           find_function_info
+ *
+ * Binary search in a function table. The returned entry may be chained.
  */
 static RUNTIME_FUNCTION *find_function_info( ULONG64 pc, HMODULE module,
                                              RUNTIME_FUNCTION *func, ULONG size )
@@ -2164,26 +2172,168 @@ static RUNTIME_FUNCTION *find_function_info( ULONG64 pc, HMODULE module,
         int pos = (min + max) / 2;
         if ((char *)pc < (char *)module + func[pos].BeginAddress) max = pos - 1;
         else if ((char *)pc >= (char *)module + func[pos].EndAddress) min = pos + 1;
-        else
+        else return func + pos;
+    }
+    return NULL;
+}
+
+/**********************************************************************
+ *           follow_chained_function
+ */
+static inline RUNTIME_FUNCTION *follow_chained_function( ULONG64 base, RUNTIME_FUNCTION *func )
+{
+    while (func->UnwindData & 1)  /* follow chained entry */
+        func = (RUNTIME_FUNCTION *)((char *)base + (func->UnwindData & ~1));
+    return func;
+}
+
+/**********************************************************************
+ *           lookup_history_table
+ *
+ * Look for a function entry found earlier during the same unwind.
+ */
+static RUNTIME_FUNCTION *lookup_history_table( UNWIND_HISTORY_TABLE *table, ULONG64 pc, ULONG64 *base )
+{
+    ULONG i;
+
+    if (!table || !table->Count) return NULL;
+    if (pc < table->LowAddress || pc >= table->HighAddress) return NULL;
+
+    for (i = 0; i < table->Count && i < UNWIND_HISTORY_TABLE_SIZE; i++)
+    {
+        ULONG64 image = table->Entry[i].ImageBase;
+        RUNTIME_FUNCTION *func = table->Entry[i].FunctionEntry;
+
+        if (pc >= image + func->BeginAddress && pc < image + func->EndAddress)
         {
-            func += pos;
-            while (func->UnwindData & 1)  /* follow chained entry */
-                func = (RUNTIME_FUNCTION *)((char *)module + (func->UnwindData & ~1));
-            return func;
+            *base = image;
+            return follow_chained_function( image, func );
         }
     }
     return NULL;
 }
 
+/**********************************************************************
+ *           add_history_table_entry
+ */
+static void add_history_table_entry( UNWIND_HISTORY_TABLE *table, ULONG64 base, RUNTIME_FUNCTION *func )
+{
+    ULONG64 start = base + func->BeginAddress, end = base + func->EndAddress;
+
+    if (!table || table->Count >= UNWIND_HISTORY_TABLE_SIZE) return;
+
+    if (!table->Count)
+    {
+        table->LowAddress  = start;
+        table->HighAddress = end;
+    }
+    else
+    {
+        if (start < table->LowAddress) table->LowAddress = start;
+        if (end > table->HighAddress) table->HighAddress = end;
+    }
+    table->Entry[table->Count].ImageBase     = base;
+    table->Entry[table->Count].FunctionEntry = func;
+    table->Count++;
+}
+
+/**********************************************************************
+ *           find_dynamic_unwind_pos
+ *
+ * Return the number of dynamic entries with a base address <= addr.
+ * Must be called with the dynamic_unwind_section held.
+ */
+static unsigned int find_dynamic_unwind_pos( DWORD64 addr )
+{
+    unsigned int min = 0, max = dynamic_unwind_count;
+
+    while (min < max)
+    {
+        unsigned int pos = (min + max) / 2;
+        if (dynamic_unwind_table[pos]->base <= addr) min = pos + 1;
+        else max = pos;
+    }
+    return min;
+}
+
+/**********************************************************************
+ *           find_dynamic_unwind_entry
+ *
+ * Must be called with the dynamic_unwind_section held.
+ */
+static struct dynamic_unwind_entry *find_dynamic_unwind_entry( ULONG64 pc )
+{
+    struct dynamic_unwind_entry *entry, *found = NULL;
+    unsigned int pos = find_dynamic_unwind_pos( pc );
+
+    /* only entries starting less than max_size below pc can contain it */
+    while (pos--)
+    {
+        entry = dynamic_unwind_table[pos];
+        if (pc - entry->base >= dynamic_unwind_max_size) break;
+        if (pc - entry->base < entry->size && (!found || entry->seq < found->seq)) found = entry;
+    }
+    return found;
+}
+
+/**********************************************************************
+ *           add_dynamic_unwind_entry
+ */
+static BOOL add_dynamic_unwind_entry( struct dynamic_unwind_entry *entry )
+{
+    unsigned int pos;
+
+    RtlEnterCriticalSection( &dynamic_unwind_section );
+
+    if (dynamic_unwind_count == dynamic_unwind_max)
+    {
+        struct dynamic_unwind_entry **new_table;
+        unsigned int new_max = max( 16, dynamic_unwind_max * 2 );
+
+        if (dynamic_unwind_table)
+            new_table = RtlReAllocateHeap( GetProcessHeap(), 0, dynamic_unwind_table,
+                                           new_max * sizeof(*new_table) );
+        else
+            new_table = RtlAllocateHeap( GetProcessHeap(), 0, new_max * sizeof(*new_table) );
+
+        if (!new_table)
+        {
+            RtlLeaveCriticalSection( &dynamic_unwind_section );
+            return FALSE;
+        }
+        dynamic_unwind_table = new_table;
+        dynamic_unwind_max   = new_max;
+    }
+
+    pos = find_dynamic_unwind_pos( entry->base );
+    memmove( dynamic_unwind_table + pos + 1, dynamic_unwind_table + pos,
+             (dynamic_unwind_count - pos) * sizeof(*dynamic_unwind_table) );
+    dynamic_unwind_table[pos] = entry;
+    dynamic_unwind_count++;
+
+    entry->seq = dynamic_unwind_seq++;
+    if (entry->size > dynamic_unwind_max_size) dynamic_unwind_max_size = entry->size;
+
+    RtlLeaveCriticalSection( &dynamic_unwind_section );
+    return TRUE;
+}
+
 /**********************************************************************
  *           lookup_function_info
  */
-static RUNTIME_FUNCTION *lookup_function_info( ULONG64 pc, ULONG64 *base, LDR_MODULE **module )
+static RUNTIME_FUNCTION *lookup_function_info( ULONG64 pc, ULONG64 *base, LDR_MODULE **module,
+                                               UNWIND_HISTORY_TABLE *table )
 {
     RUNTIME_FUNCTION *func = NULL;
     struct dynamic_unwind_entry *entry;
     ULONG size;
 
+    if ((func = lookup_history_table( table, pc, base )))
+    {
+        *module = NULL;
+        return func;
+    }
+
     /* PE module or wine module */
     if (!LdrFindEntryForAddress( (void *)pc, module ))
     {
@@ -2192,7 +2342,11 @@ static RUNTIME_FUNCTION *lookup_function_info( ULONG64 pc, ULONG64 *base, LDR_MO
                                                   IMAGE_DIRECTORY_ENTRY_EXCEPTION, &size )))
         {
             /* lookup in function table */
-            func = find_function_info( pc, (*module)->BaseAddress, func, size );
+            if ((func = find_function_info( pc, (*module)->BaseAddress, func, size )))
+            {
+                add_history_table_entry( table, *base, func );
+                func = follow_chained_function( *base, func );
+            }
         }
     }
     else
@@ -2200,18 +2354,17 @@ static RUNTIME_FUNCTION *lookup_function_info( ULONG64 pc, ULONG64 *base, LDR_MO
         *module = NULL;
 
         RtlEnterCriticalSection( &dynamic_unwind_section );
-        LIST_FOR_EACH_ENTRY( entry, &dynamic_unwind_list, struct dynamic_unwind_entry, entry )
+        if ((entry = find_dynamic_unwind_entry( pc )))
         {
-            if (pc >= entry->base && pc < entry->base + entry->size)
-            {
-                *base = entry->base;
+            *base = entry->base;
 
-                /* use callback or lookup in function table */
-                if (entry->callback)
-                    func = entry->callback( pc, entry->context );
-                else
-                    func = find_function_info( pc, (HMODULE)entry->base, entry->table, entry->table_size );
-                break;
+            /* use callback or lookup in function table */
+            if (entry->callback)
+                func = entry->callback( pc, entry->context );
+            else if ((func = find_function_info( pc, (HMODULE)entry->base, entry->table, entry->table_size )))
+            {
+                add_history_table_entry( table, *base, func );
+                func = follow_chained_function( *base, func );
             }
         }
         RtlLeaveCriticalSection( &dynamic_unwind_section );
@@ -2303,6 +2456,7 @@ static NTSTATUS call_stack_handlers( EXCEPTION_RECORD *rec, CONTEXT *orig_contex
     NTSTATUS status;
 
     context = *orig_context;
+    table.Count = 0;
     dispatch.TargetIp      = 0;
     dispatch.ContextRecord = &context;
     dispatch.HistoryTable  = &table;
@@ -2311,13 +2465,11 @@ static NTSTATUS call_stack_handlers( EXCEPTION_RECORD *rec, CONTEXT *orig_contex
     {
         new_context = context;
 
-        /* FIXME: should use the history table to make things faster */
-
         dispatch.ImageBase = 0;
 
         /* first look for PE exception information */
 
-        if ((dispatch.FunctionEntry = lookup_function_info( context.Rip, &dispatch.ImageBase, &module )))
+        if ((dispatch.FunctionEntry = lookup_function_info( context.Rip, &dispatch.ImageBase, &module, &table )))
         {
             dispatch.LanguageHandler = RtlVirtualUnwind( UNW_FLAG_EHANDLER, dispatch.ImageBase,
                                                          context.Rip, dispatch.FunctionEntry,
@@ -2849,10 +3001,11 @@ BOOLEAN CDECL RtlAddFunctionTable( RUNTIME_FUNCTION *table, DWORD count, DWORD64
     entry->callback   = NULL;
     entry->context    = NULL;
 
-    RtlEnterCriticalSection( &dynamic_unwind_section );
-    list_add_tail( &dynamic_unwind_list, &entry->entry );
-    RtlLeaveCriticalSection( &dynamic_unwind_section );
-
+    if (!add_dynamic_unwind_entry( entry ))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, entry );
+        return FALSE;
+    }
     return TRUE;
 }
 
@@ -2884,10 +3037,11 @@ BOOLEAN CDECL RtlInstallFunctionTableCallback( DWORD64 table, DWORD64 base, DWOR
     entry->callback   = callback;
     entry->context    = context;
 
-    RtlEnterCriticalSection( &dynamic_unwind_section );
-    list_add_tail( &dynamic_unwind_list, &entry->entry );
-    RtlLeaveCriticalSection( &dynamic_unwind_section );
-
+    if (!add_dynamic_unwind_entry( entry ))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, entry );
+        return FALSE;
+    }
     return TRUE;
 }
 
@@ -2897,17 +3051,20 @@ BOOLEAN CDECL RtlInstallFunctionTableCallback( DWORD64 table, DWORD64 base, DWOR
  */
 BOOLEAN CDECL RtlDeleteFunctionTable( RUNTIME_FUNCTION *table )
 {
-    struct dynamic_unwind_entry *entry, *to_free = NULL;
+    struct dynamic_unwind_entry *to_free = NULL;
+    unsigned int i;
 
     TRACE( "%p\n", table );
 
     RtlEnterCriticalSection( &dynamic_unwind_section );
-    LIST_FOR_EACH_ENTRY( entry, &dynamic_unwind_list, struct dynamic_unwind_entry, entry )
+    for (i = 0; i < dynamic_unwind_count; i++)
     {
-        if (entry->table == table)
+        if (dynamic_unwind_table[i]->table == table)
         {
-            to_free = entry;
-            list_remove( &entry->entry );
+            to_free = dynamic_unwind_table[i];
+            memmove( dynamic_unwind_table + i, dynamic_unwind_table + i + 1,
+                     (dynamic_unwind_count - i - 1) * sizeof(*dynamic_unwind_table) );
+            dynamic_unwind_count--;
             break;
         }
     }
@@ -2929,9 +3086,7 @@ PRUNTIME_FUNCTION WINAPI RtlLookupFunctionEntry( ULONG64 pc, ULONG64 *base, UNWI
     LDR_MODULE *module;
     RUNTIME_FUNCTION *func;
 
-    /* FIXME: should use the history table to make things faster */
-
-    func = lookup_function_info( pc, base, &module );
+    func = lookup_function_info( pc, base, &module, table );
     if (!func)
     {
         *base = 0;
@@ -3354,6 +3509,7 @@ void WINAPI RtlUnwindEx( PVOID end_frame, PVOID target_ip, EXCEPTION_RECORD *rec
 {
     EXCEPTION_REGISTRATION_RECORD *teb_frame = NtCurrentTeb()->Tib.ExceptionList;
     EXCEPTION_RECORD record;
+    UNWIND_HISTORY_TABLE local_table;
     DISPATCHER_CONTEXT dispatch;
     CONTEXT new_context;
     LDR_MODULE *module;
@@ -3392,18 +3548,21 @@ void WINAPI RtlUnwindEx( PVOID end_frame, PVOID target_ip, EXCEPTION_RECORD *rec
     dispatch.EstablisherFrame = context->Rsp;
     dispatch.TargetIp         = (ULONG64)target_ip;
     dispatch.ContextRecord    = context;
+    if (!table)
+    {
+        local_table.Count = 0;
+        table = &local_table;
+    }
     dispatch.HistoryTable     = table;
 
     for (;;)
     {
-        /* FIXME: should use the history table to make things faster */
-
         dispatch.ImageBase = 0;
         dispatch.ScopeIndex = 0; /* FIXME */
 
         /* first look for PE exception information */
 
-        if ((dispatch.FunctionEntry = lookup_function_info( context->Rip, &dispatch.ImageBase, &module )))
+        if ((dispatch.FunctionEntry = lookup_function_info( context->Rip, &dispatch.ImageBase, &module, table )))
         {
             dispatch.LanguageHandler = RtlVirtualUnwind( UNW_FLAG_UHANDLER, dispatch.ImageBase,
                                                          context->Rip, dispatch.FunctionEntry,
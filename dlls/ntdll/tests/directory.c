@@ -231,6 +231,53 @@ static void test_flags_NtQueryDirectoryFile(OBJECT_ATTRIBUTES *attr, const char
     pNtClose(dirh);
 }
 
+static void test_names_NtQueryDirectoryFile(OBJECT_ATTRIBUTES *attr, const char *testdirA)
+{
+    HANDLE dirh;
+    IO_STATUS_BLOCK io;
+    BYTE data[8192];
+    FILE_NAMES_INFORMATION *names;
+    UINT data_pos;
+    DWORD status;
+    int i, j;
+
+    reset_found_files();
+
+    status = pNtOpenFile( &dirh, SYNCHRONIZE | FILE_LIST_DIRECTORY, attr, &io, FILE_SHARE_READ,
+                         FILE_SYNCHRONOUS_IO_NONALERT|FILE_OPEN_FOR_BACKUP_INTENT|FILE_DIRECTORY_FILE);
+    ok (status == STATUS_SUCCESS, "failed to open dir '%s', ret 0x%x\n", testdirA, status);
+    if (status != STATUS_SUCCESS) return;
+
+    status = pNtQueryDirectoryFile( dirh, NULL, NULL, NULL, &io, data, sizeof(data),
+                                    FileNamesInformation, FALSE, NULL, TRUE );
+    ok (status == STATUS_SUCCESS, "failed to query directory; status %x\n", status);
+    if (status != STATUS_SUCCESS)
+    {
+        pNtClose( dirh );
+        return;
+    }
+
+    for (data_pos = 0, j = 0; j < max_test_dir_size; j++)
+    {
+        names = (FILE_NAMES_INFORMATION *)(data + data_pos);
+        ok( !names->FileIndex, "got file index %u\n", names->FileIndex );
+        for (i = 0; testfiles[i].name; i++)
+        {
+            if (names->FileNameLength != strlen(testfiles[i].name) * sizeof(WCHAR)) continue;
+            if (memcmp( names->FileName, testfiles[i].nameW, names->FileNameLength )) continue;
+            testfiles[i].nfound++;
+        }
+        if (!names->NextEntryOffset) break;
+        data_pos += names->NextEntryOffset;
+        ok( data_pos < io.Information, "entry offset %u past end %lu\n", data_pos, io.Information );
+    }
+
+    for (i = 0; testfiles[i].name; i++)
+        ok( testfiles[i].nfound == 1, "Wrong number %d of %s files found\n",
+            testfiles[i].nfound, testfiles[i].description );
+    pNtClose( dirh );
+}
+
 static void test_NtQueryDirectoryFile(void)
 {
     OBJECT_ATTRIBUTES attr;
@@ -257,6 +304,7 @@ static void test_NtQueryDirectoryFile(void)
     test_flags_NtQueryDirectoryFile(&attr, testdirA, NULL, FALSE, FALSE);
     test_flags_NtQueryDirectoryFile(&attr, testdirA, NULL, TRUE, TRUE);
     test_flags_NtQueryDirectoryFile(&attr, testdirA, NULL, TRUE, FALSE);
+    test_names_NtQueryDirectoryFile(&attr, testdirA);
 
     for (i = 0; testfiles[i].name; i++)
     {
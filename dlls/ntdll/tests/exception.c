@@ -1594,8 +1594,10 @@ static void test_dynamic_unwind(void)
 {
     static const int code_offset = 1024;
     char buf[sizeof(RUNTIME_FUNCTION) + 4];
-    RUNTIME_FUNCTION *runtime_func, *func;
+    RUNTIME_FUNCTION *runtime_func, *func, funcs[4];
+    UNWIND_HISTORY_TABLE history;
     ULONG_PTR table, base;
+    unsigned int i;
     DWORD count;
 
     /* Test RtlAddFunctionTable with aligned RUNTIME_FUNCTION pointer */
@@ -1692,6 +1694,34 @@ static void test_dynamic_unwind(void)
     ok( !pRtlDeleteFunctionTable( (PRUNTIME_FUNCTION)table ),
         "RtlDeleteFunctionTable returned success for nonexistent table = %p\n", (PVOID)table );
 
+    /* Several tables registered in descending address order */
+    for (i = 0; i < sizeof(funcs)/sizeof(funcs[0]); i++)
+    {
+        funcs[i].BeginAddress = 0;
+        funcs[i].EndAddress   = 16;
+        funcs[i].UnwindData   = 0;
+        ok( pRtlAddFunctionTable( &funcs[i], 1, (ULONG_PTR)code_mem + (3 - i) * 64 ),
+            "RtlAddFunctionTable failed for funcs[%u]\n", i );
+    }
+
+    memset( &history, 0, sizeof(history) );
+    for (i = 0; i < 2 * sizeof(funcs)/sizeof(funcs[0]); i++)
+    {
+        unsigned int idx = i % (sizeof(funcs)/sizeof(funcs[0]));
+
+        base = 0xdeadbeef;
+        func = pRtlLookupFunctionEntry( (ULONG_PTR)code_mem + (3 - idx) * 64 + 8, &base, &history );
+        ok( func == &funcs[idx], "%u: expected %p, got %p\n", i, &funcs[idx], func );
+        ok( base == (ULONG_PTR)code_mem + (3 - idx) * 64,
+            "%u: returned invalid base %lx\n", i, base );
+
+        base = 0xdeadbeef;
+        func = pRtlLookupFunctionEntry( (ULONG_PTR)code_mem + (3 - idx) * 64 + 24, &base, &history );
+        ok( func == NULL, "%u: expected NULL, got %p\n", i, func );
+    }
+
+    for (i = 0; i < sizeof(funcs)/sizeof(funcs[0]); i++)
+        ok( pRtlDeleteFunctionTable( &funcs[i] ), "RtlDeleteFunctionTable failed for funcs[%u]\n", i );
 }
 
 #endif  /* __x86_64__ */
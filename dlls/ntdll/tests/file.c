@@ -168,6 +168,113 @@ static void WINAPI apc( void *arg, IO_STATUS_BLOCK *iosb, ULONG reserved )
     ok( !reserved, "reserved is not 0: %x\n", reserved );
 }
 
+/* overlapped I/O at an explicit offset that is waited for through an event;
+ * on Wine this goes through io_uring when it is available */
+static void test_async_event_io(void)
+{
+    static const char data[] = "hello world";
+    FILE_COMPLETION_INFORMATION fci;
+    IO_STATUS_BLOCK iosb;
+    LARGE_INTEGER offset;
+    HANDLE handle, event, port;
+    NTSTATUS status;
+    char buffer[64];
+    DWORD ret;
+
+    if (!(handle = create_temp_file( FILE_FLAG_OVERLAPPED ))) return;
+    event = CreateEventA( NULL, TRUE, FALSE, NULL );
+
+    ResetEvent( event );
+    U(iosb).Status = 0xdeadbabe;
+    iosb.Information = 0xdeadbeef;
+    offset.QuadPart = 0;
+    status = pNtWriteFile( handle, event, NULL, NULL, &iosb, data, sizeof(data), &offset, NULL );
+    ok( status == STATUS_PENDING || status == STATUS_SUCCESS, "wrong status %x\n", status );
+    ret = WaitForSingleObject( event, 1000 );
+    ok( ret == WAIT_OBJECT_0, "wait failed %u\n", ret );
+    ok( U(iosb).Status == STATUS_SUCCESS, "wrong status %x\n", U(iosb).Status );
+    ok( iosb.Information == sizeof(data), "wrong info %lu\n", iosb.Information );
+
+    ResetEvent( event );
+    U(iosb).Status = 0xdeadbabe;
+    iosb.Information = 0xdeadbeef;
+    memset( buffer, 0xcc, sizeof(buffer) );
+    offset.QuadPart = 6;
+    status = pNtReadFile( handle, event, NULL, NULL, &iosb, buffer, sizeof(buffer), &offset, NULL );
+    ok( status == STATUS_PENDING || status == STATUS_SUCCESS, "wrong status %x\n", status );
+    ret = WaitForSingleObject( event, 1000 );
+    ok( ret == WAIT_OBJECT_0, "wait failed %u\n", ret );
+    ok( U(iosb).Status == STATUS_SUCCESS, "wrong status %x\n", U(iosb).Status );
+    ok( iosb.Information == sizeof(data) - 6, "wrong info %lu\n", iosb.Information );
+    ok( !memcmp( buffer, data + 6, sizeof(data) - 6 ), "wrong data %s\n", buffer );
+
+    /* read past the end of the file */
+    ResetEvent( event );
+    U(iosb).Status = 0xdeadbabe;
+    iosb.Information = 0xdeadbeef;
+    offset.QuadPart = 1000;
+    status = pNtReadFile( handle, event, NULL, NULL, &iosb, buffer, sizeof(buffer), &offset, NULL );
+    ok( status == STATUS_PENDING || status == STATUS_END_OF_FILE, "wrong status %x\n", status );
+    if (status == STATUS_PENDING)
+    {
+        ret = WaitForSingleObject( event, 1000 );
+        ok( ret == WAIT_OBJECT_0, "wait failed %u\n", ret );
+        ok( U(iosb).Status == STATUS_END_OF_FILE, "wrong status %x\n", U(iosb).Status );
+        ok( iosb.Information == 0, "wrong info %lu\n", iosb.Information );
+    }
+
+    /* completion port notification */
+    status = pNtCreateIoCompletion( &port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( !status, "NtCreateIoCompletion failed %x\n", status );
+    fci.CompletionPort = port;
+    fci.CompletionKey = CKEY_FIRST;
+    status = pNtSetInformationFile( handle, &iosb, &fci, sizeof(fci), FileCompletionInformation );
+    ok( !status, "NtSetInformationFile failed %x\n", status );
+
+    ResetEvent( event );
+    U(iosb).Status = 0xdeadbabe;
+    iosb.Information = 0xdeadbeef;
+    offset.QuadPart = 0;
+    status = pNtReadFile( handle, event, NULL, (void *)CVALUE_FIRST, &iosb, buffer, 5, &offset, NULL );
+    ok( status == STATUS_PENDING || status == STATUS_SUCCESS, "wrong status %x\n", status );
+    ret = WaitForSingleObject( event, 1000 );
+    ok( ret == WAIT_OBJECT_0, "wait failed %u\n", ret );
+    ok( U(iosb).Status == STATUS_SUCCESS, "wrong status %x\n", U(iosb).Status );
+    ok( iosb.Information == 5, "wrong info %lu\n", iosb.Information );
+    ok( !memcmp( buffer, data, 5 ), "wrong data %s\n", buffer );
+    if (get_msg( port ))
+    {
+        ok( completionKey == CKEY_FIRST, "wrong key %lx\n", completionKey );
+        ok( completionValue == CVALUE_FIRST, "wrong value %lx\n", completionValue );
+        ok( U(ioSb).Status == STATUS_SUCCESS, "wrong status %x\n", U(ioSb).Status );
+        ok( ioSb.Information == 5, "wrong info %lu\n", ioSb.Information );
+    }
+
+    CloseHandle( handle );
+    CloseHandle( port );
+    CloseHandle( event );
+}
+
+/* run test_async_event_io again in a child process that doesn't use io_uring */
+static void test_async_event_io_sync_fallback(void)
+{
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    char cmdline[MAX_PATH], **argv;
+    BOOL ret;
+
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" file async_event_io", argv[0] );
+    SetEnvironmentVariableA( "WINEIOURING", "0" );
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+    SetEnvironmentVariableA( "WINEIOURING", NULL );
+    ok( ret, "CreateProcess failed %u\n", GetLastError() );
+    if (!ret) return;
+    winetest_wait_child_process( pi.hProcess );
+    CloseHandle( pi.hProcess );
+    CloseHandle( pi.hThread );
+}
+
 static void create_file_test(void)
 {
     static const WCHAR systemrootW[] = {'\\','S','y','s','t','e','m','R','o','o','t',
@@ -4194,6 +4301,7 @@ static void test_read_write(void)
 
 START_TEST(file)
 {
+    char **argv;
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
     if (!hntdll)
@@ -4229,12 +4337,20 @@ START_TEST(file)
     pNtQueryVolumeInformationFile = (void *)GetProcAddress(hntdll, "NtQueryVolumeInformationFile");
     pNtQueryFullAttributesFile = (void *)GetProcAddress(hntdll, "NtQueryFullAttributesFile");
 
+    if (winetest_get_mainargs( &argv ) >= 3 && !strcmp( argv[2], "async_event_io" ))
+    {
+        test_async_event_io();
+        return;
+    }
+
     test_read_write();
     test_NtCreateFile();
     create_file_test();
     open_file_test();
     delete_file_test();
     read_file_test();
+    test_async_event_io();
+    test_async_event_io_sync_fallback();
     append_file_test();
     nt_mailslot_test();
     test_iocompletion();
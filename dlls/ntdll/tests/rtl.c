@@ -98,6 +98,7 @@ static NTSTATUS  (WINAPI *pRtlDecompressFragment)(USHORT, PUCHAR, ULONG, const U
 static NTSTATUS  (WINAPI *pRtlCompressBuffer)(USHORT, const UCHAR*, ULONG, PUCHAR, ULONG, ULONG, PULONG, PVOID);
 static BOOL      (WINAPI *pRtlIsCriticalSectionLocked)(RTL_CRITICAL_SECTION *);
 static BOOL      (WINAPI *pRtlIsCriticalSectionLockedByThread)(RTL_CRITICAL_SECTION *);
+static NTSTATUS  (WINAPI *pRtlInitializeCriticalSectionEx)(RTL_CRITICAL_SECTION *, ULONG, ULONG);
 
 static HMODULE hkernel32 = 0;
 static BOOL      (WINAPI *pIsWow64Process)(HANDLE, PBOOL);
@@ -151,6 +152,7 @@ static void InitFunctionPtrs(void)
         pRtlCompressBuffer = (void *)GetProcAddress(hntdll, "RtlCompressBuffer");
         pRtlIsCriticalSectionLocked = (void *)GetProcAddress(hntdll, "RtlIsCriticalSectionLocked");
         pRtlIsCriticalSectionLockedByThread = (void *)GetProcAddress(hntdll, "RtlIsCriticalSectionLockedByThread");
+        pRtlInitializeCriticalSectionEx = (void *)GetProcAddress(hntdll, "RtlInitializeCriticalSectionEx");
     }
     hkernel32 = LoadLibraryA("kernel32.dll");
     ok(hkernel32 != 0, "LoadLibrary failed\n");
@@ -2056,6 +2058,78 @@ static void test_RtlIsCriticalSectionLocked(void)
     DeleteCriticalSection(&info.crit);
 }
 
+struct critsect_spin_info
+{
+    RTL_CRITICAL_SECTION crit;
+    HANDLE start;
+    LONG count;
+};
+
+static DWORD WINAPI critsect_spin_thread(void *param)
+{
+    struct critsect_spin_info *info = param;
+    int i;
+
+    WaitForSingleObject(info->start, INFINITE);
+    for (i = 0; i < 100000; i++)
+    {
+        RtlEnterCriticalSection(&info->crit);
+        info->count++;
+        RtlLeaveCriticalSection(&info->crit);
+    }
+    return 0;
+}
+
+static void test_RtlInitializeCriticalSectionEx_dynamic_spin(void)
+{
+    struct critsect_spin_info info;
+    HANDLE threads[4];
+    NTSTATUS status;
+    BOOL ret;
+    int i;
+
+    if (!pRtlInitializeCriticalSectionEx)
+    {
+        win_skip("RtlInitializeCriticalSectionEx is not available\n");
+        return;
+    }
+
+    status = pRtlInitializeCriticalSectionEx(&info.crit, 0, RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN);
+    ok(!status, "RtlInitializeCriticalSectionEx failed with %08x\n", status);
+    ok(info.crit.LockCount == -1, "expected LockCount -1, got %d\n", info.crit.LockCount);
+    ok(info.crit.RecursionCount == 0, "expected RecursionCount 0, got %d\n", info.crit.RecursionCount);
+    ok(info.crit.OwningThread == 0, "expected no owner, got %p\n", info.crit.OwningThread);
+
+    RtlEnterCriticalSection(&info.crit);
+    ret = RtlTryEnterCriticalSection(&info.crit);
+    ok(ret, "RtlTryEnterCriticalSection failed on a recursive enter\n");
+    ok(info.crit.RecursionCount == 2, "expected RecursionCount 2, got %d\n", info.crit.RecursionCount);
+    RtlLeaveCriticalSection(&info.crit);
+    RtlLeaveCriticalSection(&info.crit);
+    ok(info.crit.LockCount == -1, "expected LockCount -1, got %d\n", info.crit.LockCount);
+
+    info.start = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(info.start != NULL, "CreateEvent failed with %u\n", GetLastError());
+    info.count = 0;
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+    {
+        threads[i] = CreateThread(NULL, 0, critsect_spin_thread, &info, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed with %u\n", GetLastError());
+    }
+    SetEvent(info.start);
+    status = WaitForMultipleObjects(sizeof(threads) / sizeof(threads[0]), threads, TRUE, 30000);
+    ok(status == WAIT_OBJECT_0, "expected WAIT_OBJECT_0, got %u\n", status);
+
+    ok(info.count == 400000, "expected count 400000, got %d\n", info.count);
+    ok(info.crit.LockCount == -1, "expected LockCount -1, got %d\n", info.crit.LockCount);
+    ok(info.crit.RecursionCount == 0, "expected RecursionCount 0, got %d\n", info.crit.RecursionCount);
+    ok(info.crit.OwningThread == 0, "expected no owner, got %p\n", info.crit.OwningThread);
+
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) CloseHandle(threads[i]);
+    CloseHandle(info.start);
+    RtlDeleteCriticalSection(&info.crit);
+}
+
 START_TEST(rtl)
 {
     InitFunctionPtrs();
@@ -2086,4 +2160,5 @@ START_TEST(rtl)
     test_RtlGetCompressionWorkSpaceSize();
     test_RtlDecompressBuffer();
     test_RtlIsCriticalSectionLocked();
+    test_RtlInitializeCriticalSectionEx_dynamic_spin();
 }
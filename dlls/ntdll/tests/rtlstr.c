@@ -1975,6 +1975,54 @@ static void test_RtlHashUnicodeString(void)
     }
 }
 
+static void test_RtlCompareUnicodeString(void)
+{
+    WCHAR buf1[100], buf2[100];
+    UNICODE_STRING str1, str2;
+    LONG ret;
+    int i;
+
+    for (i = 0; i < 99; i++)
+    {
+        buf1[i] = 'a' + i % 26;
+        buf2[i] = 'A' + i % 26;
+    }
+    buf1[99] = buf2[99] = 0;
+    RtlInitUnicodeString( &str1, buf1 );
+    RtlInitUnicodeString( &str2, buf2 );
+
+    ret = RtlCompareUnicodeString( &str1, &str2, TRUE );
+    ok( !ret, "got %d\n", ret );
+    ret = RtlCompareUnicodeString( &str1, &str2, FALSE );
+    ok( ret > 0, "got %d\n", ret );
+    ok( RtlEqualUnicodeString( &str1, &str2, TRUE ), "strings differ\n" );
+
+    /* non-letters that only differ by the case bit */
+    buf1[40] = '@';
+    buf2[40] = '`';
+    ret = RtlCompareUnicodeString( &str1, &str2, TRUE );
+    ok( ret < 0, "got %d\n", ret );
+    buf2[40] = '@';
+
+    /* non-ASCII characters */
+    buf1[70] = 0xe9;
+    buf2[70] = 0xc9;
+    ret = RtlCompareUnicodeString( &str1, &str2, TRUE );
+    ok( !ret, "got %d\n", ret );
+    buf2[70] = 0xea;
+    ret = RtlCompareUnicodeString( &str1, &str2, TRUE );
+    ok( ret < 0, "got %d\n", ret );
+    buf2[70] = 0xc9;
+
+    /* the difference past the last full block */
+    buf1[98] = 'z';
+    ret = RtlCompareUnicodeString( &str1, &str2, TRUE );
+    ok( ret > 0, "got %d\n", ret );
+    str1.Length -= sizeof(WCHAR);
+    ret = RtlCompareUnicodeString( &str1, &str2, TRUE );
+    ok( ret < 0, "got %d\n", ret );
+}
+
 struct unicode_to_utf8_test {
     WCHAR unicode[128];
     const char *expected;
@@ -2529,6 +2577,7 @@ START_TEST(rtlstr)
 	test_RtlDowncaseUnicodeString();
     }
     test_RtlHashUnicodeString();
+    test_RtlCompareUnicodeString();
     test_RtlUnicodeToUTF8N();
     test_RtlUTF8ToUnicodeN();
 }
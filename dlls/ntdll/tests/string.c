@@ -56,6 +56,7 @@ static LPWSTR   (__cdecl *p_wcsupr)(LPWSTR);
 
 static LPWSTR   (WINAPIV *p_wcschr)(LPCWSTR, WCHAR);
 static LPWSTR   (WINAPIV *p_wcsrchr)(LPCWSTR, WCHAR);
+static size_t   (WINAPIV *p_wcslen)(LPCWSTR);
 
 static void     (__cdecl *p_qsort)(void *,size_t,size_t, int(__cdecl *compar)(const void *, const void *) );
 static void*    (__cdecl *p_bsearch)(void *,void*,size_t,size_t, int(__cdecl *compar)(const void *, const void *) );
@@ -95,6 +96,7 @@ static void InitFunctionPtrs(void)
 
 	p_wcschr= (void *)GetProcAddress(hntdll, "wcschr");
 	p_wcsrchr= (void *)GetProcAddress(hntdll, "wcsrchr");
+	p_wcslen= (void *)GetProcAddress(hntdll, "wcslen");
 	p_qsort= (void *)GetProcAddress(hntdll, "qsort");
 	p_bsearch= (void *)GetProcAddress(hntdll, "bsearch");
 
@@ -1134,6 +1136,34 @@ static void test_wcschr(void)
        "wcschr should have returned NULL\n");
 }
 
+static void test_wcslen(void)
+{
+    WCHAR buffer[80];
+    int i, j;
+
+    /* all string offsets and lengths around the block boundaries */
+    for (i = 0; i < 16; i++)
+    {
+        for (j = 0; i + j < 79; j++)
+        {
+            memset(buffer, 0x11, sizeof(buffer));
+            buffer[i + j] = 0;
+            ok(p_wcslen(buffer + i) == j, "%d/%d: wrong length %u\n", i, j, (DWORD)p_wcslen(buffer + i));
+            ok(p_wcschr(buffer + i, 0x1111) == (j ? buffer + i : NULL),
+               "%d/%d: wrong result %p\n", i, j, p_wcschr(buffer + i, 0x1111));
+            ok(p_wcschr(buffer + i, 0) == buffer + i + j,
+               "%d/%d: wrong result %p\n", i, j, p_wcschr(buffer + i, 0));
+            if (j)
+            {
+                buffer[i + j - 1] = 'x';
+                ok(p_wcschr(buffer + i, 'x') == buffer + i + j - 1,
+                   "%d/%d: wrong result %p\n", i, j, p_wcschr(buffer + i, 'x'));
+            }
+            ok(p_wcschr(buffer + i, 'y') == NULL, "%d/%d: wrong result %p\n", i, j, p_wcschr(buffer + i, 'y'));
+        }
+    }
+}
+
 static void test_wcsrchr(void)
 {
     static const WCHAR teststringW[] = {'a','b','r','a','c','a','d','a','b','r','a',0};
@@ -1328,6 +1358,8 @@ START_TEST(string)
         test_wcschr();
     if (p_wcsrchr)
         test_wcsrchr();
+    if (p_wcslen && p_wcschr)
+        test_wcslen();
     if (p_wcslwr && p_wcsupr)
         test_wcslwrupr();
     if (patoi)
@@ -202,6 +202,45 @@ static ULONG64 get_dyld_image_info_addr(void)
 }
 #endif  /* __APPLE__ */
 
+/***********************************************************************
+ *           shared_data_thread
+ *
+ * Keeps the time values in user_shared_data current. This is a plain
+ * pthread with all signals blocked, it never runs any Win32 code.
+ */
+static void *shared_data_thread( void *arg )
+{
+    /* 64 updates per second, like the default Windows clock interrupt */
+    struct timespec interval = { 0, 15625000 };
+
+    for (;;)
+    {
+        nanosleep( &interval, NULL );
+        update_user_shared_data_time();
+    }
+    return NULL;
+}
+
+/***********************************************************************
+ *           start_shared_data_thread
+ */
+static void start_shared_data_thread(void)
+{
+    pthread_attr_t attr;
+    pthread_t pthread_id;
+    sigset_t sigset, block_set;
+
+    sigfillset( &block_set );
+    pthread_sigmask( SIG_BLOCK, &block_set, &sigset );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    pthread_attr_setstacksize( &attr, 0x10000 );
+    if (pthread_create( &pthread_id, &attr, shared_data_thread, NULL ))
+        WARN( "failed to start the shared data thread, time values will not be updated\n" );
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &sigset, NULL );
+}
+
 /***********************************************************************
  *           thread_init
  *
@@ -215,7 +254,6 @@ HANDLE thread_init(void)
     void *addr;
     SIZE_T size, info_size;
     HANDLE exe_file = 0;
-    LARGE_INTEGER now;
     NTSTATUS status;
     struct ntdll_thread_data *thread_data;
     static struct debug_info debug_info;  /* debug info for initial thread */
@@ -337,16 +375,12 @@ HANDLE thread_init(void)
             wine_server_fd_to_handle( 2, GENERIC_WRITE|SYNCHRONIZE, OBJ_INHERIT, &params.hStdError );
     }
 
+    fill_cpu_info();
+
     /* initialize time values in user_shared_data */
-    NtQuerySystemTime( &now );
-    user_shared_data->SystemTime.LowPart = now.u.LowPart;
-    user_shared_data->SystemTime.High1Time = user_shared_data->SystemTime.High2Time = now.u.HighPart;
-    user_shared_data->u.TickCountQuad = (now.QuadPart - server_start_time) / 10000;
-    user_shared_data->u.TickCount.High2Time = user_shared_data->u.TickCount.High1Time;
-    user_shared_data->TickCountLowDeprecated = user_shared_data->u.TickCount.LowPart;
     user_shared_data->TickCountMultiplier = 1 << 24;
-
-    fill_cpu_info();
+    update_user_shared_data_time();
+    start_shared_data_thread();
 
     NtCreateKeyedEvent( &keyed_event, GENERIC_READ | GENERIC_WRITE, NULL, 0 );
 
@@ -362,6 +396,7 @@ void terminate_thread( int status )
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
     if (interlocked_xchg_add( &nb_threads, -1 ) <= 1) _exit( status );
 
+    debug_exit_thread( TRUE );
     close( ntdll_get_thread_data()->wait_fd[0] );
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
@@ -411,6 +446,7 @@ void exit_thread( int status )
         }
     }
 
+    debug_exit_thread( FALSE );
     close( ntdll_get_thread_data()->wait_fd[0] );
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
@@ -434,6 +470,8 @@ static void start_thread( struct startup_info *info )
 
     debug_info.str_pos = debug_info.strings;
     debug_info.out_pos = debug_info.output;
+    debug_info.trace   = NULL;
+    debug_info.relay_stack = NULL;
     thread_data->debug_info = &debug_info;
     thread_data->pthread_id = pthread_self();
 
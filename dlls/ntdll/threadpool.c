@@ -84,6 +84,23 @@ struct wait_work_item
     BOOLEAN CallbackInProgress;
 };
 
+/* binary min-heap of timers, shared by the timer queue and threadpool timers */
+#define TIMER_HEAP_NONE    (~0u)
+
+struct timer_heap_entry
+{
+    ULONGLONG expire;           /* earliest expiration time */
+    ULONGLONG window;           /* tolerated delay after the expiration time */
+    unsigned int index;         /* position in the heap, TIMER_HEAP_NONE if not queued */
+};
+
+struct timer_heap
+{
+    struct timer_heap_entry **entries;
+    unsigned int count;
+    unsigned int size;
+};
+
 struct timer_queue;
 struct queue_timer
 {
@@ -94,7 +111,7 @@ struct queue_timer
     PVOID param;
     DWORD period;
     ULONG flags;
-    ULONGLONG expire;
+    struct timer_heap_entry heap_entry; /* expire is EXPIRE_NEVER when not queued */
     BOOL destroy;               /* timer should be deleted; once set, never unset */
     HANDLE event;               /* removal event */
 };
@@ -103,7 +120,8 @@ struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* all timers of the queue */
+    struct timer_heap heap;     /* queued timers, by expiration time */
     BOOL quit;                  /* queue should be deleted; once set, never unset */
     HANDLE event;
     HANDLE thread;
@@ -114,6 +132,7 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_INJECT_DELAY   20
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
 /* internal threadpool representation */
@@ -131,6 +150,12 @@ struct threadpool
     int                     min_workers;
     int                     num_workers;
     int                     num_busy_workers;
+    BOOL                    injecting;
+    /* statistics, locked via .cs */
+    int                     queue_depth;
+    int                     max_queue_depth;
+    ULONGLONG               num_callbacks;
+    ULONGLONG               total_wait_time;
 };
 
 enum threadpool_objtype
@@ -165,6 +190,7 @@ struct threadpool_object
     LONG                    num_pending_callbacks;
     LONG                    num_running_callbacks;
     LONG                    num_associated_callbacks;
+    ULONGLONG               queue_time;
     /* arguments for callback */
     union
     {
@@ -182,9 +208,8 @@ struct threadpool_object
             /* information about the timer, locked via timerqueue.cs */
             BOOL            timer_initialized;
             BOOL            timer_pending;
-            struct list     timer_entry;
+            struct timer_heap_entry timer_entry;
             BOOL            timer_set;
-            ULONGLONG       timeout;
             LONG            period;
             LONG            window_length;
         } timer;
@@ -238,7 +263,7 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    objcount;
     BOOL                    thread_running;
-    struct list             pending_timers;
+    struct timer_heap       pending_timers;
     RTL_CONDITION_VARIABLE  update_event;
 }
 timerqueue =
@@ -246,7 +271,7 @@ timerqueue =
     { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
     0,                                          /* objcount */
     FALSE,                                      /* thread_running */
-    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
+    { NULL, 0, 0 },                             /* pending_timers */
     RTL_CONDITION_VARIABLE_INIT                 /* update_event */
 };
 
@@ -326,6 +351,7 @@ static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CAL
 }
 
 static void CALLBACK threadpool_worker_proc( void *param );
+static void CALLBACK threadpool_injector_proc( void *param );
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled );
 static void tp_object_shutdown( struct threadpool_object *object );
 static BOOL tp_object_release( struct threadpool_object *object );
@@ -691,6 +717,152 @@ NTSTATUS WINAPI RtlDeregisterWait(HANDLE WaitHandle)
 }
 
 
+/************************** Timer Heap Impl **************************/
+
+/* Makes sure that the heap can hold at least count entries, so that
+ * inserting a timer later on cannot fail. */
+static BOOL timer_heap_reserve(struct timer_heap *heap, unsigned int count)
+{
+    struct timer_heap_entry **entries;
+    unsigned int size;
+
+    if (count <= heap->size)
+        return TRUE;
+
+    size = max(max(16, heap->size * 2), count);
+    if (heap->entries)
+        entries = RtlReAllocateHeap(GetProcessHeap(), 0, heap->entries, size * sizeof(*entries));
+    else
+        entries = RtlAllocateHeap(GetProcessHeap(), 0, size * sizeof(*entries));
+    if (!entries)
+        return FALSE;
+
+    heap->entries = entries;
+    heap->size = size;
+    return TRUE;
+}
+
+static inline void timer_heap_set(struct timer_heap *heap, struct timer_heap_entry *entry,
+                                  unsigned int pos)
+{
+    heap->entries[pos] = entry;
+    entry->index = pos;
+}
+
+static void timer_heap_sift_up(struct timer_heap *heap, struct timer_heap_entry *entry,
+                               unsigned int pos)
+{
+    while (pos)
+    {
+        unsigned int parent = (pos - 1) / 2;
+        if (heap->entries[parent]->expire <= entry->expire)
+            break;
+        timer_heap_set(heap, heap->entries[parent], pos);
+        pos = parent;
+    }
+    timer_heap_set(heap, entry, pos);
+}
+
+static void timer_heap_sift_down(struct timer_heap *heap, struct timer_heap_entry *entry,
+                                 unsigned int pos)
+{
+    for (;;)
+    {
+        unsigned int child = 2 * pos + 1;
+        if (child >= heap->count)
+            break;
+        if (child + 1 < heap->count &&
+            heap->entries[child + 1]->expire < heap->entries[child]->expire)
+            child++;
+        if (entry->expire <= heap->entries[child]->expire)
+            break;
+        timer_heap_set(heap, heap->entries[child], pos);
+        pos = child;
+    }
+    timer_heap_set(heap, entry, pos);
+}
+
+static inline struct timer_heap_entry *timer_heap_head(const struct timer_heap *heap)
+{
+    return heap->count ? heap->entries[0] : NULL;
+}
+
+static void timer_heap_insert(struct timer_heap *heap, struct timer_heap_entry *entry)
+{
+    assert(entry->index == TIMER_HEAP_NONE);
+    assert(heap->count < heap->size);
+    timer_heap_sift_up(heap, entry, heap->count++);
+}
+
+static void timer_heap_remove(struct timer_heap *heap, struct timer_heap_entry *entry)
+{
+    struct timer_heap_entry *last;
+    unsigned int pos = entry->index;
+
+    assert(pos < heap->count && heap->entries[pos] == entry);
+    entry->index = TIMER_HEAP_NONE;
+
+    last = heap->entries[--heap->count];
+    if (last == entry)
+        return;
+
+    if (pos && last->expire < heap->entries[(pos - 1) / 2]->expire)
+        timer_heap_sift_up(heap, last, pos);
+    else
+        timer_heap_sift_down(heap, last, pos);
+}
+
+/* Children never expire earlier than their parent, so only the subtrees
+ * of timers expiring before the current bound need to be visited. */
+static ULONGLONG timer_heap_min_deadline(const struct timer_heap *heap, unsigned int pos,
+                                         ULONGLONG deadline)
+{
+    const struct timer_heap_entry *entry;
+
+    if (pos >= heap->count)
+        return deadline;
+    entry = heap->entries[pos];
+    if (entry->expire >= deadline)
+        return deadline;
+
+    if (entry->expire + entry->window < deadline)
+        deadline = entry->expire + entry->window;
+    deadline = timer_heap_min_deadline(heap, 2 * pos + 1, deadline);
+    return timer_heap_min_deadline(heap, 2 * pos + 2, deadline);
+}
+
+static ULONGLONG timer_heap_max_expire(const struct timer_heap *heap, unsigned int pos,
+                                       ULONGLONG deadline, ULONGLONG latest)
+{
+    const struct timer_heap_entry *entry;
+
+    if (pos >= heap->count)
+        return latest;
+    entry = heap->entries[pos];
+    if (entry->expire > deadline)
+        return latest;
+
+    if (entry->expire > latest)
+        latest = entry->expire;
+    latest = timer_heap_max_expire(heap, 2 * pos + 1, deadline, latest);
+    return timer_heap_max_expire(heap, 2 * pos + 2, deadline, latest);
+}
+
+/* Returns the time the dispatcher should wake up at. The wakeup is delayed
+ * as far as the tolerance windows allow, so that as many timers as possible
+ * expire together, but no timer fires after the end of its window. */
+static ULONGLONG timer_heap_next_wakeup(const struct timer_heap *heap)
+{
+    ULONGLONG deadline;
+
+    if (!heap->count)
+        return EXPIRE_NEVER;
+
+    deadline = timer_heap_min_deadline(heap, 0, EXPIRE_NEVER);
+    return timer_heap_max_expire(heap, 0, deadline, 0);
+}
+
+
 /************************** Timer Queue Impl **************************/
 
 static void queue_remove_timer(struct queue_timer *t)
@@ -703,6 +875,8 @@ static void queue_remove_timer(struct queue_timer *t)
     assert(t->runcount == 0);
     assert(t->destroy);
 
+    if (t->heap_entry.index != TIMER_HEAP_NONE)
+        timer_heap_remove(&q->heap, &t->heap_entry);
     list_remove(&t->entry);
     if (t->event)
         NtSetEvent(t->event, NULL);
@@ -744,26 +918,21 @@ static inline ULONGLONG queue_current_time(void)
 static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
                             BOOL set_event)
 {
-    /* We MUST hold the queue cs while calling this function.  */
+    /* We MUST hold the queue cs while calling this function.  The heap
+       must have room for the timer, see RtlCreateTimer.  */
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
 
     assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
 
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
+    t->heap_entry.expire = time;
+    if (time == EXPIRE_NEVER)
+        return;
 
-    t->expire = time;
+    timer_heap_insert(&q->heap, &t->heap_entry);
 
-    /* If we insert at the head of the list, we need to expire sooner
+    /* If we insert at the head of the heap, we need to expire sooner
        than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
+    if (set_event && timer_heap_head(&q->heap) == &t->heap_entry)
         NtSetEvent(q->event, NULL);
 }
 
@@ -771,25 +940,27 @@ static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
                                     BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
+    if (t->heap_entry.index != TIMER_HEAP_NONE)
+        timer_heap_remove(&t->q->heap, &t->heap_entry);
     queue_add_timer(t, time, set_event);
 }
 
 static void queue_timer_expire(struct timer_queue *q)
 {
+    struct timer_heap_entry *head;
     struct queue_timer *t = NULL;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if ((head = timer_heap_head(&q->heap)))
     {
         ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+        t = CONTAINING_RECORD(head, struct queue_timer, heap_entry);
+        if (!t->destroy && head->expire <= ((now = queue_current_time())))
         {
             ++t->runcount;
             if (t->period)
             {
-                next = t->expire + t->period;
+                next = head->expire + t->period;
                 /* avoid trigger cascade if overloaded / hibernated */
                 if (next < now)
                     next = now + t->period;
@@ -822,20 +993,15 @@ static void queue_timer_expire(struct timer_queue *q)
 
 static ULONG queue_get_timeout(struct timer_queue *q)
 {
-    struct queue_timer *t;
+    struct timer_heap_entry *head;
     ULONG timeout = INFINITE;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if ((head = timer_heap_head(&q->heap)))
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
-
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : t->expire - time;
-        }
+        ULONGLONG time = queue_current_time();
+        assert(!CONTAINING_RECORD(head, struct queue_timer, heap_entry)->destroy);
+        timeout = head->expire < time ? 0 : min(head->expire - time, INFINITE - 1);
     }
     RtlLeaveCriticalSection(&q->cs);
 
@@ -880,6 +1046,7 @@ static void WINAPI timer_queue_thread_proc(LPVOID p)
     NtClose(q->event);
     RtlDeleteCriticalSection(&q->cs);
     q->magic = 0;
+    RtlFreeHeap(GetProcessHeap(), 0, q->heap.entries);
     RtlFreeHeap(GetProcessHeap(), 0, q);
     RtlExitUserThread( 0 );
 }
@@ -895,7 +1062,7 @@ static void queue_destroy_timer(struct queue_timer *t)
         queue_remove_timer(t);
     else
         /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
+           of the heap.  */
         queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
@@ -920,6 +1087,9 @@ NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 
     RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
+    q->heap.entries = NULL;
+    q->heap.count = 0;
+    q->heap.size = 0;
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
     status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -1073,6 +1243,9 @@ NTSTATUS WINAPI RtlCreateTimer(PHANDLE NewTimer, HANDLE TimerQueue,
     t->param = Parameter;
     t->period = Period;
     t->flags = Flags;
+    t->heap_entry.expire = EXPIRE_NEVER;
+    t->heap_entry.window = 0;
+    t->heap_entry.index = TIMER_HEAP_NONE;
     t->destroy = FALSE;
     t->event = NULL;
 
@@ -1080,8 +1253,13 @@ NTSTATUS WINAPI RtlCreateTimer(PHANDLE NewTimer, HANDLE TimerQueue,
     RtlEnterCriticalSection(&q->cs);
     if (q->quit)
         status = STATUS_INVALID_HANDLE;
+    else if (!timer_heap_reserve(&q->heap, q->heap.count + 1))
+        status = STATUS_NO_MEMORY;
     else
+    {
+        list_add_tail(&q->timers, &t->entry);
         queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    }
     RtlLeaveCriticalSection(&q->cs);
 
     if (status == STATUS_SUCCESS)
@@ -1118,7 +1296,7 @@ NTSTATUS WINAPI RtlUpdateTimer(HANDLE TimerQueue, HANDLE Timer,
 
     RtlEnterCriticalSection(&q->cs);
     /* Can't change a timer if it was once-only or destroyed.  */
-    if (t->expire != EXPIRE_NEVER)
+    if (t->heap_entry.expire != EXPIRE_NEVER)
     {
         t->period = Period;
         queue_move_timer(t, queue_current_time() + DueTime, TRUE);
@@ -1191,10 +1369,8 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
  */
 static void CALLBACK timerqueue_thread_proc( void *param )
 {
-    ULONGLONG timeout_lower, timeout_upper, new_timeout;
-    struct threadpool_object *other_timer;
+    struct timer_heap_entry *head;
     LARGE_INTEGER now, timeout;
-    struct list *ptr;
 
     TRACE( "starting timer queue thread\n" );
 
@@ -1204,59 +1380,39 @@ static void CALLBACK timerqueue_thread_proc( void *param )
         NtQuerySystemTime( &now );
 
         /* Check for expired timers. */
-        while ((ptr = list_head( &timerqueue.pending_timers )))
+        while ((head = timer_heap_head( &timerqueue.pending_timers )))
         {
-            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
+            struct threadpool_object *timer = CONTAINING_RECORD( head, struct threadpool_object, u.timer.timer_entry );
             assert( timer->type == TP_OBJECT_TYPE_TIMER );
             assert( timer->u.timer.timer_pending );
-            if (timer->u.timer.timeout > now.QuadPart)
+            if (head->expire > now.QuadPart)
                 break;
 
             /* Queue a new callback in one of the worker threads. */
-            list_remove( &timer->u.timer.timer_entry );
+            timer_heap_remove( &timerqueue.pending_timers, head );
             timer->u.timer.timer_pending = FALSE;
             tp_object_submit( timer, FALSE );
 
             /* Insert the timer back into the queue, except its marked for shutdown. */
             if (timer->u.timer.period && !timer->shutdown)
             {
-                timer->u.timer.timeout += (ULONGLONG)timer->u.timer.period * 10000;
-                if (timer->u.timer.timeout <= now.QuadPart)
-                    timer->u.timer.timeout = now.QuadPart + 1;
+                head->expire += (ULONGLONG)timer->u.timer.period * 10000;
+                if (head->expire <= now.QuadPart)
+                    head->expire = now.QuadPart + 1;
 
-                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                                     struct threadpool_object, u.timer.timer_entry )
-                {
-                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
-                        break;
-                }
-                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
+                timer_heap_insert( &timerqueue.pending_timers, head );
                 timer->u.timer.timer_pending = TRUE;
             }
         }
 
-        timeout_lower = TIMEOUT_INFINITE;
-        timeout_upper = TIMEOUT_INFINITE;
-
-        /* Determine next timeout and use the window length to optimize wakeup times. */
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (other_timer->u.timer.timeout >= timeout_upper)
-                break;
-
-            timeout_lower = other_timer->u.timer.timeout;
-            new_timeout   = timeout_lower + (ULONGLONG)other_timer->u.timer.window_length * 10000;
-            if (new_timeout < timeout_upper)
-                timeout_upper = new_timeout;
-        }
-
-        /* Wait for timer update events or until the next timer expires. */
+        /* Wait for timer update events or until the next timer expires. The
+         * window length is used to group timers into as few wakeups as possible. */
         if (timerqueue.objcount)
         {
-            timeout.QuadPart = timeout_lower;
+            if (timerqueue.pending_timers.count)
+                timeout.QuadPart = timer_heap_next_wakeup( &timerqueue.pending_timers );
+            else
+                timeout.QuadPart = TIMEOUT_INFINITE;
             RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs, &timeout );
             continue;
         }
@@ -1292,14 +1448,20 @@ static NTSTATUS tp_timerqueue_lock( struct threadpool_object *timer )
     timer->u.timer.timer_initialized    = FALSE;
     timer->u.timer.timer_pending        = FALSE;
     timer->u.timer.timer_set            = FALSE;
-    timer->u.timer.timeout              = 0;
+    timer->u.timer.timer_entry.expire   = 0;
+    timer->u.timer.timer_entry.window   = 0;
+    timer->u.timer.timer_entry.index    = TIMER_HEAP_NONE;
     timer->u.timer.period               = 0;
     timer->u.timer.window_length        = 0;
 
     RtlEnterCriticalSection( &timerqueue.cs );
 
+    /* Make sure that setting the timer cannot fail later. */
+    if (!timer_heap_reserve( &timerqueue.pending_timers, timerqueue.objcount + 1 ))
+        status = STATUS_NO_MEMORY;
+
     /* Make sure that the timerqueue thread is running. */
-    if (!timerqueue.thread_running)
+    if (status == STATUS_SUCCESS && !timerqueue.thread_running)
     {
         HANDLE thread;
         status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
@@ -1336,14 +1498,14 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
         /* If timer was pending, remove it. */
         if (timer->u.timer.timer_pending)
         {
-            list_remove( &timer->u.timer.timer_entry );
+            timer_heap_remove( &timerqueue.pending_timers, &timer->u.timer.timer_entry );
             timer->u.timer.timer_pending = FALSE;
         }
 
         /* If the last timer object was destroyed, then wake up the thread. */
         if (!--timerqueue.objcount)
         {
-            assert( list_empty( &timerqueue.pending_timers ) );
+            assert( !timerqueue.pending_timers.count );
             RtlWakeAllConditionVariable( &timerqueue.update_event );
         }
 
@@ -1601,6 +1763,64 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
     RtlLeaveCriticalSection( &waitqueue.cs );
 }
 
+/***********************************************************************
+ *           tp_get_time    (internal)
+ *
+ * Returns a monotonic timestamp in 100ns units, used for the queue statistics.
+ */
+static inline ULONGLONG tp_get_time(void)
+{
+    LARGE_INTEGER now;
+    NtQueryPerformanceCounter( &now, NULL );
+    return now.QuadPart;
+}
+
+/***********************************************************************
+ *           tp_threadpool_new_worker    (internal)
+ *
+ * Starts a new worker thread. The pool lock must be held.
+ */
+static NTSTATUS tp_threadpool_new_worker( struct threadpool *pool )
+{
+    HANDLE thread;
+    NTSTATUS status;
+
+    status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                  threadpool_worker_proc, pool, &thread, NULL );
+    if (status == STATUS_SUCCESS)
+    {
+        interlocked_inc( &pool->refcount );
+        pool->num_workers++;
+        pool->num_busy_workers++;
+        NtClose( thread );
+    }
+    return status;
+}
+
+/***********************************************************************
+ *           tp_threadpool_new_injector    (internal)
+ *
+ * Starts a thread which turns into an additional worker when the queued
+ * work is still not picked up after THREADPOOL_INJECT_DELAY ms. Only one
+ * such thread exists per pool at a time, it starts the next one when it
+ * turns into a worker. The pool lock must be held.
+ */
+static void tp_threadpool_new_injector( struct threadpool *pool )
+{
+    HANDLE thread;
+
+    if (pool->injecting)
+        return;
+
+    if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                             threadpool_injector_proc, pool, &thread, NULL ) == STATUS_SUCCESS)
+    {
+        interlocked_inc( &pool->refcount );
+        pool->injecting = TRUE;
+        NtClose( thread );
+    }
+}
+
 /***********************************************************************
  *           tp_threadpool_alloc    (internal)
  *
@@ -1628,6 +1848,12 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     pool->min_workers           = 0;
     pool->num_workers           = 0;
     pool->num_busy_workers      = 0;
+    pool->injecting             = FALSE;
+
+    pool->queue_depth           = 0;
+    pool->max_queue_depth       = 0;
+    pool->num_callbacks         = 0;
+    pool->total_wait_time       = 0;
 
     TRACE( "allocated threadpool %p\n", pool );
 
@@ -1650,6 +1876,18 @@ static void tp_threadpool_shutdown( struct threadpool *pool )
     RtlWakeAllConditionVariable( &pool->update_event );
 }
 
+/***********************************************************************
+ *           tp_threadpool_dump_stats    (internal)
+ *
+ * Prints the statistics gathered for a threadpool.
+ */
+static void tp_threadpool_dump_stats( struct threadpool *pool )
+{
+    TRACE( "%p: %s callbacks, max queue depth %d, average queue wait %s us\n", pool,
+           wine_dbgstr_longlong( pool->num_callbacks ), pool->max_queue_depth,
+           wine_dbgstr_longlong( pool->num_callbacks ? pool->total_wait_time / pool->num_callbacks / 10 : 0 ) );
+}
+
 /***********************************************************************
  *           tp_threadpool_release    (internal)
  *
@@ -1661,6 +1899,7 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
         return FALSE;
 
     TRACE( "destroying threadpool %p\n", pool );
+    tp_threadpool_dump_stats( pool );
 
     assert( pool->shutdown );
     assert( !pool->objcount );
@@ -1673,6 +1912,18 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
     return TRUE;
 }
 
+/***********************************************************************
+ *           threadpool_dump_stats
+ *
+ * Prints the statistics of the default threadpool, which is never destroyed.
+ * Called at process exit; the other threads are gone already, and one of them
+ * may have been killed while holding the pool lock, so don't take it.
+ */
+void threadpool_dump_stats(void)
+{
+    if (default_threadpool) tp_threadpool_dump_stats( default_threadpool );
+}
+
 /***********************************************************************
  *           tp_threadpool_lock    (internal)
  *
@@ -1710,18 +1961,7 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
 
     /* Make sure that the threadpool has at least one thread. */
     if (!pool->num_workers)
-    {
-        HANDLE thread;
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      threadpool_worker_proc, pool, &thread, NULL );
-        if (status == STATUS_SUCCESS)
-        {
-            interlocked_inc( &pool->refcount );
-            pool->num_workers++;
-            pool->num_busy_workers++;
-            NtClose( thread );
-        }
-    }
+        status = tp_threadpool_new_worker( pool );
 
     /* Keep a reference, and increment objcount to ensure that the
      * last thread doesn't terminate. */
@@ -1840,6 +2080,7 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     RtlInitializeConditionVariable( &object->finished_event );
     RtlInitializeConditionVariable( &object->group_finished_event );
     object->num_pending_callbacks   = 0;
+    object->queue_time              = 0;
     object->num_running_callbacks   = 0;
     object->num_associated_callbacks = 0;
 
@@ -1907,26 +2148,30 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
 
     RtlEnterCriticalSection( &pool->cs );
 
-    /* Start new worker threads if required. */
+    /* Start new worker threads if required. Up to one thread per CPU is
+     * started immediately, as well as for callbacks which may run long.
+     * Beyond that, threads are only injected when the queued work isn't
+     * picked up in time, to avoid creating a thread for every item of a
+     * burst of short callbacks. */
     if (pool->num_busy_workers >= pool->num_workers &&
         pool->num_workers < pool->max_workers)
     {
-        HANDLE thread;
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      threadpool_worker_proc, pool, &thread, NULL );
-        if (status == STATUS_SUCCESS)
-        {
-            interlocked_inc( &pool->refcount );
-            pool->num_workers++;
-            pool->num_busy_workers++;
-            NtClose( thread );
-        }
+        if (pool->num_workers < max( NtCurrentTeb()->Peb->NumberOfProcessors, 2 ) ||
+            object->may_run_long)
+            status = tp_threadpool_new_worker( pool );
+        else
+            tp_threadpool_new_injector( pool );
     }
 
     /* Queue work item and increment refcount. */
     interlocked_inc( &object->refcount );
     if (!object->num_pending_callbacks++)
+    {
+        object->queue_time = tp_get_time();
         list_add_tail( &pool->pool, &object->pool_entry );
+    }
+    if (++pool->queue_depth > pool->max_queue_depth)
+        pool->max_queue_depth = pool->queue_depth;
 
     /* Count how often the object was signaled. */
     if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
@@ -1958,6 +2203,7 @@ static void tp_object_cancel( struct threadpool_object *object, BOOL group_cance
         pending_callbacks = object->num_pending_callbacks;
         object->num_pending_callbacks = 0;
         list_remove( &object->pool_entry );
+        pool->queue_depth -= pending_callbacks;
 
         if (object->type == TP_OBJECT_TYPE_WAIT)
             object->u.wait.signaled = 0;
@@ -2080,13 +2326,21 @@ static void CALLBACK threadpool_worker_proc( void *param )
         while ((ptr = list_head( &pool->pool )))
         {
             struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+            ULONGLONG now = tp_get_time();
             assert( object->num_pending_callbacks > 0 );
 
+            pool->queue_depth--;
+            pool->num_callbacks++;
+            pool->total_wait_time += now - object->queue_time;
+
             /* If further pending callbacks are queued, move the work item to
              * the end of the pool list. Otherwise remove it from the pool. */
             list_remove( &object->pool_entry );
             if (--object->num_pending_callbacks)
+            {
+                object->queue_time = now;
                 list_add_tail( &pool->pool, &object->pool_entry );
+            }
 
             /* For wait objects check if they were signaled or have timed out. */
             if (object->type == TP_OBJECT_TYPE_WAIT)
@@ -2217,8 +2471,12 @@ static void CALLBACK threadpool_worker_proc( void *param )
          * when no new tasks are available, and the number of threads can be
          * decreased without violating the min_workers limit. An exception is when
          * min_workers == 0, then objcount is used to detect if the last thread
-         * can be terminated. */
-        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+         * can be terminated. Threads injected beyond the number of CPUs retire
+         * sooner. */
+        if (pool->num_workers > NtCurrentTeb()->Peb->NumberOfProcessors)
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT / 5 * -10000;
+        else
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
         if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
             !list_head( &pool->pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
@@ -2234,6 +2492,58 @@ static void CALLBACK threadpool_worker_proc( void *param )
     RtlExitUserThread( 0 );
 }
 
+/***********************************************************************
+ *           threadpool_injector_proc    (internal)
+ */
+static void CALLBACK threadpool_injector_proc( void *param )
+{
+    struct threadpool *pool = param;
+    LARGE_INTEGER timeout;
+    struct list *ptr;
+    BOOL start = FALSE;
+
+    timeout.QuadPart = (ULONGLONG)THREADPOOL_INJECT_DELAY * -10000;
+    for (;;)
+    {
+        NtDelayExecution( FALSE, &timeout );
+
+        RtlEnterCriticalSection( &pool->cs );
+        if (pool->shutdown || pool->num_busy_workers < pool->num_workers ||
+            pool->num_workers >= pool->max_workers || !(ptr = list_head( &pool->pool )))
+            break;
+
+        /* Only become a worker if the oldest queued item has been waiting
+         * for at least the injection delay, otherwise check again later. */
+        if (tp_get_time() - LIST_ENTRY( ptr, struct threadpool_object, pool_entry )->queue_time >=
+            (ULONGLONG)THREADPOOL_INJECT_DELAY * 10000)
+        {
+            pool->num_workers++;
+            pool->num_busy_workers++;
+            start = TRUE;
+            break;
+        }
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+    pool->injecting = FALSE;
+
+    /* Keep watching the queue after injecting a worker. If all workers block
+     * on queued items, only further injected workers can make progress. The
+     * next injector exits by itself once a worker is idle again. */
+    if (start && pool->num_workers < pool->max_workers)
+        tp_threadpool_new_injector( pool );
+    RtlLeaveCriticalSection( &pool->cs );
+
+    /* The pool reference is passed on to the worker. */
+    if (start)
+    {
+        TRACE( "injecting worker thread for pool %p\n", pool );
+        threadpool_worker_proc( pool );
+    }
+
+    tp_threadpool_release( pool );
+    RtlExitUserThread( 0 );
+}
+
 /***********************************************************************
  *           TpAllocCleanupGroup    (NTDLL.@)
  */
@@ -2409,18 +2719,7 @@ NTSTATUS WINAPI TpCallbackMayRunLong( TP_CALLBACK_INSTANCE *instance )
     if (pool->num_busy_workers >= pool->num_workers)
     {
         if (pool->num_workers < pool->max_workers)
-        {
-            HANDLE thread;
-            status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                          threadpool_worker_proc, pool, &thread, NULL );
-            if (status == STATUS_SUCCESS)
-            {
-                interlocked_inc( &pool->refcount );
-                pool->num_workers++;
-                pool->num_busy_workers++;
-                NtClose( thread );
-            }
-        }
+            status = tp_threadpool_new_worker( pool );
         else
         {
             status = STATUS_TOO_MANY_THREADS;
@@ -2697,16 +2996,9 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 
     while (this->num_workers < minimum)
     {
-        HANDLE thread;
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      threadpool_worker_proc, this, &thread, NULL );
+        status = tp_threadpool_new_worker( this );
         if (status != STATUS_SUCCESS)
             break;
-
-        interlocked_inc( &this->refcount );
-        this->num_workers++;
-        this->num_busy_workers++;
-        NtClose( thread );
     }
 
     if (status == STATUS_SUCCESS)
@@ -2725,9 +3017,8 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
 {
     struct threadpool_object *this = impl_from_TP_TIMER( timer );
-    struct threadpool_object *other_timer;
     BOOL submit_timer = FALSE;
-    ULONGLONG timestamp;
+    ULONGLONG timestamp, wakeup;
 
     TRACE( "%p %p %u %u\n", timer, timeout, period, window_length );
 
@@ -2761,31 +3052,27 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
         }
     }
 
+    wakeup = timer_heap_next_wakeup( &timerqueue.pending_timers );
+
     /* First remove existing timeout. */
     if (this->u.timer.timer_pending)
     {
-        list_remove( &this->u.timer.timer_entry );
+        timer_heap_remove( &timerqueue.pending_timers, &this->u.timer.timer_entry );
         this->u.timer.timer_pending = FALSE;
     }
 
     /* If the timer was enabled, then add it back to the queue. */
     if (timeout)
     {
-        this->u.timer.timeout       = timestamp;
-        this->u.timer.period        = period;
-        this->u.timer.window_length = window_length;
+        this->u.timer.timer_entry.expire = timestamp;
+        this->u.timer.timer_entry.window = (ULONGLONG)window_length * 10000;
+        this->u.timer.period             = period;
+        this->u.timer.window_length      = window_length;
 
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (this->u.timer.timeout < other_timer->u.timer.timeout)
-                break;
-        }
-        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
+        timer_heap_insert( &timerqueue.pending_timers, &this->u.timer.timer_entry );
 
         /* Wake up the timer thread when the timeout has to be updated. */
-        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
+        if (timer_heap_next_wakeup( &timerqueue.pending_timers ) < wakeup)
             RtlWakeAllConditionVariable( &timerqueue.update_event );
 
         this->u.timer.timer_pending = TRUE;
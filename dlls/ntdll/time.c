@@ -49,6 +49,7 @@
 #include "wine/unicode.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
+#include "ddk/wdm.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 
@@ -119,6 +120,32 @@ static ULONGLONG monotonic_counter(void)
     return now.tv_sec * (ULONGLONG)TICKSPERSEC + now.tv_usec * 10 + TICKS_1601_TO_1970 - server_start_time;
 }
 
+static inline void set_ksystem_time( volatile KSYSTEM_TIME *time, ULONGLONG value )
+{
+    /* readers retry until High1Time and High2Time match */
+    time->High2Time = value >> 32;
+    time->LowPart   = (ULONG)value;
+    time->High1Time = value >> 32;
+}
+
+/***********************************************************************
+ *           update_user_shared_data_time
+ *
+ * Refreshes the tick count, interrupt time and system time stored in
+ * user_shared_data, for applications which read them directly.
+ */
+void update_user_shared_data_time(void)
+{
+    LARGE_INTEGER now;
+    ULONGLONG counter = monotonic_counter();
+
+    NtQuerySystemTime( &now );
+    set_ksystem_time( &user_shared_data->SystemTime, now.QuadPart );
+    set_ksystem_time( &user_shared_data->InterruptTime, counter );
+    set_ksystem_time( &user_shared_data->TickCount, counter / TICKSPERMSEC );
+    user_shared_data->TickCountLowDeprecated = counter / TICKSPERMSEC;
+}
+
 /******************************************************************************
  *       RtlTimeToTimeFields [NTDLL.@]
  *
@@ -35,6 +35,9 @@
 #ifdef HAVE_SYS_STAT_H
 # include <sys/stat.h>
 #endif
+#ifdef HAVE_DIRENT_H
+# include <dirent.h>
+#endif
 #ifdef HAVE_SYS_MMAN_H
 # include <sys/mman.h>
 #endif
@@ -148,6 +151,7 @@ static void *preload_reserve_start;
 static void *preload_reserve_end;
 static BOOL use_locks;
 static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mmaps */
+static BOOL use_relocation_cache;  /* whether to keep relocated images in the prefix */
 
 
 /***********************************************************************
@@ -1053,6 +1057,310 @@ static NTSTATUS stat_mapping_file( struct file_view *view, struct stat *st )
     return status;
 }
 
+/***********************************************************************
+ *           has_shared_sections
+ *
+ * Check whether an image contains shared writable sections.
+ */
+static BOOL has_shared_sections( const IMAGE_SECTION_HEADER *sec, unsigned int count )
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+        if ((sec[i].Characteristics & IMAGE_SCN_MEM_SHARED) &&
+            (sec[i].Characteristics & IMAGE_SCN_MEM_WRITE)) return TRUE;
+    return FALSE;
+}
+
+
+/* total size of the relocation cache above which the oldest files get removed */
+#define RELOC_CACHE_MAX_SIZE (256 * 1024 * 1024)
+
+static inline unsigned long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/***********************************************************************
+ *           get_relocation_cache_name
+ *
+ * Build the name of the relocation cache file of an image relocated to base.
+ * A NULL base gives the name of the file holding the last base used for the image.
+ */
+static BOOL get_relocation_cache_name( char *buffer, size_t size, const struct stat *st, const void *base )
+{
+    int len = snprintf( buffer, size, "%s/relocs/%lx-%lx-%lx-%lx-%lx", wine_get_config_dir(),
+                        (unsigned long)st->st_dev, (unsigned long)st->st_ino,
+                        (unsigned long)st->st_size, (unsigned long)st->st_mtime, get_mtime_nsec( st ) );
+
+    if (len < 0 || len >= size) return FALSE;
+    if (!base) return TRUE;
+    len += snprintf( buffer + len, size - len, "-%lx", (unsigned long)base );
+    return len < size;
+}
+
+
+/***********************************************************************
+ *           get_relocation_cache_base
+ *
+ * Get the base address of the last relocation of an image.
+ */
+static void *get_relocation_cache_base( const struct stat *st )
+{
+    char name[MAX_PATH + 64], buffer[32];
+    unsigned long base = 0;
+    int fd, len;
+
+    if (!get_relocation_cache_name( name, sizeof(name), st, NULL )) return NULL;
+    if ((fd = open( name, O_RDONLY )) == -1) return NULL;
+    if ((len = read( fd, buffer, sizeof(buffer) - 1 )) > 0)
+    {
+        buffer[len] = 0;
+        base = strtoul( buffer, NULL, 16 );
+    }
+    close( fd );
+    return (void *)base;
+}
+
+
+/***********************************************************************
+ *           check_relocation_cache
+ *
+ * Check that the headers of a relocation cache file match the image file
+ * and that it was relocated to base.
+ */
+static BOOL check_relocation_cache( int fd, int cache_fd, const void *base )
+{
+    IMAGE_DOS_HEADER dos, cache_dos;
+    IMAGE_NT_HEADERS nt, cache_nt;
+
+    if (pread( fd, &dos, sizeof(dos), 0 ) != sizeof(dos) ||
+        pread( cache_fd, &cache_dos, sizeof(cache_dos), 0 ) != sizeof(cache_dos) ||
+        dos.e_lfanew != cache_dos.e_lfanew) return FALSE;
+    if (pread( fd, &nt, sizeof(nt), dos.e_lfanew ) != sizeof(nt) ||
+        pread( cache_fd, &cache_nt, sizeof(cache_nt), dos.e_lfanew ) != sizeof(cache_nt)) return FALSE;
+
+    return (!memcmp( &nt.FileHeader, &cache_nt.FileHeader, sizeof(nt.FileHeader) ) &&
+            nt.OptionalHeader.AddressOfEntryPoint == cache_nt.OptionalHeader.AddressOfEntryPoint &&
+            nt.OptionalHeader.SizeOfImage == cache_nt.OptionalHeader.SizeOfImage &&
+            nt.OptionalHeader.CheckSum == cache_nt.OptionalHeader.CheckSum &&
+            cache_nt.OptionalHeader.ImageBase == (ULONG_PTR)base);
+}
+
+
+/***********************************************************************
+ *           open_relocation_cache
+ *
+ * Open the relocation cache file of the image file fd relocated to base.
+ */
+static int open_relocation_cache( int fd, const struct stat *st, const void *base, SIZE_T size )
+{
+    char name[MAX_PATH + 64];
+    struct stat cache_st;
+    int cache_fd;
+
+    if (!get_relocation_cache_name( name, sizeof(name), st, base )) return -1;
+    if ((cache_fd = open( name, O_RDONLY )) == -1) return -1;
+    if (fstat( cache_fd, &cache_st ) == -1 || cache_st.st_size != size ||
+        !check_relocation_cache( fd, cache_fd, base ))
+    {
+        WARN_(module)( "ignoring invalid relocation cache file %s\n", debugstr_a(name) );
+        close( cache_fd );
+        return -1;
+    }
+    return cache_fd;
+}
+
+
+struct reloc_cache_file
+{
+    time_t mtime;
+    off_t  size;
+    char   name[128];
+};
+
+/* check whether a cache file name belongs to the image version given by prefix */
+static inline BOOL is_reloc_cache_version( const char *name, const char *prefix )
+{
+    size_t len = strlen( prefix );
+    return !strncmp( name, prefix, len ) && (!name[len] || name[len] == '-');
+}
+
+static int compare_reloc_cache_files( const void *p1, const void *p2 )
+{
+    const struct reloc_cache_file *file1 = p1, *file2 = p2;
+
+    if (file1->mtime != file2->mtime) return file1->mtime < file2->mtime ? -1 : 1;
+    return 0;
+}
+
+/***********************************************************************
+ *           trim_relocation_cache
+ *
+ * Remove the cache files of other versions of the image described by st,
+ * then the oldest files while the cache is larger than RELOC_CACHE_MAX_SIZE.
+ */
+static void trim_relocation_cache( const struct stat *st )
+{
+    struct reloc_cache_file *files = NULL, *new_files;
+    unsigned int i, count = 0, alloc = 0;
+    char dir[MAX_PATH], path[MAX_PATH + 128], image[40], version[128];
+    ULONGLONG total = 0;
+    struct dirent *de;
+    struct stat file_st;
+    DIR *d;
+
+    if (snprintf( dir, sizeof(dir), "%s/relocs", wine_get_config_dir() ) >= sizeof(dir)) return;
+    if (!(d = opendir( dir ))) return;
+
+    sprintf( image, "%lx-%lx-", (unsigned long)st->st_dev, (unsigned long)st->st_ino );
+    sprintf( version, "%s%lx-%lx-%lx", image, (unsigned long)st->st_size,
+             (unsigned long)st->st_mtime, get_mtime_nsec( st ) );
+
+    while ((de = readdir( d )))
+    {
+        /* skip . and .. as well as temporary files that are being written */
+        if (strchr( de->d_name, '.' ) || strlen( de->d_name ) >= sizeof(files->name)) continue;
+        if (snprintf( path, sizeof(path), "%s/%s", dir, de->d_name ) >= sizeof(path)) continue;
+
+        if (!strncmp( de->d_name, image, strlen(image) ) && !is_reloc_cache_version( de->d_name, version ))
+        {
+            TRACE_(module)( "removing stale relocation cache file %s\n", debugstr_a(path) );
+            unlink( path );
+            continue;
+        }
+        if (lstat( path, &file_st ) == -1 || !S_ISREG( file_st.st_mode )) continue;
+
+        if (count == alloc)
+        {
+            alloc = max( 64, alloc * 2 );
+            if (files) new_files = RtlReAllocateHeap( GetProcessHeap(), 0, files, alloc * sizeof(*files) );
+            else new_files = RtlAllocateHeap( GetProcessHeap(), 0, alloc * sizeof(*files) );
+            if (!new_files) break;
+            files = new_files;
+        }
+        files[count].mtime = file_st.st_mtime;
+        files[count].size  = file_st.st_size;
+        strcpy( files[count].name, de->d_name );
+        total += file_st.st_size;
+        count++;
+    }
+    closedir( d );
+
+    if (total > RELOC_CACHE_MAX_SIZE)
+    {
+        qsort( files, count, sizeof(*files), compare_reloc_cache_files );
+        for (i = 0; i < count && total > RELOC_CACHE_MAX_SIZE; i++)
+        {
+            if (is_reloc_cache_version( files[i].name, version )) continue;  /* just cached */
+            snprintf( path, sizeof(path), "%s/%s", dir, files[i].name );
+            TRACE_(module)( "evicting relocation cache file %s\n", debugstr_a(path) );
+            if (!unlink( path )) total -= files[i].size;
+        }
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, files );
+}
+
+
+/***********************************************************************
+ *           write_relocation_cache_file
+ *
+ * Atomically replace a relocation cache file.
+ */
+static BOOL write_relocation_cache_file( const char *name, const void *data, SIZE_T size )
+{
+    char tmp[MAX_PATH + 80];
+    const char *ptr = data;
+    int fd, ret;
+
+    if (snprintf( tmp, sizeof(tmp), "%s.%x", name, GetCurrentThreadId() ) >= sizeof(tmp)) return FALSE;
+    if ((fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600 )) == -1) return FALSE;
+
+    /* unreadable pages make write() fail instead of faulting */
+    while (size)
+    {
+        if ((ret = write( fd, ptr, size )) <= 0)
+        {
+            if (ret == -1 && errno == EINTR) continue;
+            break;
+        }
+        ptr += ret;
+        size -= ret;
+    }
+    close( fd );
+
+    if (size || rename( tmp, name ) == -1)
+    {
+        unlink( tmp );
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           virtual_cache_relocated_image
+ *
+ * Store a freshly relocated image in the prefix relocation cache, so that
+ * later mappings at the same address can share the relocated pages.
+ * Must be called before the image is modified by anything but relocations.
+ */
+void virtual_cache_relocated_image( void *module )
+{
+    const IMAGE_NT_HEADERS *nt = RtlImageNtHeader( module );
+    struct file_view *view;
+    char name[MAX_PATH + 64], buffer[32];
+    struct stat st;
+    sigset_t sigset;
+    HANDLE mapping = 0;
+    SIZE_T size = 0;
+    NTSTATUS status;
+    int unix_fd, needs_close;
+
+    if (!use_relocation_cache || !nt) return;
+    if (has_shared_sections( (const IMAGE_SECTION_HEADER *)((const char *)&nt->OptionalHeader +
+                                                            nt->FileHeader.SizeOfOptionalHeader),
+                             nt->FileHeader.NumberOfSections )) return;
+
+    /* only grab the mapping under the lock, the file is accessed outside of it */
+    server_enter_uninterrupted_section( &csVirtual, &sigset );
+    if ((view = VIRTUAL_FindView( module, 0 )) && view->base == module &&
+        (view->protect & VPROT_IMAGE) && view->mapping &&
+        !NtDuplicateObject( NtCurrentProcess(), view->mapping, NtCurrentProcess(), &mapping,
+                            0, 0, DUPLICATE_SAME_ACCESS ))
+        size = view->size;
+    server_leave_uninterrupted_section( &csVirtual, &sigset );
+
+    if (!size) return;
+
+    status = server_get_unix_fd( mapping, 0, &unix_fd, &needs_close, NULL, NULL );
+    NtClose( mapping );
+    if (status) return;
+    if (fstat( unix_fd, &st ) == -1) size = 0;
+    if (needs_close) close( unix_fd );
+    if (!size) return;
+
+    snprintf( name, sizeof(name), "%s/relocs", wine_get_config_dir() );
+    mkdir( name, 0777 );
+
+    if (!get_relocation_cache_name( name, sizeof(name), &st, module )) return;
+    if (!write_relocation_cache_file( name, module, size )) return;
+
+    if (!get_relocation_cache_name( name, sizeof(name), &st, NULL )) return;
+    sprintf( buffer, "%lx\n", (unsigned long)module );
+    write_relocation_cache_file( name, buffer, strlen(buffer) );
+    TRACE_(module)( "cached relocated image %p-%p\n", module, (char *)module + size );
+
+    trim_relocation_cache( &st );
+}
+
+
 /***********************************************************************
  *           map_image
  *
@@ -1072,7 +1380,15 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
     sigset_t sigset;
     struct stat st;
     struct file_view *view = NULL;
-    char *ptr, *header_end, *header_start;
+    char *ptr, *header_end, *header_start, *cache_base = NULL;
+    int cache_fd = -1;
+
+    /* look up the relocation cache before taking the lock, it needs file I/O */
+
+    if (use_relocation_cache && !fstat( fd, &st ) &&
+        (cache_base = get_relocation_cache_base( &st )) && cache_base >= (char *)address_space_start &&
+        cache_base != base)
+        cache_fd = open_relocation_cache( fd, &st, cache_base, total_size );
 
     /* zero-map the whole range */
 
@@ -1082,6 +1398,11 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
         status = map_view( &view, base, total_size, mask, FALSE,
                            VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY | VPROT_IMAGE );
 
+    /* try the address where the image was relocated last time */
+    if (status != STATUS_SUCCESS && cache_fd != -1)
+        status = map_view( &view, cache_base, total_size, mask, FALSE,
+                           VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY | VPROT_IMAGE );
+
     if (status != STATUS_SUCCESS)
         status = map_view( &view, NULL, total_size, mask, FALSE,
                            VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY | VPROT_IMAGE );
@@ -1145,6 +1466,19 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
         goto done;
     }
 
+    /* map the whole image from the relocation cache if it has been relocated here before */
+
+    if (cache_fd != -1 && ptr == cache_base &&
+        !has_shared_sections( sec, nt->FileHeader.NumberOfSections ))
+    {
+        status = map_file_into_view( view, cache_fd, 0, total_size, 0,
+                                     VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY, FALSE );
+        if (status != STATUS_SUCCESS) goto error;
+        TRACE_(module)( "mapped relocated image from cache at %p\n", ptr );
+        nt = (IMAGE_NT_HEADERS *)(ptr + dos->e_lfanew);
+        goto set_protections;
+    }
+
 
     /* map all the sections */
 
@@ -1237,6 +1571,7 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
 
     /* set the image protections */
 
+ set_protections:
     VIRTUAL_SetProt( view, ptr, ROUND_SIZE( 0, header_size ), VPROT_COMMITTED | VPROT_READ );
 
     sec = sections;
@@ -1268,6 +1603,7 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
     view->mapping = dup_mapping;
     view->map_protect = map_vprot;
     server_leave_uninterrupted_section( &csVirtual, &sigset );
+    if (cache_fd != -1) close( cache_fd );
 
     *addr_ptr = ptr;
 #ifdef VALGRIND_LOAD_PDB_DEBUGINFO
@@ -1279,6 +1615,7 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
  error:
     if (view) delete_view( view );
     server_leave_uninterrupted_section( &csVirtual, &sigset );
+    if (cache_fd != -1) close( cache_fd );
     if (dup_mapping) NtClose( dup_mapping );
     return status;
 }
@@ -1316,6 +1653,7 @@ void virtual_init(void)
     while ((1 << page_shift) != page_size) page_shift++;
     user_space_limit = working_set_limit = address_space_limit = (void *)~page_mask;
 #endif  /* page_mask */
+    if ((preload = getenv("WINERELOCCACHE"))) use_relocation_cache = atoi( preload );
     if ((preload = getenv("WINEPRELOADRESERVE")))
     {
         unsigned long start, end;
@@ -28,11 +28,48 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "windef.h"
 #include "winternl.h"
 #include "wine/unicode.h"
 
+#ifdef __SSE2__
+
+/* find the first block of 8 chars that contains either a null or ch, starting from str;
+ * the loads are aligned so that they never cross a page boundary */
+static inline const WCHAR *find_block( const WCHAR *str, WCHAR ch )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i val = _mm_set1_epi16( ch );
+    const __m128i *p = (const __m128i *)((ULONG_PTR)str & ~15);
+    __m128i data = _mm_load_si128( p );
+    unsigned int mask;
+
+    mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi16( data, zero ), _mm_cmpeq_epi16( data, val )));
+    mask &= ~0u << ((ULONG_PTR)str & 15);
+    while (!mask)
+    {
+        data = _mm_load_si128( ++p );
+        mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi16( data, zero ), _mm_cmpeq_epi16( data, val )));
+    }
+    return max( str, (const WCHAR *)p );
+}
+
+#endif  /* __SSE2__ */
+
+/* return a pointer to the terminating null */
+static inline const WCHAR *wcsend( const WCHAR *str )
+{
+#ifdef __SSE2__
+    if (!((ULONG_PTR)str & 1)) str = find_block( str, 0 );
+#endif
+    while (*str) str++;
+    return str;
+}
+
 /*********************************************************************
  *           _wcsicmp    (NTDLL.@)
  */
@@ -101,6 +138,9 @@ LPWSTR __cdecl NTDLL_wcscat( LPWSTR dst, LPCWSTR src )
  */
 LPWSTR __cdecl NTDLL_wcschr( LPCWSTR str, WCHAR ch )
 {
+#ifdef __SSE2__
+    if (!((ULONG_PTR)str & 1)) str = find_block( str, ch );
+#endif
     return strchrW( str, ch );
 }
 
@@ -119,7 +159,7 @@ INT __cdecl NTDLL_wcscmp( LPCWSTR str1, LPCWSTR str2 )
  */
 LPWSTR __cdecl NTDLL_wcscpy( LPWSTR dst, LPCWSTR src )
 {
-    return strcpyW( dst, src );
+    return memmove( dst, src, (wcsend( src ) - src + 1) * sizeof(WCHAR) );
 }
 
 
@@ -137,7 +177,7 @@ INT __cdecl NTDLL_wcscspn( LPCWSTR str, LPCWSTR reject )
  */
 INT __cdecl NTDLL_wcslen( LPCWSTR str )
 {
-    return strlenW( str );
+    return wcsend( str ) - str;
 }
 
 
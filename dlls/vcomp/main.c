@@ -25,6 +25,7 @@
 #include "wine/port.h"
 
 #include <stdarg.h>
+#include <string.h>
 #include <assert.h>
 
 #include "windef.h"
@@ -44,6 +45,8 @@ static HMODULE vcomp_module;
 static int     vcomp_max_threads;
 static int     vcomp_num_threads;
 static BOOL    vcomp_nested_fork = FALSE;
+static int     vcomp_proc_bind;
+static DWORD_PTR vcomp_affinity_mask;
 
 static RTL_CRITICAL_SECTION vcomp_section;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -59,6 +62,14 @@ static RTL_CRITICAL_SECTION vcomp_section = { &critsect_debug, -1, 0, 0, 0, 0 };
 #define VCOMP_DYNAMIC_FLAGS_GUIDED      0x03
 #define VCOMP_DYNAMIC_FLAGS_INCREMENT   0x40
 
+#define VCOMP_PROC_BIND_FALSE   0
+#define VCOMP_PROC_BIND_MASTER  1
+#define VCOMP_PROC_BIND_CLOSE   2
+
+/* number of times to poll for a barrier or the next parallel region
+ * before going to sleep on a condition variable */
+#define VCOMP_SPIN_COUNT        4000
+
 struct vcomp_thread_data
 {
     struct vcomp_team_data  *team;
@@ -66,6 +77,7 @@ struct vcomp_thread_data
     int                     thread_num;
     BOOL                    parallel;
     int                     fork_threads;
+    int                     processor;
 
     /* only used for concurrent tasks */
     struct list             entry;
@@ -76,12 +88,16 @@ struct vcomp_thread_data
 
     /* section */
     unsigned int            section;
+    int                     num_sections;
 
     /* dynamic */
     unsigned int            dynamic;
     unsigned int            dynamic_type;
     unsigned int            dynamic_begin;
     unsigned int            dynamic_end;
+    unsigned int            dynamic_iterations;
+    int                     dynamic_step;
+    unsigned int            dynamic_chunksize;
 };
 
 struct vcomp_team_data
@@ -94,29 +110,28 @@ struct vcomp_team_data
     int                     nargs;
     void                    *wrapper;
     __ms_va_list            valist;
+    BOOL                    proc_bind;
 
     /* barrier */
     unsigned int            barrier;
     int                     barrier_count;
 };
 
+/* The section and dynamic states hold the generation of the work sharing
+ * construct in the high 32 bits and the index of the next section or
+ * iteration in the low 32 bits, so that they can be updated with a single
+ * compare and swap. The bounds of the construct are kept in the thread data,
+ * as every thread of the team passes the same values. */
 struct vcomp_task_data
 {
     /* single */
     unsigned int            single;
 
     /* section */
-    unsigned int            section;
-    int                     num_sections;
-    int                     section_index;
+    LONG64                  section;
 
     /* dynamic */
-    unsigned int            dynamic;
-    unsigned int            dynamic_first;
-    unsigned int            dynamic_last;
-    unsigned int            dynamic_iterations;
-    int                     dynamic_step;
-    unsigned int            dynamic_chunksize;
+    LONG64                  dynamic;
 };
 
 #if defined(__i386__)
@@ -274,6 +289,7 @@ static struct vcomp_thread_data *vcomp_init_thread_data(void)
     thread_data->thread_num     = 0;
     thread_data->parallel       = FALSE;
     thread_data->fork_threads   = 0;
+    thread_data->processor      = -1;
     thread_data->single         = 1;
     thread_data->section        = 1;
     thread_data->dynamic        = 1;
@@ -292,6 +308,64 @@ static void vcomp_free_thread_data(void)
     vcomp_set_thread_data(NULL);
 }
 
+static inline void vcomp_pause(void)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    __asm__ __volatile__( "rep; nop" : : : "memory" );
+#endif
+}
+
+static inline int vcomp_spin_count(int num_threads)
+{
+    /* spinning only helps if every thread of the team can run at the same time */
+    return num_threads <= vcomp_max_threads ? VCOMP_SPIN_COUNT : 0;
+}
+
+static inline LONG64 vcomp_get_state(LONG64 *state)
+{
+#ifdef _WIN64
+    return *(volatile LONG64 *)state;
+#else
+    return interlocked_cmpxchg64(state, 0, 0);
+#endif
+}
+
+/* start a new generation of a section or dynamic state, unless another
+ * thread of the team already did */
+static void vcomp_init_state(LONG64 *state, unsigned int generation)
+{
+    LONG64 old = vcomp_get_state(state), prev;
+
+    while ((int)(generation - (unsigned int)(old >> 32)) > 0)
+    {
+        if ((prev = interlocked_cmpxchg64(state, (LONG64)generation << 32, old)) == old) break;
+        old = prev;
+    }
+}
+
+/* bind the current thread to a processor according to OMP_PROC_BIND,
+ * returns the previous affinity mask if it was changed */
+static DWORD_PTR vcomp_bind_thread(struct vcomp_thread_data *thread_data, int thread_num)
+{
+    DWORD_PTR mask = vcomp_affinity_mask, prev_mask;
+    int count = 0, index, processor;
+
+    for (processor = 0; processor < sizeof(mask) * 8; processor++)
+        if (mask & ((DWORD_PTR)1 << processor)) count++;
+    if (!count) return 0;
+
+    index = (vcomp_proc_bind == VCOMP_PROC_BIND_MASTER) ? 0 : thread_num % count;
+    for (processor = 0; processor < sizeof(mask) * 8; processor++)
+        if ((mask & ((DWORD_PTR)1 << processor)) && !index--) break;
+
+    if (thread_data->processor == processor) return 0;
+    if ((prev_mask = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << processor)))
+        thread_data->processor = processor;
+    else
+        WARN("failed to bind thread %d to processor %d\n", thread_num, processor);
+    return prev_mask;
+}
+
 void CDECL _vcomp_atomic_add_i4(int *dest, int val)
 {
     interlocked_xchg_add(dest, val);
@@ -358,90 +432,90 @@ void CDECL _vcomp_atomic_xor_i4(int *dest, int val)
 
 void CDECL _vcomp_atomic_add_r4(float *dest, float val)
 {
-    int old, new;
-    do
+    int old = *(int *)dest, new, prev;
+    for (;;)
     {
-        old = *(int *)dest;
         *(float *)&new = *(float *)&old + val;
+        if ((prev = interlocked_cmpxchg((int *)dest, new, old)) == old) break;
+        old = prev;
     }
-    while (interlocked_cmpxchg((int *)dest, new, old) != old);
 }
 
 void CDECL _vcomp_atomic_div_r4(float *dest, float val)
 {
-    int old, new;
-    do
+    int old = *(int *)dest, new, prev;
+    for (;;)
     {
-        old = *(int *)dest;
         *(float *)&new = *(float *)&old / val;
+        if ((prev = interlocked_cmpxchg((int *)dest, new, old)) == old) break;
+        old = prev;
     }
-    while (interlocked_cmpxchg((int *)dest, new, old) != old);
 }
 
 void CDECL _vcomp_atomic_mul_r4(float *dest, float val)
 {
-    int old, new;
-    do
+    int old = *(int *)dest, new, prev;
+    for (;;)
     {
-        old = *(int *)dest;
         *(float *)&new = *(float *)&old * val;
+        if ((prev = interlocked_cmpxchg((int *)dest, new, old)) == old) break;
+        old = prev;
     }
-    while (interlocked_cmpxchg((int *)dest, new, old) != old);
 }
 
 void CDECL _vcomp_atomic_sub_r4(float *dest, float val)
 {
-    int old, new;
-    do
+    int old = *(int *)dest, new, prev;
+    for (;;)
     {
-        old = *(int *)dest;
         *(float *)&new = *(float *)&old - val;
+        if ((prev = interlocked_cmpxchg((int *)dest, new, old)) == old) break;
+        old = prev;
     }
-    while (interlocked_cmpxchg((int *)dest, new, old) != old);
 }
 
 void CDECL _vcomp_atomic_add_r8(double *dest, double val)
 {
-    LONG64 old, new;
-    do
+    LONG64 old = *(LONG64 *)dest, new, prev;
+    for (;;)
     {
-        old = *(LONG64 *)dest;
         *(double *)&new = *(double *)&old + val;
+        if ((prev = interlocked_cmpxchg64((LONG64 *)dest, new, old)) == old) break;
+        old = prev;
     }
-    while (interlocked_cmpxchg64((LONG64 *)dest, new, old) != old);
 }
 
 void CDECL _vcomp_atomic_div_r8(double *dest, double val)
 {
-    LONG64 old, new;
-    do
+    LONG64 old = *(LONG64 *)dest, new, prev;
+    for (;;)
     {
-        old = *(LONG64 *)dest;
         *(double *)&new = *(double *)&old / val;
+        if ((prev = interlocked_cmpxchg64((LONG64 *)dest, new, old)) == old) break;
+        old = prev;
     }
-    while (interlocked_cmpxchg64((LONG64 *)dest, new, old) != old);
 }
 
 void CDECL _vcomp_atomic_mul_r8(double *dest, double val)
 {
-    LONG64 old, new;
-    do
+    LONG64 old = *(LONG64 *)dest, new, prev;
+    for (;;)
     {
-        old = *(LONG64 *)dest;
         *(double *)&new = *(double *)&old * val;
+        if ((prev = interlocked_cmpxchg64((LONG64 *)dest, new, old)) == old) break;
+        old = prev;
     }
-    while (interlocked_cmpxchg64((LONG64 *)dest, new, old) != old);
 }
 
 void CDECL _vcomp_atomic_sub_r8(double *dest, double val)
 {
-    LONG64 old, new;
-    do
+    LONG64 old = *(LONG64 *)dest, new, prev;
+    for (;;)
     {
-        old = *(LONG64 *)dest;
         *(double *)&new = *(double *)&old - val;
+        if ((prev = interlocked_cmpxchg64((LONG64 *)dest, new, old)) == old) break;
+        old = prev;
     }
-    while (interlocked_cmpxchg64((LONG64 *)dest, new, old) != old);
 }
 
 int CDECL omp_get_dynamic(void)
@@ -519,25 +593,34 @@ void CDECL _vcomp_flush(void)
 void CDECL _vcomp_barrier(void)
 {
     struct vcomp_team_data *team_data = vcomp_init_thread_data()->team;
+    unsigned int barrier;
+    int spin;
 
     TRACE("()\n");
 
     if (!team_data)
         return;
 
-    EnterCriticalSection(&vcomp_section);
-    if (++team_data->barrier_count >= team_data->num_threads)
+    barrier = team_data->barrier;
+    if (interlocked_xchg_add(&team_data->barrier_count, 1) + 1 >= team_data->num_threads)
     {
-        team_data->barrier++;
         team_data->barrier_count = 0;
+        EnterCriticalSection(&vcomp_section);
+        team_data->barrier++;
         WakeAllConditionVariable(&team_data->cond);
+        LeaveCriticalSection(&vcomp_section);
+        return;
     }
-    else
+
+    for (spin = vcomp_spin_count(team_data->num_threads); spin; spin--)
     {
-        unsigned int barrier = team_data->barrier;
-        while (team_data->barrier == barrier)
-            SleepConditionVariableCS(&team_data->cond, &vcomp_section, INFINITE);
+        if (*(volatile unsigned int *)&team_data->barrier != barrier) return;
+        vcomp_pause();
     }
+
+    EnterCriticalSection(&vcomp_section);
+    while (team_data->barrier == barrier)
+        SleepConditionVariableCS(&team_data->cond, &vcomp_section, INFINITE);
     LeaveCriticalSection(&vcomp_section);
 }
 
@@ -564,20 +647,19 @@ int CDECL _vcomp_single_begin(int flags)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
-    int ret = FALSE;
+    unsigned int single, prev;
 
     TRACE("(%x): semi-stub\n", flags);
 
-    EnterCriticalSection(&vcomp_section);
     thread_data->single++;
-    if ((int)(thread_data->single - task_data->single) > 0)
+    single = *(volatile unsigned int *)&task_data->single;
+    while ((int)(thread_data->single - single) > 0)
     {
-        task_data->single = thread_data->single;
-        ret = TRUE;
+        prev = interlocked_cmpxchg((int *)&task_data->single, thread_data->single, single);
+        if (prev == single) return TRUE;
+        single = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
-
-    return ret;
+    return FALSE;
 }
 
 void CDECL _vcomp_single_end(void)
@@ -593,33 +675,28 @@ void CDECL _vcomp_sections_init(int n)
 
     TRACE("(%d)\n", n);
 
-    EnterCriticalSection(&vcomp_section);
     thread_data->section++;
-    if ((int)(thread_data->section - task_data->section) > 0)
-    {
-        task_data->section       = thread_data->section;
-        task_data->num_sections  = n;
-        task_data->section_index = 0;
-    }
-    LeaveCriticalSection(&vcomp_section);
+    thread_data->num_sections = n;
+    vcomp_init_state(&task_data->section, thread_data->section);
 }
 
 int CDECL _vcomp_sections_next(void)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
-    int i = -1;
+    LONG64 section, prev;
 
     TRACE("()\n");
 
-    EnterCriticalSection(&vcomp_section);
-    if (thread_data->section == task_data->section &&
-        task_data->section_index != task_data->num_sections)
+    section = vcomp_get_state(&task_data->section);
+    while ((unsigned int)(section >> 32) == thread_data->section &&
+           (int)section != thread_data->num_sections)
     {
-        i = task_data->section_index++;
+        if ((prev = interlocked_cmpxchg64(&task_data->section, section + 1, section)) == section)
+            return (int)section;
+        section = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
-    return i;
+    return -1;
 }
 
 void CDECL _vcomp_for_static_simple_init(unsigned int first, unsigned int last, int step,
@@ -797,19 +874,14 @@ void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsig
             type = VCOMP_DYNAMIC_FLAGS_GUIDED;
         }
 
-        EnterCriticalSection(&vcomp_section);
         thread_data->dynamic++;
-        thread_data->dynamic_type = type;
-        if ((int)(thread_data->dynamic - task_data->dynamic) > 0)
-        {
-            task_data->dynamic              = thread_data->dynamic;
-            task_data->dynamic_first        = first;
-            task_data->dynamic_last         = last;
-            task_data->dynamic_iterations   = iterations;
-            task_data->dynamic_step         = step;
-            task_data->dynamic_chunksize    = chunksize;
-        }
-        LeaveCriticalSection(&vcomp_section);
+        thread_data->dynamic_type       = type;
+        thread_data->dynamic_begin      = first;
+        thread_data->dynamic_end        = last;
+        thread_data->dynamic_iterations = iterations;
+        thread_data->dynamic_step       = step;
+        thread_data->dynamic_chunksize  = chunksize;
+        vcomp_init_state(&task_data->dynamic, thread_data->dynamic);
     }
 }
 
@@ -832,26 +904,35 @@ int CDECL _vcomp_for_dynamic_next(unsigned int *begin, unsigned int *end)
     else if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_CHUNKED ||
              thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED)
     {
-        unsigned int iterations = 0;
-        EnterCriticalSection(&vcomp_section);
-        if (thread_data->dynamic == task_data->dynamic &&
-            task_data->dynamic_iterations != 0)
+        unsigned int index, remaining, iterations;
+        LONG64 dynamic, prev;
+
+        dynamic = vcomp_get_state(&task_data->dynamic);
+        for (;;)
         {
-            iterations = min(task_data->dynamic_iterations, task_data->dynamic_chunksize);
+            if ((unsigned int)(dynamic >> 32) != thread_data->dynamic) return 0;
+            index     = (unsigned int)dynamic;
+            remaining = thread_data->dynamic_iterations - index;
+            if (!remaining) return 0;
+
+            iterations = min(remaining, thread_data->dynamic_chunksize);
             if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED &&
-                task_data->dynamic_iterations > num_threads * task_data->dynamic_chunksize)
+                remaining > num_threads * thread_data->dynamic_chunksize)
             {
-                iterations = (task_data->dynamic_iterations + num_threads - 1) / num_threads;
+                iterations = (remaining + num_threads - 1) / num_threads;
             }
-            *begin = task_data->dynamic_first;
-            *end   = task_data->dynamic_first + (iterations - 1) * task_data->dynamic_step;
-            task_data->dynamic_iterations -= iterations;
-            task_data->dynamic_first      += iterations * task_data->dynamic_step;
-            if (!task_data->dynamic_iterations)
-                *end = task_data->dynamic_last;
+            if (!iterations) return 0;
+
+            if ((prev = interlocked_cmpxchg64(&task_data->dynamic, dynamic + iterations, dynamic)) == dynamic)
+                break;
+            dynamic = prev;
         }
-        LeaveCriticalSection(&vcomp_section);
-        return iterations != 0;
+
+        *begin = thread_data->dynamic_begin + index * thread_data->dynamic_step;
+        *end   = *begin + (iterations - 1) * thread_data->dynamic_step;
+        if (iterations == remaining)
+            *end = thread_data->dynamic_end;
+        return 1;
     }
 
     return 0;
@@ -866,6 +947,9 @@ int CDECL omp_in_parallel(void)
 static DWORD WINAPI _vcomp_fork_worker(void *param)
 {
     struct vcomp_thread_data *thread_data = param;
+    int spin, num_threads = 1;
+    DWORD_PTR prev_affinity;
+
     vcomp_set_thread_data(thread_data);
 
     TRACE("starting worker thread for %p\n", thread_data);
@@ -877,16 +961,36 @@ static DWORD WINAPI _vcomp_fork_worker(void *param)
         if (team != NULL)
         {
             LeaveCriticalSection(&vcomp_section);
+            prev_affinity = team->proc_bind ? vcomp_bind_thread(thread_data, thread_data->thread_num) : 0;
             _vcomp_fork_call_wrapper(team->wrapper, team->nargs, team->valist);
+
+            /* pooled threads may be reused by unbound teams, don't leave them pinned */
+            if (prev_affinity)
+            {
+                SetThreadAffinityMask(GetCurrentThread(), prev_affinity);
+                thread_data->processor = -1;
+            }
             EnterCriticalSection(&vcomp_section);
 
             thread_data->team = NULL;
             list_remove(&thread_data->entry);
             list_add_tail(&vcomp_idle_threads, &thread_data->entry);
+            num_threads = team->num_threads;
             if (++team->finished_threads >= team->num_threads)
                 WakeAllConditionVariable(&team->cond);
         }
 
+        /* parallel regions often follow each other closely, so wait a bit for
+         * the next one before going to sleep */
+        LeaveCriticalSection(&vcomp_section);
+        for (spin = vcomp_spin_count(num_threads); spin; spin--)
+        {
+            if (*(struct vcomp_team_data * volatile *)&thread_data->team) break;
+            vcomp_pause();
+        }
+        EnterCriticalSection(&vcomp_section);
+        if (thread_data->team) continue;
+
         if (!SleepConditionVariableCS(&thread_data->cond, &vcomp_section, 5000) &&
             GetLastError() == ERROR_TIMEOUT && !thread_data->team)
         {
@@ -910,7 +1014,8 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
     struct vcomp_thread_data thread_data;
     struct vcomp_team_data team_data;
     struct vcomp_task_data task_data;
-    int num_threads;
+    DWORD_PTR prev_affinity = 0;
+    int num_threads, spin;
 
     TRACE("(%d, %d, %p, ...)\n", ifval, nargs, wrapper);
 
@@ -930,6 +1035,7 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
     team_data.nargs             = nargs;
     team_data.wrapper           = wrapper;
     __ms_va_start(team_data.valist, wrapper);
+    team_data.proc_bind         = FALSE;
     team_data.barrier           = 0;
     team_data.barrier_count     = 0;
 
@@ -942,6 +1048,7 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
     thread_data.thread_num      = 0;
     thread_data.parallel        = ifval || prev_thread_data->parallel;
     thread_data.fork_threads    = 0;
+    thread_data.processor       = prev_thread_data->processor;
     thread_data.single          = 1;
     thread_data.section         = 1;
     thread_data.dynamic         = 1;
@@ -952,6 +1059,10 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
     if (num_threads > 1)
     {
         struct list *ptr;
+
+        /* only the outermost team is bound to processors */
+        team_data.proc_bind = vcomp_proc_bind != VCOMP_PROC_BIND_FALSE && !prev_thread_data->parallel;
+
         EnterCriticalSection(&vcomp_section);
 
         /* reuse existing threads (if any) */
@@ -987,6 +1098,7 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
             data->thread_num    = team_data.num_threads;
             data->parallel      = thread_data.parallel;
             data->fork_threads  = 0;
+            data->processor     = -1;
             data->single        = 1;
             data->section       = 1;
             data->dynamic       = 1;
@@ -1008,6 +1120,12 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
         }
 
         LeaveCriticalSection(&vcomp_section);
+
+        if (team_data.proc_bind && team_data.num_threads > 1)
+        {
+            prev_affinity = vcomp_bind_thread(prev_thread_data, 0);
+            thread_data.processor = prev_thread_data->processor;
+        }
     }
 
     vcomp_set_thread_data(&thread_data);
@@ -1017,6 +1135,12 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
 
     if (team_data.num_threads > 1)
     {
+        for (spin = vcomp_spin_count(team_data.num_threads); spin; spin--)
+        {
+            if (*(volatile int *)&team_data.finished_threads >= team_data.num_threads - 1) break;
+            vcomp_pause();
+        }
+
         EnterCriticalSection(&vcomp_section);
 
         team_data.finished_threads++;
@@ -1027,6 +1151,13 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
         assert(list_empty(&thread_data.entry));
     }
 
+    /* the master thread only belongs to the processor for the region */
+    if (prev_affinity)
+    {
+        SetThreadAffinityMask(GetCurrentThread(), prev_affinity);
+        prev_thread_data->processor = -1;
+    }
+
     __ms_va_end(team_data.valist);
 }
 
@@ -1039,7 +1170,9 @@ static CRITICAL_SECTION *alloc_critsect(void)
         ExitProcess(1);
     }
 
-    InitializeCriticalSection(critsect);
+    /* critical sections in parallel regions are usually held for a short time,
+     * spin for about as long before waiting */
+    InitializeCriticalSectionEx(critsect, 0, RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN);
     critsect->DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": critsect");
     return critsect;
 }
@@ -1131,6 +1264,33 @@ void CDECL _vcomp_leave_critsect(CRITICAL_SECTION *critsect)
     LeaveCriticalSection(critsect);
 }
 
+static void vcomp_init_proc_bind(void)
+{
+    DWORD_PTR system_mask;
+    char buffer[64], *p;
+    DWORD len;
+
+    len = GetEnvironmentVariableA("OMP_PROC_BIND", buffer, sizeof(buffer));
+    if (!len || len >= sizeof(buffer)) return;
+
+    /* only the binding of the outermost level is supported */
+    if ((p = strchr(buffer, ','))) *p = 0;
+
+    if (!lstrcmpiA(buffer, "master"))
+        vcomp_proc_bind = VCOMP_PROC_BIND_MASTER;
+    else if (!lstrcmpiA(buffer, "true") || !lstrcmpiA(buffer, "close") || !lstrcmpiA(buffer, "spread"))
+        vcomp_proc_bind = VCOMP_PROC_BIND_CLOSE;
+    else
+    {
+        if (lstrcmpiA(buffer, "false")) WARN("unsupported OMP_PROC_BIND %s\n", debugstr_a(buffer));
+        return;
+    }
+
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &vcomp_affinity_mask, &system_mask))
+        vcomp_proc_bind = VCOMP_PROC_BIND_FALSE;
+    TRACE("binding threads to processors %lx, policy %d\n", (ULONG_PTR)vcomp_affinity_mask, vcomp_proc_bind);
+}
+
 BOOL WINAPI DllMain(HINSTANCE instance, DWORD reason, LPVOID reserved)
 {
     TRACE("(%p, %d, %p)\n", instance, reason, reserved);
@@ -1154,6 +1314,7 @@ BOOL WINAPI DllMain(HINSTANCE instance, DWORD reason, LPVOID reserved)
             vcomp_module      = instance;
             vcomp_max_threads = sysinfo.dwNumberOfProcessors;
             vcomp_num_threads = sysinfo.dwNumberOfProcessors;
+            vcomp_init_proc_bind();
             break;
         }
 
@@ -1262,6 +1262,42 @@ static void test_vcomp_single_begin(void)
     pomp_set_num_threads(max_threads);
 }
 
+static void CDECL barrier_cb(LONG *count)
+{
+    int num_threads = pomp_get_num_threads();
+    int i;
+
+    for (i = 0; i < 100; i++)
+    {
+        InterlockedIncrement(count);
+        p_vcomp_barrier();
+        ok(*count == (i + 1) * num_threads, "expected %d, got %d\n", (i + 1) * num_threads, *count);
+        p_vcomp_barrier();
+    }
+}
+
+static void test_vcomp_barrier(void)
+{
+    int max_threads = pomp_get_max_threads();
+    LONG count;
+    int i;
+
+    count = 0;
+    barrier_cb(&count);
+    ok(count == 100, "expected count == 100, got %d\n", count);
+
+    for (i = 1; i <= 4; i++)
+    {
+        pomp_set_num_threads(i);
+
+        count = 0;
+        p_vcomp_fork(TRUE, 1, barrier_cb, &count);
+        ok(count == 100 * i, "expected count == %d, got %d\n", 100 * i, count);
+    }
+
+    pomp_set_num_threads(max_threads);
+}
+
 static void CDECL critsect_cb(LONG *a)
 {
     static CRITICAL_SECTION *critsect;
@@ -1493,6 +1529,38 @@ static void test_atomic_double(void)
     }
 }
 
+static void CDECL atomic_reduction_cb(float *f, double *d)
+{
+    int i;
+
+    for (i = 0; i < 1000; i++)
+    {
+        p_vcomp_atomic_add_r4(f, 1.0f);
+        p_vcomp_atomic_add_r8(d, 1.0);
+    }
+}
+
+static void test_atomic_reduction(void)
+{
+    int max_threads = pomp_get_max_threads();
+    double d;
+    float f;
+    int i;
+
+    for (i = 1; i <= 4; i++)
+    {
+        pomp_set_num_threads(i);
+
+        f = 0.0f;
+        d = 0.0;
+        p_vcomp_fork(TRUE, 2, atomic_reduction_cb, &f, &d);
+        ok(f == 1000.0f * i, "expected f == %f, got %f\n", 1000.0f * i, f);
+        ok(d == 1000.0 * i, "expected d == %f, got %f\n", 1000.0 * i, d);
+    }
+
+    pomp_set_num_threads(max_threads);
+}
+
 START_TEST(vcomp)
 {
     if (!init_vcomp())
@@ -1507,6 +1575,7 @@ START_TEST(vcomp)
     test_vcomp_for_dynamic_init();
     test_vcomp_master_begin();
     test_vcomp_single_begin();
+    test_vcomp_barrier();
     test_vcomp_enter_critsect();
     test_vcomp_flush();
     test_omp_init_lock();
@@ -1514,6 +1583,7 @@ START_TEST(vcomp)
     test_atomic_integer32();
     test_atomic_float();
     test_atomic_double();
+    test_atomic_reduction();
 
     release_vcomp();
 }
@@ -22,6 +22,8 @@
 
 #include "wine/unicode.h"
 
+extern unsigned int ascii_mbstowcs( const unsigned char *src, unsigned int srclen, WCHAR *dst );
+
 /* get the decomposition of a Unicode char */
 static int get_decomposition( WCHAR src, WCHAR *dst, unsigned int dstlen )
 {
@@ -64,6 +66,15 @@ static inline int check_invalid_chars_sbcs( const struct sbcs_table *table, int
     return srclen;
 }
 
+/* check whether the code page maps 7-bit ASCII to itself */
+static inline int is_ascii_cp2uni( const WCHAR *cp2uni )
+{
+    unsigned int i;
+
+    for (i = 0; i < 0x80; i++) if (cp2uni[i] != i) return 0;
+    return 1;
+}
+
 /* mbstowcs for single-byte code page */
 /* all lengths are in characters, not bytes */
 static inline int mbstowcs_sbcs( const struct sbcs_table *table, int flags,
@@ -80,6 +91,20 @@ static inline int mbstowcs_sbcs( const struct sbcs_table *table, int flags,
         ret = -1;
     }
 
+    /* long strings in ASCII compatible code pages are copied by runs */
+    if (srclen >= 64 && is_ascii_cp2uni( cp2uni ))
+    {
+        while (srclen)
+        {
+            unsigned int len = ascii_mbstowcs( src, srclen, dst );
+            src += len;
+            dst += len;
+            srclen -= len;
+            for ( ; srclen && *src >= 0x80; srclen--) *dst++ = cp2uni[*src++];
+        }
+        return ret;
+    }
+
     for (;;)
     {
         switch(srclen)
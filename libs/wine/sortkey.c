@@ -155,8 +155,8 @@ int wine_get_sortkey(int flags, const WCHAR *src, int srclen, char *dst, int dst
     return key_ptr[3] - dst;
 }
 
-static inline int compare_unicode_weights(int flags, const WCHAR *str1, int len1,
-                                          const WCHAR *str2, int len2)
+static inline int compare_diacritic_weights(int flags, const WCHAR *str1, int len1,
+                                            const WCHAR *str2, int len2)
 {
     unsigned int ce1, ce2;
     int ret;
@@ -186,33 +186,11 @@ static inline int compare_unicode_weights(int flags, const WCHAR *str1, int len1
             if (skip) continue;
         }
 
-       /* hyphen and apostrophe are treated differently depending on
-        * whether SORT_STRINGSORT specified or not
-        */
-        if (!(flags & SORT_STRINGSORT))
-        {
-            if (*str1 == '-' || *str1 == '\'')
-            {
-                if (*str2 != '-' && *str2 != '\'')
-                {
-                    str1++;
-                    len1--;
-                    continue;
-                }
-            }
-            else if (*str2 == '-' || *str2 == '\'')
-            {
-                str2++;
-                len2--;
-                continue;
-            }
-        }
-
         ce1 = collation_table[collation_table[*str1 >> 8] + (*str1 & 0xff)];
         ce2 = collation_table[collation_table[*str2 >> 8] + (*str2 & 0xff)];
 
         if (ce1 != (unsigned int)-1 && ce2 != (unsigned int)-1)
-            ret = (ce1 >> 16) - (ce2 >> 16);
+            ret = ((ce1 >> 8) & 0xff) - ((ce2 >> 8) & 0xff);
         else
             ret = *str1 - *str2;
 
@@ -226,8 +204,8 @@ static inline int compare_unicode_weights(int flags, const WCHAR *str1, int len1
     return len1 - len2;
 }
 
-static inline int compare_diacritic_weights(int flags, const WCHAR *str1, int len1,
-                                            const WCHAR *str2, int len2)
+static inline int compare_case_weights(int flags, const WCHAR *str1, int len1,
+                                       const WCHAR *str2, int len2)
 {
     unsigned int ce1, ce2;
     int ret;
@@ -261,7 +239,7 @@ static inline int compare_diacritic_weights(int flags, const WCHAR *str1, int le
         ce2 = collation_table[collation_table[*str2 >> 8] + (*str2 & 0xff)];
 
         if (ce1 != (unsigned int)-1 && ce2 != (unsigned int)-1)
-            ret = ((ce1 >> 8) & 0xff) - ((ce2 >> 8) & 0xff);
+            ret = ((ce1 >> 4) & 0x0f) - ((ce2 >> 4) & 0x0f);
         else
             ret = *str1 - *str2;
 
@@ -275,22 +253,37 @@ static inline int compare_diacritic_weights(int flags, const WCHAR *str1, int le
     return len1 - len2;
 }
 
-static inline int compare_case_weights(int flags, const WCHAR *str1, int len1,
-                                       const WCHAR *str2, int len2)
+static inline int real_length(const WCHAR *str, int len)
+{
+    while (len && !str[len - 1]) len--;
+    return len;
+}
+
+/* compare all the weights at once, falls back to separate passes when hyphens
+ * or apostrophes get skipped, since the primary weights are compared without them */
+static inline int compare_weights(int flags, const WCHAR *str1, int len1,
+                                  const WCHAR *str2, int len2)
 {
     unsigned int ce1, ce2;
-    int ret;
+    int ret, diacritic = 0, case_diff = 0, skipped = 0;
+    const WCHAR *start1 = str1, *start2 = str2;
+    int start_len1 = len1, start_len2 = len2;
 
-    /* 32-bit collation element table format:
-     * unicode weight - high 16 bit, diacritic weight - high 8 bit of low 16 bit,
-     * case weight - high 4 bit of low 8 bit.
-     */
     while (len1 > 0 && len2 > 0)
     {
+        /* identical chars have identical weights */
+        if (*str1 == *str2)
+        {
+            str1++;
+            str2++;
+            len1--;
+            len2--;
+            continue;
+        }
+
         if (flags & NORM_IGNORESYMBOLS)
         {
             int skip = 0;
-            /* FIXME: not tested */
             if (get_char_typeW(*str1) & (C1_PUNCT | C1_SPACE))
             {
                 str1++;
@@ -306,45 +299,63 @@ static inline int compare_case_weights(int flags, const WCHAR *str1, int len1,
             if (skip) continue;
         }
 
+        if (!(flags & SORT_STRINGSORT))
+        {
+            if (*str1 == '-' || *str1 == '\'')
+            {
+                if (*str2 != '-' && *str2 != '\'')
+                {
+                    str1++;
+                    len1--;
+                    skipped = 1;
+                    continue;
+                }
+            }
+            else if (*str2 == '-' || *str2 == '\'')
+            {
+                str2++;
+                len2--;
+                skipped = 1;
+                continue;
+            }
+        }
+
         ce1 = collation_table[collation_table[*str1 >> 8] + (*str1 & 0xff)];
         ce2 = collation_table[collation_table[*str2 >> 8] + (*str2 & 0xff)];
 
-        if (ce1 != (unsigned int)-1 && ce2 != (unsigned int)-1)
-            ret = ((ce1 >> 4) & 0x0f) - ((ce2 >> 4) & 0x0f);
-        else
-            ret = *str1 - *str2;
+        if (ce1 == (unsigned int)-1 || ce2 == (unsigned int)-1) return *str1 - *str2;
+        if ((ret = (ce1 >> 16) - (ce2 >> 16))) return ret;
 
-        if (ret) return ret;
+        if (!diacritic) diacritic = ((ce1 >> 8) & 0xff) - ((ce2 >> 8) & 0xff);
+        if (!case_diff) case_diff = ((ce1 >> 4) & 0x0f) - ((ce2 >> 4) & 0x0f);
 
         str1++;
         str2++;
         len1--;
         len2--;
     }
-    return len1 - len2;
-}
+    if ((ret = len1 - len2)) return ret;
 
-static inline int real_length(const WCHAR *str, int len)
-{
-    while (len && !str[len - 1]) len--;
-    return len;
+    if (skipped)
+    {
+        /* the other weights don't skip the same chars, compare them separately */
+        if (!(flags & NORM_IGNORENONSPACE))
+            ret = compare_diacritic_weights(flags, start1, start_len1, start2, start_len2);
+        if (!ret && !(flags & NORM_IGNORECASE))
+            ret = compare_case_weights(flags, start1, start_len1, start2, start_len2);
+        return ret;
+    }
+
+    if (!(flags & NORM_IGNORENONSPACE) && diacritic) return diacritic;
+    if (!(flags & NORM_IGNORECASE)) return case_diff;
+    return 0;
 }
 
 int wine_compare_string(int flags, const WCHAR *str1, int len1,
                         const WCHAR *str2, int len2)
 {
-    int ret;
-
     len1 = real_length(str1, len1);
     len2 = real_length(str2, len2);
 
-    ret = compare_unicode_weights(flags, str1, len1, str2, len2);
-    if (!ret)
-    {
-        if (!(flags & NORM_IGNORENONSPACE))
-            ret = compare_diacritic_weights(flags, str1, len1, str2, len2);
-        if (!ret && !(flags & NORM_IGNORECASE))
-            ret = compare_case_weights(flags, str1, len1, str2, len2);
-    }
-    return ret;
+    return compare_weights(flags, str1, len1, str2, len2);
 }
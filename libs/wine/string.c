@@ -21,16 +21,73 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define WINE_UNICODE_INLINE  /* nothing */
 #include "wine/unicode.h"
 
+#ifdef __SSE2__
+
+/* convert ASCII uppercase chars to lowercase */
+static inline __m128i ascii_lower( __m128i val )
+{
+    __m128i upper = _mm_and_si128( _mm_cmpgt_epi16( val, _mm_set1_epi16( 'A' - 1 )),
+                                   _mm_cmplt_epi16( val, _mm_set1_epi16( 'Z' + 1 )));
+    return _mm_add_epi16( val, _mm_and_si128( upper, _mm_set1_epi16( 0x20 )));
+}
+
+/* check if a 16-byte load would cross into the next page */
+static inline int crosses_page( const WCHAR *str )
+{
+    return ((unsigned long)str & 0xfff) > 0x1000 - 16;
+}
+
+#endif  /* __SSE2__ */
+
+/* length of the common prefix of two strings, ignoring case, in blocks of 8 chars;
+ * the blocks are compared case-insensitively only when they are 7-bit ASCII */
+static inline int caseless_prefix( const WCHAR *str1, const WCHAR *str2, int n, int nul_terminated )
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i non_ascii = _mm_set1_epi16( 0xff80 );
+
+    for ( ; i <= n - 8; i += 8)
+    {
+        __m128i val1, val2;
+
+        if (nul_terminated && (crosses_page( str1 + i ) || crosses_page( str2 + i ))) break;
+        val1 = _mm_loadu_si128( (const __m128i *)(str1 + i) );
+        val2 = _mm_loadu_si128( (const __m128i *)(str2 + i) );
+        if (nul_terminated && _mm_movemask_epi8( _mm_cmpeq_epi16( val1, zero ))) break;
+        if (_mm_movemask_epi8( _mm_cmpeq_epi16( _mm_and_si128( _mm_or_si128( val1, val2 ), non_ascii ),
+                                                zero )) == 0xffff)
+        {
+            val1 = ascii_lower( val1 );
+            val2 = ascii_lower( val2 );
+        }
+        if (_mm_movemask_epi8( _mm_cmpeq_epi16( val1, val2 )) != 0xffff) break;
+    }
+#endif
+    return i;
+}
+
 int strcmpiW( const WCHAR *str1, const WCHAR *str2 )
 {
     for (;;)
     {
-        int ret = tolowerW(*str1) - tolowerW(*str2);
-        if (ret || !*str1) return ret;
+        int ret, len = caseless_prefix( str1, str2, INT_MAX, 1 );
+
+        str1 += len;
+        str2 += len;
+        if (*str1 != *str2)
+        {
+            if ((ret = tolowerW(*str1) - tolowerW(*str2))) return ret;
+        }
+        else if (!*str1) return 0;
         str1++;
         str2++;
     }
@@ -39,16 +96,38 @@ int strcmpiW( const WCHAR *str1, const WCHAR *str2 )
 int strncmpiW( const WCHAR *str1, const WCHAR *str2, int n )
 {
     int ret = 0;
-    for ( ; n > 0; n--, str1++, str2++)
+
+    while (n > 0)
+    {
+        int len = caseless_prefix( str1, str2, n, 1 );
+
+        str1 += len;
+        str2 += len;
+        if (!(n -= len)) break;
         if ((ret = tolowerW(*str1) - tolowerW(*str2)) || !*str1) break;
+        str1++;
+        str2++;
+        n--;
+    }
     return ret;
 }
 
 int memicmpW( const WCHAR *str1, const WCHAR *str2, int n )
 {
     int ret = 0;
-    for ( ; n > 0; n--, str1++, str2++)
+
+    while (n > 0)
+    {
+        int len = caseless_prefix( str1, str2, n, 0 );
+
+        str1 += len;
+        str2 += len;
+        if (!(n -= len)) break;
         if ((ret = tolowerW(*str1) - tolowerW(*str2))) break;
+        str1++;
+        str2++;
+        n--;
+    }
     return ret;
 }
 
@@ -19,6 +19,9 @@
  */
 
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "wine/unicode.h"
 
@@ -44,6 +47,77 @@ static const unsigned char utf8_mask[4] = { 0x7f, 0x1f, 0x0f, 0x07 };
 static const unsigned int utf8_minval[4] = { 0x0, 0x80, 0x800, 0x10000 };
 
 
+/* length of the initial run of 7-bit ASCII chars */
+unsigned int ascii_length( const unsigned char *src, unsigned int srclen )
+{
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    for ( ; i + 16 <= srclen; i += 16)
+        if (_mm_movemask_epi8( _mm_loadu_si128( (const __m128i *)(src + i) ))) break;
+#else
+    for ( ; i + sizeof(unsigned long) <= srclen; i += sizeof(unsigned long))
+    {
+        unsigned long val;
+        memcpy( &val, src + i, sizeof(val) );
+        if (val & (~0ul / 0xff * 0x80)) break;
+    }
+#endif
+    while (i < srclen && src[i] < 0x80) i++;
+    return i;
+}
+
+/* convert the initial run of 7-bit ASCII chars, return the number of chars converted */
+unsigned int ascii_mbstowcs( const unsigned char *src, unsigned int srclen, WCHAR *dst )
+{
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+
+    for ( ; i + 16 <= srclen; i += 16)
+    {
+        __m128i val = _mm_loadu_si128( (const __m128i *)(src + i) );
+        if (_mm_movemask_epi8( val )) break;
+        _mm_storeu_si128( (__m128i *)(dst + i), _mm_unpacklo_epi8( val, zero ));
+        _mm_storeu_si128( (__m128i *)(dst + i + 8), _mm_unpackhi_epi8( val, zero ));
+    }
+#else
+    for ( ; i + sizeof(unsigned long) <= srclen; i += sizeof(unsigned long))
+    {
+        unsigned long val;
+        unsigned int j;
+        memcpy( &val, src + i, sizeof(val) );
+        if (val & (~0ul / 0xff * 0x80)) break;
+        for (j = 0; j < sizeof(val); j++) dst[i + j] = src[i + j];
+    }
+#endif
+    for ( ; i < srclen && src[i] < 0x80; i++) dst[i] = src[i];
+    return i;
+}
+
+/* convert the initial run of 7-bit ASCII chars, return the number of chars converted */
+unsigned int ascii_wcstombs( const WCHAR *src, unsigned int srclen, char *dst )
+{
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi16( 0xff80 );
+
+    for ( ; i + 16 <= srclen; i += 16)
+    {
+        __m128i lo = _mm_loadu_si128( (const __m128i *)(src + i) );
+        __m128i hi = _mm_loadu_si128( (const __m128i *)(src + i + 8) );
+        __m128i high_bits = _mm_and_si128( _mm_or_si128( lo, hi ), mask );
+        if (_mm_movemask_epi8( _mm_cmpeq_epi16( high_bits, zero )) != 0xffff) break;
+        _mm_storeu_si128( (__m128i *)(dst + i), _mm_packus_epi16( lo, hi ));
+    }
+#endif
+    for ( ; i < srclen && src[i] < 0x80; i++) dst[i] = src[i];
+    return i;
+}
+
 /* get the next char value taking surrogates into account */
 static inline unsigned int get_surrogate_value( const WCHAR *src, unsigned int srclen )
 {
@@ -108,8 +182,14 @@ int wine_utf8_wcstombs( int flags, const WCHAR *src, int srclen, char *dst, int
 
         if (ch < 0x80)  /* 0x00-0x7f: 1 byte */
         {
-            if (!len--) return -1;  /* overflow */
-            *dst++ = ch;
+            unsigned int count;
+
+            if (!len) return -1;  /* overflow */
+            count = ascii_wcstombs( src, srclen < len ? srclen : len, dst );
+            dst += count;
+            len -= count;
+            src += count - 1;
+            srclen -= count - 1;
             continue;
         }
 
@@ -241,8 +321,14 @@ static int utf8_mbstowcs_compose( int flags, const char *src, int srclen, WCHAR
         unsigned char ch = *src++;
         if (ch < 0x80)  /* special fast case for 7-bit ASCII */
         {
+            unsigned int count;
+
             if (dst >= dstend) return -1;  /* overflow */
-            *dst++ = composed[0] = ch;
+            count = ascii_mbstowcs( (const unsigned char *)src - 1,
+                                    min( srcend - src + 1, dstend - dst ), dst );
+            src += count - 1;
+            dst += count;
+            composed[0] = dst[-1];
             continue;
         }
         if ((res = decode_utf8_char( ch, &src, srcend )) <= 0xffff)
@@ -285,7 +371,9 @@ static inline int get_length_mbs_utf8( int flags, const char *src, int srclen )
         unsigned char ch = *src++;
         if (ch < 0x80)  /* special fast case for 7-bit ASCII */
         {
-            ret++;
+            unsigned int count = ascii_length( (const unsigned char *)src, srcend - src );
+            src += count;
+            ret += count + 1;
             continue;
         }
         if ((res = decode_utf8_char( ch, &src, srcend )) <= 0x10ffff)
@@ -316,7 +404,10 @@ int wine_utf8_mbstowcs( int flags, const char *src, int srclen, WCHAR *dst, int
         unsigned char ch = *src++;
         if (ch < 0x80)  /* special fast case for 7-bit ASCII */
         {
-            *dst++ = ch;
+            unsigned int count = ascii_mbstowcs( (const unsigned char *)src - 1,
+                                                 min( srcend - src + 1, dstend - dst ), dst );
+            src += count - 1;
+            dst += count;
             continue;
         }
         if ((res = decode_utf8_char( ch, &src, srcend )) <= 0xffff)
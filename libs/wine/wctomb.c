@@ -22,6 +22,8 @@
 
 #include "wine/unicode.h"
 
+extern unsigned int ascii_wcstombs( const WCHAR *src, unsigned int srclen, char *dst );
+
 /* search for a character in the unicode_compose_table; helper for compose() */
 static inline int binary_search( WCHAR ch, int low, int high )
 {
@@ -126,6 +128,16 @@ static int get_length_sbcs( const struct sbcs_table *table, int flags,
     return ret;
 }
 
+/* check whether the code page maps 7-bit ASCII to itself */
+static inline int is_ascii_uni2cp( const struct sbcs_table *table )
+{
+    const unsigned char *uni2cp = table->uni2cp_low + table->uni2cp_high[0];
+    unsigned int i;
+
+    for (i = 0; i < 0x80; i++) if (uni2cp[i] != i) return 0;
+    return 1;
+}
+
 /* wcstombs for single-byte code page */
 static inline int wcstombs_sbcs( const struct sbcs_table *table,
                                  const WCHAR *src, unsigned int srclen,
@@ -142,6 +154,21 @@ static inline int wcstombs_sbcs( const struct sbcs_table *table,
         ret = -1;
     }
 
+    /* long strings in ASCII compatible code pages are copied by runs */
+    if (srclen >= 64 && is_ascii_uni2cp( table ))
+    {
+        while (srclen)
+        {
+            unsigned int len = ascii_wcstombs( src, srclen, dst );
+            src += len;
+            dst += len;
+            srclen -= len;
+            for ( ; srclen && *src >= 0x80; srclen--, src++)
+                *dst++ = uni2cp_low[uni2cp_high[*src >> 8] + (*src & 0xff)];
+        }
+        return ret;
+    }
+
     while (srclen >= 16)
     {
         dst[0]  = uni2cp_low[uni2cp_high[src[0]  >> 8] + (src[0]  & 0xff)];